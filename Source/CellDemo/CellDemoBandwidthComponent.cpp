@@ -0,0 +1,390 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoBandwidthComponent.h"
+#include "CellDemo.h"
+#include "CellDemoLinkQualityComponent.h"
+#include "CellDemoPlayerController.h"
+#include "Containers/Ticker.h"
+#include "Engine/Engine.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/Character.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UCellDemoBandwidthComponent::UCellDemoBandwidthComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = true;
+
+	// OwnPawn, NearbyCharacter, BlockField, Messages, Cosmetic
+	ClassWeights = { 4.0f, 2.0f, 1.0f, 1.0f, 0.5f };
+	MaxStarvationTimes = { 0.0f, 0.5f, 1.0f, 0.5f, 2.0f };
+	NearbyRadius = 3000.0f;
+
+	MinNetSpeed = 2500;
+	InitialNetSpeed = 10000;
+	ProbeStep = 1000;
+	BackoffFactor = 0.7f;
+	SampleInterval = 0.5f;
+	RttRiseMs = 100.0f;
+	LossThresholdPercent = 5.0f;
+	MessageShare = 0.2f;
+	MessageBurstTime = 0.5f;
+
+	MotionThreshold = 5.0f;
+	MotionTimeout = 3.0f;
+
+	Capacity = 0;
+	ClickToMotionMs = 0.0f;
+	NumClicksLost = 0;
+
+	RequestedNetSpeed = 0;
+	AppliedNetSpeed = 0;
+	SyncNetSpeed = 0;
+	SampleTime = 0.0f;
+	MinRttMs = 0.0f;
+	MessageTokens = 0.0f;
+	ClickTime = 0.0;
+	ClickLocation = FVector::ZeroVector;
+}
+
+void UCellDemoBandwidthComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Scheduled on the server, the client only ticks while measuring a click
+	SetComponentTickEnabled(GetOwnerRole() == ROLE_Authority);
+	MessageTokens = InitialNetSpeed * MessageShare * MessageBurstTime;
+}
+
+float UCellDemoBandwidthComponent::GetClassWeight(ECellNetClass Class) const
+{
+	return ClassWeights.IsValidIndex((int32)Class) ? ClassWeights[(int32)Class] : 1.0f;
+}
+
+ECellNetClass UCellDemoBandwidthComponent::Classify(const AActor* Actor, const FVector& ViewPos) const
+{
+	const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	if (Controller != nullptr && (Actor == Controller->GetPawn() || Actor == Controller->GetViewTarget()))
+	{
+		return ECellNetClass::OwnPawn;
+	}
+
+	if (Actor->IsA<ACharacter>())
+	{
+		return FVector::DistSquared(Actor->GetActorLocation(), ViewPos) <= FMath::Square(NearbyRadius) ? ECellNetClass::NearbyCharacter : ECellNetClass::Cosmetic;
+	}
+
+	return ECellNetClass::BlockField;
+}
+
+float UCellDemoBandwidthComponent::ScaleNetPriority(const AActor* Actor, const FVector& ViewPos, float Time, float Priority) const
+{
+	const ECellNetClass Class = Classify(Actor, ViewPos);
+	float Weight = GetClassWeight(Class);
+
+	// Starvation guard, waited long enough to compete with the own pawn
+	if (MaxStarvationTimes.IsValidIndex((int32)Class) && Time >= MaxStarvationTimes[(int32)Class])
+	{
+		Weight = FMath::Max(Weight, GetClassWeight(ECellNetClass::OwnPawn));
+	}
+
+	return Priority * Weight;
+}
+
+bool UCellDemoBandwidthComponent::CanSendMessages(float QueueTime) const
+{
+	// Local players of a listen server and bots have no link to pace
+	if (GetOwner()->GetNetConnection() == nullptr || MessageTokens > 0.0f)
+	{
+		return true;
+	}
+
+	const int32 Index = (int32)ECellNetClass::Messages;
+	return MaxStarvationTimes.IsValidIndex(Index) && GetWorld()->GetTimeSeconds() - QueueTime >= MaxStarvationTimes[Index];
+}
+
+void UCellDemoBandwidthComponent::ConsumeMessageBytes(int32 Bytes)
+{
+	// Can go below 0, the next batches wait for the debt to be paid
+	MessageTokens -= Bytes;
+}
+
+void UCellDemoBandwidthComponent::SetSyncNetSpeed(int32 InSyncNetSpeed)
+{
+	SyncNetSpeed = InSyncNetSpeed;
+	if (UNetConnection* Connection = GetOwner()->GetNetConnection())
+	{
+		ApplyNetSpeed(Connection);
+	}
+}
+
+void UCellDemoBandwidthComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (GetOwnerRole() != ROLE_Authority)
+	{
+		TickClickToMotion();
+		return;
+	}
+
+	// Local players of a listen server and bots have nothing to schedule
+	UNetConnection* Connection = GetOwner()->GetNetConnection();
+	if (Connection == nullptr)
+	{
+		const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+		if (Controller != nullptr && Controller->IsLocalController())
+		{
+			SetComponentTickEnabled(false);
+		}
+		return;
+	}
+
+	if (Capacity == 0)
+	{
+		RequestedNetSpeed = Connection->CurrentNetSpeed;
+		Capacity = FMath::Clamp(InitialNetSpeed, FMath::Min(MinNetSpeed, RequestedNetSpeed), RequestedNetSpeed);
+		ApplyNetSpeed(Connection);
+	}
+
+	const float MessageRate = Capacity * MessageShare;
+	MessageTokens = FMath::Min(MessageTokens + MessageRate * DeltaTime, MessageRate * MessageBurstTime);
+
+	SampleTime += DeltaTime;
+	if (SampleTime >= SampleInterval)
+	{
+		SampleTime = 0.0f;
+		SampleCapacity(Connection);
+	}
+}
+
+void UCellDemoBandwidthComponent::SampleCapacity(UNetConnection* Connection)
+{
+	// The speed may have been changed by the player in the meantime, keep what they asked for as the ceiling
+	if (Connection->CurrentNetSpeed != AppliedNetSpeed)
+	{
+		RequestedNetSpeed = Connection->CurrentNetSpeed;
+	}
+
+	const UCellDemoLinkQualityComponent* LinkQuality = GetOwner()->FindComponentByClass<UCellDemoLinkQualityComponent>();
+	if (LinkQuality == nullptr || LinkQuality->Quality.RttMs <= 0.0f)
+	{
+		ApplyNetSpeed(Connection);
+		return;
+	}
+
+	// The lowest RTT drifts up slowly, so a route that got longer for good is not taken for a queue forever
+	const FCellLinkQuality& Quality = LinkQuality->Quality;
+	MinRttMs = MinRttMs > 0.0f ? FMath::Min(MinRttMs + SampleInterval, Quality.RttMs) : Quality.RttMs;
+
+	const bool bSaturated = Quality.Saturation >= 0.9f || !Connection->IsNetReady(false);
+	const bool bQueuing = Quality.RttMs > MinRttMs + RttRiseMs;
+	const bool bLosing = bSaturated && Quality.LossPercent > LossThresholdPercent;
+
+	const int32 OldCapacity = Capacity;
+	if (bQueuing || bLosing)
+	{
+		Capacity = FMath::Max(FMath::RoundToInt(Capacity * BackoffFactor), MinNetSpeed);
+	}
+	else if (bSaturated)
+	{
+		Capacity += ProbeStep;
+	}
+	Capacity = FMath::Clamp(Capacity, FMath::Min(MinNetSpeed, RequestedNetSpeed), RequestedNetSpeed);
+
+	if (Capacity < OldCapacity)
+	{
+		UE_LOG(LogCellDemo, Verbose, TEXT("Bandwidth: %s backs off to %d B/s (rtt %.0f ms over %.0f ms, loss %.1f%%, saturation %.2f)"),
+			*GetOwner()->GetName(), Capacity, Quality.RttMs, MinRttMs, Quality.LossPercent, Quality.Saturation);
+	}
+
+	ApplyNetSpeed(Connection);
+}
+
+void UCellDemoBandwidthComponent::ApplyNetSpeed(UNetConnection* Connection)
+{
+	if (Capacity == 0)
+	{
+		return;
+	}
+
+	AppliedNetSpeed = SyncNetSpeed > 0 ? FMath::Min(Capacity, SyncNetSpeed) : Capacity;
+	Connection->CurrentNetSpeed = AppliedNetSpeed;
+}
+
+void UCellDemoBandwidthComponent::NotifyMoveIssued()
+{
+	// Measured from a standing character only, a moving one shows no click
+	const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	const APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+	if (GetNetMode() != NM_Client || ClickTime > 0.0 || Pawn == nullptr || !Pawn->GetVelocity().IsNearlyZero(1.0f))
+	{
+		return;
+	}
+
+	ClickTime = FPlatformTime::Seconds();
+	ClickLocation = Pawn->GetActorLocation();
+	SetComponentTickEnabled(true);
+}
+
+void UCellDemoBandwidthComponent::TickClickToMotion()
+{
+	if (ClickTime <= 0.0)
+	{
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	const APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+	const double Elapsed = FPlatformTime::Seconds() - ClickTime;
+
+	if (Pawn != nullptr && FVector::DistSquared(Pawn->GetActorLocation(), ClickLocation) > FMath::Square(MotionThreshold))
+	{
+		ClickToMotionMs = Elapsed * 1000.0;
+		ClickToMotionSamples.Add(ClickToMotionMs);
+	}
+	else if (Elapsed > MotionTimeout)
+	{
+		NumClicksLost++;
+	}
+	else
+	{
+		return;
+	}
+
+	ClickTime = 0.0;
+	SetComponentTickEnabled(false);
+}
+
+// *******************************
+// Bench
+// *******************************
+
+/**
+*	Clicks the character of the player somewhere around it whenever it stands still, under the given packet loss and
+*	lag emulation, then reports the click to motion latency. Saturate the link from the host meanwhile, with
+*	CellDemo.Bots.Spawn and CellDemo.Messages.Bench.
+*/
+class FCellDemoNetBench : public FTickerObjectBase
+{
+public:
+	FCellDemoNetBench(UWorld* InWorld, ACellDemoPlayerController* InController, float InDuration, int32 InPktLoss, int32 InPktLag)
+		: World(InWorld)
+		, Controller(InController)
+		, Duration(InDuration)
+		, PktLoss(InPktLoss)
+		, PktLag(InPktLag)
+		, StartTime(FPlatformTime::Seconds())
+	{
+		SetEmulation(PktLoss, PktLag);
+		Controller->Bandwidth->ClickToMotionSamples.Reset();
+		Controller->Bandwidth->NumClicksLost = 0;
+	}
+
+	bool IsDone() const { return !World.IsValid() || !Controller.IsValid() || FPlatformTime::Seconds() - StartTime > Duration; }
+
+	virtual bool Tick(float DeltaTime) override
+	{
+		if (IsDone())
+		{
+			return true;
+		}
+
+		// Next click once the previous one moved the character and it stopped
+		const APawn* Pawn = Controller->GetPawn();
+		if (Pawn != nullptr && Pawn->GetVelocity().IsNearlyZero(1.0f) && !Controller->Bandwidth->IsMeasuringClick())
+		{
+			const FVector Direction = FVector(FMath::RandPointInCircle(1.0f), 0.0f).GetSafeNormal();
+			Controller->IssueMoveDestination(Pawn->GetActorLocation() + Direction * FMath::FRandRange(500.0f, 1000.0f));
+		}
+		return true;
+	}
+
+	void Report()
+	{
+		SetEmulation(0, 0);
+		if (!Controller.IsValid())
+		{
+			return;
+		}
+
+		TArray<float> Samples = Controller->Bandwidth->ClickToMotionSamples;
+		const int32 NumLost = Controller->Bandwidth->NumClicksLost;
+		Samples.Sort();
+		const auto Percentile = [&Samples](float Fraction) { return Samples.Num() > 0 ? Samples[FMath::Min(FMath::FloorToInt(Samples.Num() * Fraction), Samples.Num() - 1)] : 0.0f; };
+
+		UE_LOG(LogCellDemo, Log, TEXT("Net bench: loss %d%% lag %d ms | %d clicks, %d lost | click to motion median %.0f ms, p95 %.0f ms, max %.0f ms"),
+			PktLoss, PktLag, Samples.Num() + NumLost, NumLost, Percentile(0.5f), Percentile(0.95f), Percentile(1.0f));
+
+		const FString FilePath = FPaths::ProjectSavedDir() / TEXT("Profiling/CellNet/ClickToMotion.csv");
+		FString Line;
+		if (!IFileManager::Get().FileExists(*FilePath))
+		{
+			Line += TEXT("Date,PktLoss,PktLag,Clicks,Lost,MedianMs,P95Ms,MaxMs\n");
+		}
+		Line += FString::Printf(TEXT("%s,%d,%d,%d,%d,%.1f,%.1f,%.1f\n"), *FDateTime::Now().ToString(), PktLoss, PktLag,
+			Samples.Num() + NumLost, NumLost, Percentile(0.5f), Percentile(0.95f), Percentile(1.0f));
+		FFileHelper::SaveStringToFile(Line, *FilePath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+	}
+
+private:
+	TWeakObjectPtr<UWorld> World;
+	TWeakObjectPtr<ACellDemoPlayerController> Controller;
+	float Duration;
+	int32 PktLoss;
+	int32 PktLag;
+	double StartTime;
+
+	/** Packet emulation of the net driver, not available in shipping builds */
+	void SetEmulation(int32 InPktLoss, int32 InPktLag)
+	{
+		if (World.IsValid())
+		{
+			GEngine->Exec(World.Get(), *FString::Printf(TEXT("Net PktLoss=%d"), InPktLoss));
+			GEngine->Exec(World.Get(), *FString::Printf(TEXT("Net PktLag=%d"), InPktLag));
+		}
+	}
+};
+
+static TUniquePtr<FCellDemoNetBench> GNetBench;
+
+/** Reports and deletes the bench once done, from the core ticker so it doesn't delete itself */
+static FDelegateHandle GNetBenchReportHandle;
+
+static void NetBenchCommand(const TArray<FString>& Args, UWorld* World)
+{
+	ACellDemoPlayerController* Controller = World != nullptr ? Cast<ACellDemoPlayerController>(World->GetFirstPlayerController()) : nullptr;
+	if (Controller == nullptr || Controller->Bandwidth == nullptr || World->GetNetMode() != NM_Client)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Net bench: run it on a client connected to a cell"));
+		return;
+	}
+
+	const float Duration = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 30.0f;
+	const int32 PktLoss = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0;
+	const int32 PktLag = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 0;
+
+	FTicker::GetCoreTicker().RemoveTicker(GNetBenchReportHandle);
+	GNetBench = MakeUnique<FCellDemoNetBench>(World, Controller, Duration, PktLoss, PktLag);
+	GNetBenchReportHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([](float DeltaTime)
+	{
+		if (GNetBench.IsValid() && GNetBench->IsDone())
+		{
+			GNetBench->Report();
+			GNetBench.Reset();
+			return false;
+		}
+		return GNetBench.IsValid();
+	}));
+
+	UE_LOG(LogCellDemo, Log, TEXT("Net bench: %.0f s, loss %d%%, lag %d ms"), Duration, PktLoss, PktLag);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs NetBenchCmd(
+	TEXT("CellDemo.Net.Bench"),
+	TEXT("Measures the click to motion latency of the own character under packet emulation. Usage: CellDemo.Net.Bench [Seconds] [PktLoss] [PktLag]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(NetBenchCommand));
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CellDemoBandwidthComponent.generated.h"
+
+/** What a piece of replicated traffic is to the player receiving it, from the most to the least urgent */
+enum class ECellNetClass : uint8
+{
+	/** The character of the player, its clicks show up there */
+	OwnPawn,
+	/** Characters within NearbyRadius of the view */
+	NearbyCharacter,
+	/** The blocks */
+	BlockField,
+	/** Phone messages */
+	Messages,
+	/** Characters further away */
+	Cosmetic,
+	Count
+};
+
+/**
+*	Send scheduler of the connection of a player, so a weak mobile link keeps its own character responsive when block
+*	updates, other characters and messages burst together.
+*
+*	Rate: the connection speed follows the measured link capacity. The capacity grows by ProbeStep every SampleInterval
+*	while the link keeps up with the traffic, and is multiplied by BackoffFactor when the link quality shows congestion
+*	(RTT rising RttRiseMs above the lowest seen, or losses on a saturated link). It stays between MinNetSpeed and the
+*	speed the player asked for, and below the cap of the initial sync while the player joins.
+*	Classes: the priority the engine gives an actor for this connection is scaled by ClassWeights. An actor that wasn't
+*	sent for MaxStarvationTimes of its class gets the weight of the own pawn, so the lower classes are slowed, not starved.
+*	Messages: the batches are paced by a token bucket getting MessageShare of the capacity, a batch waiting longer than
+*	the starvation time of the messages goes anyway.
+*
+*	The characters and the blocks (ACellDemoBlock, the parent of the Block Blueprint) call ScaleNetPriority from their
+*	GetNetPriority.
+*
+*	Client side, the time from a click of the player to the first visible motion of its character is measured.
+*	Console: CellDemo.Net.Bench [Seconds] [PktLoss] [PktLag], on a client
+*/
+UCLASS(ClassGroup = (CellDemo), meta = (BlueprintSpawnableComponent))
+class UCellDemoBandwidthComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoBandwidthComponent();
+
+	/** Priority scale of each ECellNetClass */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	TArray<float> ClassWeights;
+
+	/** Time after which an actor of each ECellNetClass is sent with the priority of the own pawn, in seconds */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	TArray<float> MaxStarvationTimes;
+
+	/** Characters closer to the view are NearbyCharacter, the others Cosmetic */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float NearbyRadius;
+
+	/** Bounds of the connection speed, in bytes per second */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	int32 MinNetSpeed;
+
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	int32 InitialNetSpeed;
+
+	/** Capacity added every sample while the link keeps up, in bytes per second */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	int32 ProbeStep;
+
+	/** Capacity kept when the link is congested */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth", meta = (ClampMin = "0.1", ClampMax = "1.0"))
+	float BackoffFactor;
+
+	/** Time between two capacity updates, in seconds */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float SampleInterval;
+
+	/** RTT above the lowest seen that means the link queues, in milliseconds */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float RttRiseMs;
+
+	/** Losses that mean congestion when the link is saturated, in percent, random losses of an idle link don't count */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float LossThresholdPercent;
+
+	/** Share of the capacity the message batches get, and the burst the bucket holds, in seconds of that share */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float MessageShare;
+
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float MessageBurstTime;
+
+	/** Client side, a character moving less than this after a click hasn't visibly moved yet, in centimeters */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float MotionThreshold;
+
+	/** Client side, a click without motion after this long is counted as lost, in seconds */
+	UPROPERTY(EditAnywhere, Category = "Bandwidth")
+	float MotionTimeout;
+
+	/** Measured link capacity, the current connection speed, in bytes per second */
+	UPROPERTY(BlueprintReadOnly, Category = "Bandwidth")
+	int32 Capacity;
+
+	/** Client side, last click to motion latency, in milliseconds */
+	UPROPERTY(BlueprintReadOnly, Category = "Bandwidth")
+	float ClickToMotionMs;
+
+	/** Client side, every latency measured and the clicks lost since the last reset */
+	TArray<float> ClickToMotionSamples;
+	int32 NumClicksLost;
+
+	float GetClassWeight(ECellNetClass Class) const;
+
+	/** Server side, the priority of Actor for this connection, Priority being the one of the engine */
+	float ScaleNetPriority(const AActor* Actor, const FVector& ViewPos, float Time, float Priority) const;
+
+	/** Server side, whether a message batch can go now, its first message having been queued at QueueTime */
+	bool CanSendMessages(float QueueTime) const;
+	void ConsumeMessageBytes(int32 Bytes);
+
+	/** The speed the initial sync caps the connection to, 0 for none */
+	void SetSyncNetSpeed(int32 InSyncNetSpeed);
+
+	/** Client side, the player asked its character to move */
+	void NotifyMoveIssued();
+
+	bool IsMeasuringClick() const { return ClickTime > 0.0; }
+
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	/** Speed of the connection the player asked for, the capacity doesn't go above */
+	int32 RequestedNetSpeed;
+
+	/** Speed last applied to the connection, a different one was set by the player */
+	int32 AppliedNetSpeed;
+	int32 SyncNetSpeed;
+
+	float SampleTime;
+	float MinRttMs;
+	float MessageTokens;
+
+	/** Client side, pending click */
+	double ClickTime;
+	FVector ClickLocation;
+
+	ECellNetClass Classify(const AActor* Actor, const FVector& ViewPos) const;
+	void SampleCapacity(class UNetConnection* Connection);
+	void ApplyNetSpeed(class UNetConnection* Connection);
+	void TickClickToMotion();
+};
@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoBlock.h"
+#include "CellDemoBandwidthComponent.h"
+#include "CellDemoPlayerController.h"
+
+ACellDemoBlock::ACellDemoBlock()
+{
+	bReplicates = true;
+}
+
+float ACellDemoBlock::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	const float Priority = Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+
+	const ACellDemoPlayerController* CellViewer = Cast<ACellDemoPlayerController>(Viewer);
+	return CellViewer != nullptr && CellViewer->Bandwidth != nullptr ? CellViewer->Bandwidth->ScaleNetPriority(this, ViewPos, Time, Priority) : Priority;
+}
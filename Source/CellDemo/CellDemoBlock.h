@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "CellDemoBlock.generated.h"
+
+/**
+*	Native parent of the Block Blueprint, gives the blocks the priority of the block field class of the
+*	UCellDemoBandwidthComponent of each viewing player.
+*/
+UCLASS()
+class ACellDemoBlock : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ACellDemoBlock();
+
+	// Begin AActor interface
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+	// End AActor interface
+};
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoBlockNavComponent.h"
+#include "AI/Navigation/NavAreas/NavArea_Null.h"
+#include "CellDemoNavManager.h"
+#include "CellDemoStats.h"
+
+UCellDemoBlockNavComponent::UCellDemoBlockNavComponent()
+{
+	AreaClass = UNavArea_Null::StaticClass();
+
+	// Registering must not dirty the navmesh, the nav manager decides when
+	bCanEverAffectNavigation = false;
+	ObstacleBounds = FBox(ForceInit);
+}
+
+void UCellDemoBlockNavComponent::EnableObstacle()
+{
+	if (!CanEverAffectNavigation())
+	{
+		SetCanEverAffectNavigation(true);
+		ObstacleBounds = GetOwner()->GetComponentsBoundingBox();
+		NotifyObstacleChanged();
+	}
+}
+
+void UCellDemoBlockNavComponent::NotifyObstacleChanged()
+{
+	FCellDemoServerStats::NavObstacleChanges++;
+
+	if (ACellDemoNavManager* NavManager = ACellDemoNavManager::Get(GetWorld()))
+	{
+		NavManager->OnObstacleChanged(ObstacleBounds);
+	}
+}
+
+void UCellDemoBlockNavComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	// The block affects the navigation through this modifier only, or its collision would dirty the tiles outside of the budget
+	TInlineComponentArray<UPrimitiveComponent*> Primitives(GetOwner());
+	for (UPrimitiveComponent* Primitive : Primitives)
+	{
+		Primitive->SetCanEverAffectNavigation(false);
+	}
+
+	if (ACellDemoNavManager* NavManager = ACellDemoNavManager::Get(GetWorld()))
+	{
+		NavManager->QueueObstacle(this);
+	}
+	else
+	{
+		EnableObstacle();
+	}
+}
+
+void UCellDemoBlockNavComponent::OnUnregister()
+{
+	if (CanEverAffectNavigation())
+	{
+		NotifyObstacleChanged();
+	}
+
+	Super::OnUnregister();
+}
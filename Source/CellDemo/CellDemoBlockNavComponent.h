@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/Navigation/NavModifierComponent.h"
+#include "CellDemoBlockNavComponent.generated.h"
+
+/**
+*	Makes a block a navigation obstacle through a nav modifier instead of its collision geometry, the collision of
+*	the block stops affecting the navigation when the modifier registers.
+*	The obstacle is not active right away, ACellDemoNavManager enables the pending ones under a time budget.
+*/
+UCLASS(ClassGroup = (Navigation), meta = (BlueprintSpawnableComponent))
+class UCellDemoBlockNavComponent : public UNavModifierComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoBlockNavComponent();
+
+	/** Starts affecting the navmesh */
+	void EnableObstacle();
+
+	// Begin UActorComponent interface
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+	// End UActorComponent interface
+
+protected:
+	/** Bounds of the owner when the obstacle was enabled, where the navmesh changes */
+	FBox ObstacleBounds;
+
+	void NotifyObstacleChanged();
+};
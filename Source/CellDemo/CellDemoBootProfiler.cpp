@@ -0,0 +1,279 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoBootProfiler.h"
+#include "CellDemo.h"
+#include "CellNWGameInstance.h"
+#include "Blueprint/UserWidget.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "OnlineSubsystem.h"
+#include "UObject/UObjectIterator.h"
+
+UCellDemoBootProfiler::UCellDemoBootProfiler()
+{
+	InteractiveBudgetMs = 0.0f;
+	BootTimeout = 120.0f;
+
+	GameInstance = nullptr;
+	bAssetsLoaded = false;
+	bMapLoaded = false;
+	bInteractive = false;
+	bTimedOut = false;
+	bOnlineSubsystemCreated = false;
+	bProfileRun = false;
+}
+
+double UCellDemoBootProfiler::GetBootMs()
+{
+	return (FPlatformTime::Seconds() - GStartTime) * 1000.0;
+}
+
+void UCellDemoBootProfiler::Initialize(UCellNWGameInstance* InGameInstance)
+{
+	GameInstance = InGameInstance;
+	bProfileRun = FParse::Param(FCommandLine::Get(), TEXT("CellBootProfile"));
+
+	// Everything the engine did before creating the game instance
+	FCellBootPhase& PreInit = Phases[Phases.AddDefaulted()];
+	PreInit.Name = TEXT("EnginePreInit");
+	PreInit.StartMs = 0.0;
+	PreInit.EndMs = GetBootMs();
+
+	BeginPhase(TEXT("GameInstanceInit"));
+
+	FCoreUObjectDelegates::PreLoadMap.AddUObject(this, &UCellDemoBootProfiler::OnPreLoadMap);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UCellDemoBootProfiler::OnPostLoadMap);
+}
+
+void UCellDemoBootProfiler::BeginDestroy()
+{
+	FCoreUObjectDelegates::PreLoadMap.RemoveAll(this);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	Super::BeginDestroy();
+}
+
+void UCellDemoBootProfiler::BeginPhase(const FString& Name)
+{
+	FCellBootPhase* Phase = Phases.FindByPredicate([&Name](const FCellBootPhase& Other) { return Other.Name == Name; });
+	if (Phase == nullptr)
+	{
+		Phase = &Phases[Phases.AddDefaulted()];
+		Phase->Name = Name;
+	}
+	Phase->StartMs = GetBootMs();
+	Phase->EndMs = -1.0;
+}
+
+void UCellDemoBootProfiler::EndPhase(const FString& Name)
+{
+	FCellBootPhase* Phase = Phases.FindByPredicate([&Name](const FCellBootPhase& Other) { return Other.Name == Name; });
+	if (Phase != nullptr && Phase->IsOpen())
+	{
+		Phase->EndMs = GetBootMs();
+	}
+}
+
+void UCellDemoBootProfiler::OnGameInstanceInitialized()
+{
+	EndPhase(TEXT("GameInstanceInit"));
+	CheckOnlineSubsystem();
+
+	if (!PhoneWidgetClass.IsNull())
+	{
+		PreloadAssets.AddUnique(PhoneWidgetClass.ToSoftObjectPath());
+	}
+
+	if (PreloadAssets.Num() == 0)
+	{
+		bAssetsLoaded = true;
+		return;
+	}
+
+	// The Phone map loads meanwhile, the UI comes once both are done
+	BeginPhase(TEXT("UIAssets"));
+	PreloadHandle = Streamable.RequestAsyncLoad(PreloadAssets, FStreamableDelegate::CreateUObject(this, &UCellDemoBootProfiler::OnPreloadComplete));
+	if (!PreloadHandle.IsValid())
+	{
+		OnPreloadComplete();
+	}
+}
+
+void UCellDemoBootProfiler::OnPreloadComplete()
+{
+	if (bAssetsLoaded)
+	{
+		return;
+	}
+
+	EndPhase(TEXT("UIAssets"));
+	bAssetsLoaded = true;
+
+	if (GameInstance != nullptr)
+	{
+		GameInstance->OnBootAssetsLoaded.Broadcast();
+	}
+}
+
+void UCellDemoBootProfiler::CheckOnlineSubsystem()
+{
+	if (bOnlineSubsystemCreated || !IOnlineSubsystem::DoesInstanceExist())
+	{
+		return;
+	}
+	bOnlineSubsystemCreated = true;
+
+	FCellBootPhase& Created = Phases[Phases.AddDefaulted()];
+	Created.Name = TEXT("OnlineSubsystem");
+	Created.StartMs = GetBootMs();
+	Created.EndMs = Created.StartMs;
+}
+
+void UCellDemoBootProfiler::OnPreLoadMap(const FString& MapName)
+{
+	CheckOnlineSubsystem();
+
+	if (!bMapLoaded)
+	{
+		BeginPhase(TEXT("PhoneMapLoad"));
+	}
+}
+
+void UCellDemoBootProfiler::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	CheckOnlineSubsystem();
+
+	if (!bMapLoaded)
+	{
+		EndPhase(TEXT("PhoneMapLoad"));
+		BeginPhase(TEXT("FirstFrame"));
+		bMapLoaded = true;
+	}
+}
+
+bool UCellDemoBootProfiler::IsTickable() const
+{
+	return GameInstance != nullptr && !bInteractive && !bTimedOut && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UCellDemoBootProfiler::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellDemoBootProfiler, STATGROUP_Tickables);
+}
+
+void UCellDemoBootProfiler::Tick(float DeltaTime)
+{
+	// A headless run never reaching the interactive frame would otherwise never exit
+	if (bProfileRun && BootTimeout > 0.0f && GetBootMs() > BootTimeout * 1000.0)
+	{
+		TimeOut();
+		return;
+	}
+	CheckOnlineSubsystem();
+
+	if (!bMapLoaded)
+	{
+		return;
+	}
+	EndPhase(TEXT("FirstFrame"));
+
+	UWorld* World = GameInstance->GetWorld();
+	APlayerController* LocalController = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+	if (bAssetsLoaded && LocalController != nullptr && LocalController->IsLocalPlayerController())
+	{
+		CreatePhoneWidget(World, LocalController);
+		Finish();
+	}
+}
+
+void UCellDemoBootProfiler::CreatePhoneWidget(UWorld* World, APlayerController* LocalController)
+{
+	UClass* WidgetClass = PhoneWidgetClass.Get();
+	if (WidgetClass == nullptr || World->GetMapName() != TEXT("Phone"))
+	{
+		return;
+	}
+
+	// A level still creating its UI itself keeps it, there must be one phone screen
+	for (TObjectIterator<UUserWidget> It; It; ++It)
+	{
+		if (It->IsA(WidgetClass) && It->GetWorld() == World && It->IsInViewport())
+		{
+			return;
+		}
+	}
+
+	BeginPhase(TEXT("PhoneWidget"));
+	UUserWidget* Widget = CreateWidget<UUserWidget>(LocalController, WidgetClass);
+	if (Widget != nullptr)
+	{
+		Widget->AddToViewport();
+	}
+	EndPhase(TEXT("PhoneWidget"));
+}
+
+void UCellDemoBootProfiler::Finish()
+{
+	bInteractive = true;
+
+	FCellBootPhase& Interactive = Phases[Phases.AddDefaulted()];
+	Interactive.Name = TEXT("Interactive");
+	Interactive.StartMs = 0.0;
+	Interactive.EndMs = GetBootMs();
+
+	FCoreUObjectDelegates::PreLoadMap.RemoveAll(this);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	WriteReport();
+}
+
+void UCellDemoBootProfiler::TimeOut()
+{
+	bTimedOut = true;
+
+	FCellBootPhase& TimedOut = Phases[Phases.AddDefaulted()];
+	TimedOut.Name = TEXT("TimedOut");
+	TimedOut.StartMs = 0.0;
+	TimedOut.EndMs = GetBootMs();
+
+	FCoreUObjectDelegates::PreLoadMap.RemoveAll(this);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	UE_LOG(LogCellDemo, Error, TEXT("Boot: not interactive after %.0f s (map loaded %d, UI assets loaded %d, local player %d)"), BootTimeout,
+		bMapLoaded ? 1 : 0, bAssetsLoaded ? 1 : 0, GameInstance->GetWorld() != nullptr && GameInstance->GetWorld()->GetFirstPlayerController() != nullptr ? 1 : 0);
+
+	WriteReport();
+}
+
+void UCellDemoBootProfiler::WriteReport()
+{
+	const FString OutputDir = FPaths::ProjectSavedDir() / TEXT("Profiling/CellBoot");
+	const double InteractiveMs = Phases.Last().EndMs;
+
+	FString Csv = TEXT("Phase,StartMs,EndMs,DurationMs\n");
+	for (const FCellBootPhase& Phase : Phases)
+	{
+		// A phase a blueprint never closed ends at the interactive frame, or at the timeout
+		const double EndMs = Phase.IsOpen() ? InteractiveMs : Phase.EndMs;
+		Csv += FString::Printf(TEXT("%s,%.1f,%.1f,%.1f\n"), *Phase.Name, Phase.StartMs, EndMs, EndMs - Phase.StartMs);
+
+		UE_LOG(LogCellDemo, Log, TEXT("Boot: %-20s %8.1f ms -> %8.1f ms (%.1f ms)%s"), *Phase.Name, Phase.StartMs, EndMs, EndMs - Phase.StartMs,
+			Phase.IsOpen() ? TEXT(", not closed") : TEXT(""));
+	}
+	FFileHelper::SaveStringToFile(Csv, *(OutputDir / TEXT("Boot.csv")));
+
+	if (!bProfileRun)
+	{
+		return;
+	}
+
+	const bool bFailed = bTimedOut || (InteractiveBudgetMs > 0.0f && InteractiveMs > InteractiveBudgetMs);
+	if (bFailed && !bTimedOut)
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("Boot: interactive after %.1f ms, budget is %.1f ms"), InteractiveMs, InteractiveBudgetMs);
+	}
+
+	// CI reads this file, the log only has the details
+	FFileHelper::SaveStringToFile(bFailed ? TEXT("FAIL") : TEXT("PASS"), *(OutputDir / TEXT("Result.txt")));
+	FPlatformMisc::RequestExit(false);
+}
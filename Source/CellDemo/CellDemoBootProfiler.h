@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "UObject/SoftObjectPath.h"
+#include "Engine/StreamableManager.h"
+#include "Tickable.h"
+#include "CellDemoBootProfiler.generated.h"
+
+/** One named span of the boot, in milliseconds since the process started */
+struct FCellBootPhase
+{
+	FString Name;
+	double StartMs;
+	double EndMs;
+
+	FCellBootPhase()
+		: StartMs(0.0)
+		, EndMs(-1.0)
+	{
+	}
+
+	bool IsOpen() const { return EndMs < StartMs; }
+};
+
+/**
+*	Times the boot from the process start (GStartTime) to the first interactive frame of the Phone level, and
+*	streams the UI assets in the background from the game instance init.
+*
+*	Phases: EnginePreInit until the game instance starts, GameInstanceInit, PhoneMapLoad, FirstFrame, and UIAssets
+*	which overlaps them since the PreloadAssets are requested from the game instance init. The boot is interactive on
+*	the first frame with the Phone level loaded, the UI assets loaded and a local player controller.
+*	Blueprints can add their own phases with BeginBootPhase/EndBootPhase on the game instance. OnlineSubsystem marks
+*	the first boot step the default online subsystem was found created at, the engine creates it for the net id of the
+*	local player whatever the game code does.
+*
+*	PhoneWidgetClass is only soft referenced: once the assets are loaded, the widget is created on the Phone level for
+*	the local player, unless the level already put one on screen. As long as the level Blueprint creates the UI itself
+*	its hard reference still loads it with the map, the level has to stop creating it for the UI to come after the
+*	first frame. Blueprints can wait for the assets with OnBootAssetsLoaded or AreBootAssetsLoaded on the game instance.
+*
+*	The phases are written to Saved/Profiling/CellBoot/Boot.csv. With -CellBootProfile the game also writes
+*	Result.txt (FAIL above InteractiveBudgetMs) and exits, for headless cold start runs. A run not interactive after
+*	BootTimeout writes FAIL and exits as well, with the phases it got through.
+*/
+UCLASS(config = Game)
+class UCellDemoBootProfiler : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoBootProfiler();
+
+	/** UI textures and widgets loaded in the background, by object path */
+	UPROPERTY(config)
+	TArray<FSoftObjectPath> PreloadAssets;
+
+	/** Widget created on the Phone level once the UI assets are loaded, preloaded with them */
+	UPROPERTY(config)
+	TSoftClassPtr<class UUserWidget> PhoneWidgetClass;
+
+	/** Time from the process start to the first interactive frame above which a profiling run fails, 0 to never fail */
+	UPROPERTY(config)
+	float InteractiveBudgetMs;
+
+	/** Time from the process start after which a profiling run gives up on the interactive frame, in seconds */
+	UPROPERTY(config)
+	float BootTimeout;
+
+	void Initialize(class UCellNWGameInstance* InGameInstance);
+
+	virtual void BeginDestroy() override;
+
+	/** Phases are closed by name, a phase already open is restarted */
+	void BeginPhase(const FString& Name);
+	void EndPhase(const FString& Name);
+
+	/** Call once the game instance is initialized, requests the UI assets */
+	void OnGameInstanceInitialized();
+
+	bool AreAssetsLoaded() const { return bAssetsLoaded; }
+	bool IsInteractive() const { return bInteractive; }
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+protected:
+	UPROPERTY(Transient)
+	class UCellNWGameInstance* GameInstance;
+
+	TArray<FCellBootPhase> Phases;
+
+	FStreamableManager Streamable;
+
+	/** Keeps the preloaded assets referenced */
+	TSharedPtr<FStreamableHandle> PreloadHandle;
+
+	bool bAssetsLoaded;
+	bool bMapLoaded;
+	bool bInteractive;
+	bool bTimedOut;
+	bool bOnlineSubsystemCreated;
+
+	/** Started with -CellBootProfile */
+	bool bProfileRun;
+
+	static double GetBootMs();
+
+	void OnPreLoadMap(const FString& MapName);
+	void OnPostLoadMap(UWorld* LoadedWorld);
+	void OnPreloadComplete();
+
+	/** Adds the OnlineSubsystem mark the first time the default online subsystem exists */
+	void CheckOnlineSubsystem();
+
+	/** Puts PhoneWidgetClass on screen for the local player of the Phone level */
+	void CreatePhoneWidget(UWorld* World, class APlayerController* LocalController);
+
+	void Finish();
+	void TimeOut();
+	void WriteReport();
+};
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoBotComponent.h"
+#include "CellDemoPlayerController.h"
+
+UCellDemoBotComponent::UCellDemoBotComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = true;
+
+	Pattern = ECellBotPattern::RandomWalk;
+	ClicksPerSecond = 1.0f;
+	WalkRadius = 800.0f;
+	SwarmLocation = FVector::ZeroVector;
+	SwarmRadius = 200.0f;
+	ClickAccumulator = FMath::FRand();
+}
+
+ECellBotPattern UCellDemoBotComponent::ParsePattern(const FString& PatternName)
+{
+	if (PatternName == TEXT("Idle"))
+	{
+		return ECellBotPattern::Idle;
+	}
+	if (PatternName == TEXT("SwarmToPoint"))
+	{
+		return ECellBotPattern::SwarmToPoint;
+	}
+	return ECellBotPattern::RandomWalk;
+}
+
+void UCellDemoBotComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (Pattern == ECellBotPattern::Idle || GetOwnerRole() != ROLE_Authority)
+	{
+		return;
+	}
+
+	// Jitter the rate a bit so hundreds of bots don't all click on the same frame
+	ClickAccumulator += DeltaTime * ClicksPerSecond * FMath::FRandRange(0.5f, 1.5f);
+	while (ClickAccumulator >= 1.0f)
+	{
+		ClickAccumulator -= 1.0f;
+		IssueClick();
+	}
+}
+
+void UCellDemoBotComponent::IssueClick()
+{
+	ACellDemoPlayerController* Controller = Cast<ACellDemoPlayerController>(GetOwner());
+	APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+	if (Pawn == nullptr)
+	{
+		return;
+	}
+
+	const FVector PawnLocation = Pawn->GetActorLocation();
+	FVector Destination = PawnLocation;
+
+	switch (Pattern)
+	{
+	case ECellBotPattern::RandomWalk:
+		Destination += FVector(FMath::RandPointInCircle(WalkRadius), 0.0f);
+		break;
+	case ECellBotPattern::SwarmToPoint:
+		Destination = SwarmLocation + FVector(FMath::RandPointInCircle(SwarmRadius), 0.0f);
+		Destination.Z = PawnLocation.Z;
+		break;
+	default:
+		return;
+	}
+
+	Controller->IssueMoveDestination(Destination);
+}
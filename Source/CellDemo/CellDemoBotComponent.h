@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CellDemoBotComponent.generated.h"
+
+UENUM(BlueprintType)
+enum class ECellBotPattern : uint8
+{
+	/** Never clicks, only costs a connection slot and a pawn */
+	Idle,
+	/** Clicks around its own pawn */
+	RandomWalk,
+	/** Clicks around a shared location, all the bots converge on it */
+	SwarmToPoint
+};
+
+/**
+*	Lightweight driver that fakes the clicks of a player.
+*	Must be attached to an ACellDemoPlayerController, the moves go through its SetNewMoveDestination server call.
+*/
+UCLASS(ClassGroup = (CellDemo), meta = (BlueprintSpawnableComponent))
+class UCellDemoBotComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoBotComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	ECellBotPattern Pattern;
+
+	/** Average number of move requests per second */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot", meta = (ClampMin = "0.0"))
+	float ClicksPerSecond;
+
+	/** Max distance from the pawn of a RandomWalk click */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float WalkRadius;
+
+	/** Target of the SwarmToPoint pattern */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	FVector SwarmLocation;
+
+	/** Spread of the SwarmToPoint clicks around SwarmLocation */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float SwarmRadius;
+
+	/** Converts a pattern name from the command line or the console, RandomWalk if unknown */
+	static ECellBotPattern ParsePattern(const FString& PatternName);
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	/** Picks a destination for the current pattern and sends it to the controller */
+	void IssueClick();
+
+	/** Fraction of click accumulated since the last one */
+	float ClickAccumulator;
+};
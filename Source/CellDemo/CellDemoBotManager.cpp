@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoBotManager.h"
+#include "CellDemo.h"
+#include "CellDemoPlayerController.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerState.h"
+
+ACellDemoBotManager::ACellDemoBotManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	bLogReport = true;
+	WindowTime = 0.0f;
+	WindowMaxFrameTime = 0.0f;
+	WindowGameThreadTime = 0.0f;
+	WindowFrames = 0;
+}
+
+ACellDemoBotManager* ACellDemoBotManager::Get(UWorld* World)
+{
+	if (World == nullptr || World->GetAuthGameMode() == nullptr)
+	{
+		return nullptr;
+	}
+
+	for (TActorIterator<ACellDemoBotManager> It(World); It; ++It)
+	{
+		return *It;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	return World->SpawnActor<ACellDemoBotManager>(SpawnParams);
+}
+
+void ACellDemoBotManager::SpawnBots(int32 Count, ECellBotPattern Pattern, float ClicksPerSecond)
+{
+	for (int32 i = 0; i < Count; i++)
+	{
+		if (SpawnBot(Pattern, ClicksPerSecond) == nullptr)
+		{
+			break;
+		}
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Bots: %d bots running"), Bots.Num());
+}
+
+ACellDemoPlayerController* ACellDemoBotManager::SpawnBot(ECellBotPattern Pattern, float ClicksPerSecond)
+{
+	UWorld* World = GetWorld();
+	AGameModeBase* GameMode = World->GetAuthGameMode();
+	if (GameMode == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Use the controller class of the game mode when it is one of ours, so the bots run the exact same code as players
+	UClass* ControllerClass = GameMode->PlayerControllerClass;
+	if (ControllerClass == nullptr || !ControllerClass->IsChildOf(ACellDemoPlayerController::StaticClass()))
+	{
+		ControllerClass = ACellDemoPlayerController::StaticClass();
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.ObjectFlags |= RF_Transient;
+
+	ACellDemoPlayerController* Bot = World->SpawnActor<ACellDemoPlayerController>(ControllerClass, SpawnParams);
+	if (Bot == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (Bot->PlayerState != nullptr)
+	{
+		Bot->PlayerState->bIsABot = true;
+		Bot->PlayerState->SetPlayerName(FString::Printf(TEXT("Bot%d"), Bots.Num()));
+	}
+
+	// Same admission as a player joining, bursts of bots go through the admission queue
+	GameMode->HandleStartingNewPlayer(Bot);
+
+	UCellDemoBotComponent* Driver = NewObject<UCellDemoBotComponent>(Bot);
+	Driver->Pattern = Pattern;
+	Driver->ClicksPerSecond = ClicksPerSecond;
+	Driver->RegisterComponent();
+
+	Bots.Add(Bot);
+	return Bot;
+}
+
+void ACellDemoBotManager::RemoveBot(ACellDemoPlayerController* Bot)
+{
+	if (Bot != nullptr && !Bot->IsPendingKill())
+	{
+		if (APawn* Pawn = Bot->GetPawn())
+		{
+			Pawn->Destroy();
+		}
+		Bot->Destroy();
+	}
+	Bots.Remove(Bot);
+}
+
+void ACellDemoBotManager::ClearBots()
+{
+	while (Bots.Num() > 0)
+	{
+		RemoveBot(Bots.Last());
+	}
+}
+
+void ACellDemoBotManager::SetBotsPattern(ECellBotPattern Pattern, FVector SwarmLocation)
+{
+	for (ACellDemoPlayerController* Bot : Bots)
+	{
+		if (UCellDemoBotComponent* Driver = Bot != nullptr ? Bot->FindComponentByClass<UCellDemoBotComponent>() : nullptr)
+		{
+			Driver->Pattern = Pattern;
+			Driver->SwarmLocation = SwarmLocation;
+		}
+	}
+}
+
+void ACellDemoBotManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (WindowFrames == 0)
+	{
+		WindowStartStats = FCellDemoServerStatsSample::Capture();
+	}
+
+	WindowTime += DeltaSeconds;
+	WindowMaxFrameTime = FMath::Max(WindowMaxFrameTime, DeltaSeconds);
+	WindowGameThreadTime += FPlatformTime::ToMilliseconds(GGameThreadTime);
+	WindowFrames++;
+
+	if (WindowTime >= 1.0f)
+	{
+		PublishReport();
+	}
+}
+
+void ACellDemoBotManager::PublishReport()
+{
+	const FCellDemoServerStatsSample Stats = FCellDemoServerStatsSample::Capture();
+	const int32 NavQueries = Stats.NavQueries - WindowStartStats.NavQueries;
+	const int32 PathCacheHits = Stats.PathCacheHits - WindowStartStats.PathCacheHits;
+	const int32 PathCacheRequests = PathCacheHits + Stats.PathCacheMisses - WindowStartStats.PathCacheMisses;
+
+	LastReport.NumBots = Bots.Num();
+	LastReport.AvgFrameTimeMs = WindowTime * 1000.0f / WindowFrames;
+	LastReport.MaxFrameTimeMs = WindowMaxFrameTime * 1000.0f;
+	LastReport.GameThreadTimeMs = WindowGameThreadTime / WindowFrames;
+	LastReport.MoveRpcsPerSecond = FMath::RoundToInt((Stats.MoveRequests - WindowStartStats.MoveRequests) / WindowTime);
+	LastReport.NavQueriesPerSecond = FMath::RoundToInt(NavQueries / WindowTime);
+	LastReport.AvgNavQueryMs = NavQueries > 0 ? (Stats.NavQueryTime - WindowStartStats.NavQueryTime) * 1000.0 / NavQueries : 0.0f;
+	LastReport.PathCacheHitPercent = PathCacheRequests > 0 ? 100.0f * PathCacheHits / PathCacheRequests : 0.0f;
+	LastReport.PathCacheSavedMs = (Stats.PathCacheSavedTime - WindowStartStats.PathCacheSavedTime) * 1000.0 / WindowTime;
+
+	if (bLogReport)
+	{
+		UE_LOG(LogCellDemo, Log, TEXT("Bots: %d | frame %.2f ms (max %.2f, game %.2f) | move rpc/s %d | nav query/s %d (%.3f ms avg) | path cache %.0f%% hits, %.2f ms/s saved"),
+			LastReport.NumBots, LastReport.AvgFrameTimeMs, LastReport.MaxFrameTimeMs, LastReport.GameThreadTimeMs,
+			LastReport.MoveRpcsPerSecond, LastReport.NavQueriesPerSecond, LastReport.AvgNavQueryMs, LastReport.PathCacheHitPercent, LastReport.PathCacheSavedMs);
+	}
+
+	WindowTime = 0.0f;
+	WindowMaxFrameTime = 0.0f;
+	WindowGameThreadTime = 0.0f;
+	WindowFrames = 0;
+}
+
+// *******************************
+// Console
+// *******************************
+
+static void SpawnBotsCommand(const TArray<FString>& Args, UWorld* World)
+{
+	ACellDemoBotManager* Manager = ACellDemoBotManager::Get(World);
+	if (Manager == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Bots can only be spawned on the server"));
+		return;
+	}
+
+	const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1;
+
+	const ECellBotPattern Pattern = Args.Num() > 1 ? UCellDemoBotComponent::ParsePattern(Args[1]) : ECellBotPattern::RandomWalk;
+
+	const float ClicksPerSecond = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 1.0f;
+
+	Manager->SpawnBots(Count, Pattern, ClicksPerSecond);
+}
+
+static void ClearBotsCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (ACellDemoBotManager* Manager = ACellDemoBotManager::Get(World))
+	{
+		Manager->ClearBots();
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SpawnBotsCmd(
+	TEXT("CellDemo.Bots.Spawn"),
+	TEXT("Spawns bot players on the server. Usage: CellDemo.Bots.Spawn <Count> [Idle|RandomWalk|SwarmToPoint] [ClicksPerSecond]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(SpawnBotsCommand));
+
+static FAutoConsoleCommandWithWorldAndArgs ClearBotsCmd(
+	TEXT("CellDemo.Bots.Clear"),
+	TEXT("Removes all the bot players"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(ClearBotsCommand));
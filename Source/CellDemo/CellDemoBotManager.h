@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CellDemoBotComponent.h"
+#include "CellDemoStats.h"
+#include "CellDemoBotManager.generated.h"
+
+/** Server load measured over the last second */
+USTRUCT(BlueprintType)
+struct FCellBotLoadReport
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumBots;
+
+	/** Average and worst frame time, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AvgFrameTimeMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	float MaxFrameTimeMs;
+
+	/** Game thread time without the idle wait, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float GameThreadTimeMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 MoveRpcsPerSecond;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NavQueriesPerSecond;
+
+	/** Average duration of a navigation query, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AvgNavQueryMs;
+
+	/** Share of the path requests answered by the path cache, in percent */
+	UPROPERTY(BlueprintReadOnly)
+	float PathCacheHitPercent;
+
+	/** Path finding time saved by the path cache, in milliseconds per second */
+	UPROPERTY(BlueprintReadOnly)
+	float PathCacheSavedMs;
+
+	FCellBotLoadReport()
+		: NumBots(0)
+		, AvgFrameTimeMs(0.0f)
+		, MaxFrameTimeMs(0.0f)
+		, GameThreadTimeMs(0.0f)
+		, MoveRpcsPerSecond(0)
+		, NavQueriesPerSecond(0)
+		, AvgNavQueryMs(0.0f)
+		, PathCacheHitPercent(0.0f)
+		, PathCacheSavedMs(0.0f)
+	{
+	}
+};
+
+/**
+*	Spawns bot player controllers on the server and reports the load they generate.
+*	Console: CellDemo.Bots.Spawn <Count> [Idle|RandomWalk|SwarmToPoint] [ClicksPerSecond], CellDemo.Bots.Clear
+*/
+UCLASS()
+class ACellDemoBotManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACellDemoBotManager();
+
+	/** Finds the bot manager of the world, spawning it if needed. Server only. */
+	static ACellDemoBotManager* Get(UWorld* World);
+
+	UFUNCTION(BlueprintCallable, Category = "Network|Test")
+	void SpawnBots(int32 Count, ECellBotPattern Pattern, float ClicksPerSecond);
+
+	UFUNCTION(BlueprintCallable, Category = "Network|Test")
+	void ClearBots();
+
+	/** Spawns one bot, nullptr if it could not be spawned */
+	class ACellDemoPlayerController* SpawnBot(ECellBotPattern Pattern, float ClicksPerSecond);
+
+	/** Destroys one bot and its pawn */
+	void RemoveBot(class ACellDemoPlayerController* Bot);
+
+	/** Changes the pattern of all the bots, SwarmLocation is only used by SwarmToPoint */
+	UFUNCTION(BlueprintCallable, Category = "Network|Test")
+	void SetBotsPattern(ECellBotPattern Pattern, FVector SwarmLocation);
+
+	int32 GetNumBots() const { return Bots.Num(); }
+
+	/** Log the report every second */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	bool bLogReport;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Bot")
+	FCellBotLoadReport LastReport;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	UPROPERTY(Transient)
+	TArray<class ACellDemoPlayerController*> Bots;
+
+	/** Accumulators for the current one second window */
+	float WindowTime;
+	float WindowMaxFrameTime;
+	float WindowGameThreadTime;
+	int32 WindowFrames;
+	FCellDemoServerStatsSample WindowStartStats;
+
+	void PublishReport();
+};
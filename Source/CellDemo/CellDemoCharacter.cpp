@@ -10,8 +10,15 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Materials/Material.h"
+#include "CellDemoPlayerController.h"
+#include "CellDemoInitialSyncComponent.h"
+#include "CellDemoBandwidthComponent.h"
+#include "CellDemoCrowdMovementComponent.h"
+#include "CellDemoPowerGovernor.h"
+#include "CellNWGameInstance.h"
 
-ACellDemoCharacter::ACellDemoCharacter()
+ACellDemoCharacter::ACellDemoCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UCellDemoCrowdMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for player capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -54,12 +61,48 @@ ACellDemoCharacter::ACellDemoCharacter()
 	// Activate ticking in order to update the cursor every frame.
 	PrimaryActorTick.bCanEverTick = true;
 	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	CursorTraceTime = 0.0f;
+	BaseNetUpdateFrequency = 0.0f;
+	NetUpdateFrequencyScale = 1.0f;
+}
+
+void ACellDemoCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// The Blueprint defaults are applied by now
+	BaseNetUpdateFrequency = NetUpdateFrequency;
+}
+
+const UCellDemoPowerGovernor* ACellDemoCharacter::GetPowerGovernor() const
+{
+	const UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetGameInstance());
+	return GameInstance != nullptr ? GameInstance->PowerGovernor : nullptr;
 }
 
 void ACellDemoCharacter::Tick(float DeltaSeconds)
 {
     Super::Tick(DeltaSeconds);
 
+	const UCellDemoPowerGovernor* PowerGovernor = GetPowerGovernor();
+
+	// Only touched when the power level changes, so whatever else sets the frequency meanwhile stays
+	const float NewNetUpdateFrequencyScale = PowerGovernor != nullptr ? PowerGovernor->GetNetUpdateFrequencyScale() : 1.0f;
+	if (Role == ROLE_Authority && NewNetUpdateFrequencyScale != NetUpdateFrequencyScale)
+	{
+		NetUpdateFrequencyScale = NewNetUpdateFrequencyScale;
+		NetUpdateFrequency = BaseNetUpdateFrequency * NetUpdateFrequencyScale;
+	}
+
+	// The power governor may trace less often than every frame
+	CursorTraceTime += DeltaSeconds;
+	if (CursorTraceTime < (PowerGovernor != nullptr ? PowerGovernor->GetCursorTraceInterval() : 0.0f))
+	{
+		return;
+	}
+	CursorTraceTime = 0.0f;
+
 	if (CursorToWorld != nullptr)
 	{
 		if (UHeadMountedDisplayFunctionLibrary::IsHeadMountedDisplayEnabled())
@@ -87,3 +130,22 @@ void ACellDemoCharacter::Tick(float DeltaSeconds)
 		}
 	}
 }
+
+bool ACellDemoCharacter::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	const ACellDemoPlayerController* Viewer = Cast<ACellDemoPlayerController>(RealViewer);
+	if (Viewer != nullptr && Viewer->InitialSync != nullptr && !Viewer->InitialSync->IsRelevantDuringSync(this, SrcLocation))
+	{
+		return false;
+	}
+
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+}
+
+float ACellDemoCharacter::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	const float Priority = Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+
+	const ACellDemoPlayerController* CellViewer = Cast<ACellDemoPlayerController>(Viewer);
+	return CellViewer != nullptr && CellViewer->Bandwidth != nullptr ? CellViewer->Bandwidth->ScaleNetPriority(this, ViewPos, Time, Priority) : Priority;
+}
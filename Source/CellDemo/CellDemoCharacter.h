@@ -12,11 +12,20 @@ class ACellDemoCharacter : public ACharacter
 	GENERATED_BODY()
 
 public:
-	ACellDemoCharacter();
+	/** Moves with UCellDemoCrowdMovementComponent, avoided by ACellDemoCrowdManager */
+	ACellDemoCharacter(const FObjectInitializer& ObjectInitializer);
 
 	// Called every frame.
 	virtual void Tick(float DeltaSeconds) override;
 
+	virtual void BeginPlay() override;
+
+	/** Characters far from a player still syncing the cell are sent to it later */
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	/** Scaled by the priority class the character has for the viewing player, see UCellDemoBandwidthComponent */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
 	/** Returns TopDownCameraComponent subobject **/
 	FORCEINLINE class UCameraComponent* GetTopDownCameraComponent() const { return TopDownCameraComponent; }
 	/** Returns CameraBoom subobject **/
@@ -36,5 +45,15 @@ private:
 	/** A decal that projects to the cursor location. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UDecalComponent* CursorToWorld;
+
+	/** Time since the last cursor trace */
+	float CursorTraceTime;
+
+	/** Net update frequency before the power scale, as set up by the Blueprint, and the scale applied to it */
+	float BaseNetUpdateFrequency;
+	float NetUpdateFrequencyScale;
+
+	/** Power governor of the game instance, null on a dedicated server without one */
+	const class UCellDemoPowerGovernor* GetPowerGovernor() const;
 };
 
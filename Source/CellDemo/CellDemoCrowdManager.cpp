@@ -0,0 +1,632 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoCrowdManager.h"
+#include "CellDemo.h"
+#include "CellDemoBotManager.h"
+#include "CellDemoCrowdMovementComponent.h"
+#include "CellDemoPlayerController.h"
+#include "AI/Navigation/NavigationSystem.h"
+#include "Async/ParallelFor.h"
+#include "Components/CapsuleComponent.h"
+#include "Containers/Ticker.h"
+#include "EngineUtils.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+/** Agents register on every spawn, don't look for the manager in the actor list every time */
+static TWeakObjectPtr<ACellDemoCrowdManager> GCrowdManager;
+
+ACellDemoCrowdManager::ACellDemoCrowdManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	// After the path following of the controllers asked for this frame's velocities
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	bEnabled = true;
+	CellSize = 300.0f;
+	NeighbourRadius = 300.0f;
+	MaxNeighbours = 8;
+	TimeHorizon = 1.0f;
+	SeparationStrength = 0.5f;
+	BudgetMs = 2.0f;
+	MinAgentsPerFrame = 64;
+	BatchSize = 32;
+	StuckSpeed = 20.0f;
+	StuckTime = 2.0f;
+
+	SolveCursor = 0;
+	AgentCostMs = 0.0f;
+	NumMoving = 0;
+	NumStuck = 0;
+	LastSolveMs = 0.0f;
+	WindowTime = 0.0f;
+	WindowSolveMs = 0.0f;
+	WindowMaxSolveMs = 0.0f;
+	WindowFrames = 0;
+	WindowSolved = 0;
+}
+
+ACellDemoCrowdManager* ACellDemoCrowdManager::Get(UWorld* World)
+{
+	ACellDemoCrowdManager* CrowdManager = GCrowdManager.Get();
+	return CrowdManager != nullptr && World != nullptr && CrowdManager->GetWorld() == World && !CrowdManager->IsPendingKill() ? CrowdManager : nullptr;
+}
+
+void ACellDemoCrowdManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	GCrowdManager = this;
+
+	// A neighbour query only reads the cells next to the one of the agent
+	CellSize = FMath::Max(CellSize, NeighbourRadius);
+	MaxNeighbours = FMath::Max(MaxNeighbours, 1);
+	BatchSize = FMath::Max(BatchSize, 1);
+
+	// Characters spawned before the manager
+	for (TActorIterator<ACharacter> It(GetWorld()); It; ++It)
+	{
+		if (UCellDemoCrowdMovementComponent* Agent = Cast<UCellDemoCrowdMovementComponent>(It->GetCharacterMovement()))
+		{
+			RegisterAgent(Agent);
+		}
+	}
+}
+
+void ACellDemoCrowdManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (GCrowdManager.Get() == this)
+	{
+		GCrowdManager.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACellDemoCrowdManager::RegisterAgent(UCellDemoCrowdMovementComponent* Agent)
+{
+	if (Agent->GetOwnerRole() == ROLE_Authority)
+	{
+		Agents.AddUnique(Agent);
+	}
+}
+
+void ACellDemoCrowdManager::UnregisterAgent(UCellDemoCrowdMovementComponent* Agent)
+{
+	Agents.RemoveSwap(Agent);
+}
+
+void ACellDemoCrowdManager::SetEnabled(bool bInEnabled)
+{
+	bEnabled = bInEnabled;
+	for (UCellDemoCrowdMovementComponent* Agent : Agents)
+	{
+		Agent->bHasAvoidanceVelocity = false;
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Crowd: avoidance %s for %d agents"), bEnabled ? TEXT("on") : TEXT("off"), Agents.Num());
+}
+
+void ACellDemoCrowdManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	Agents.RemoveAllSwap([](const UCellDemoCrowdMovementComponent* Agent) { return Agent == nullptr || Agent->IsPendingKill() || Agent->CharacterOwner == nullptr; });
+
+	// The stuck agents are counted without the avoidance too, to compare
+	Snapshot(DeltaSeconds);
+	if (bEnabled && SolveAgents.Num() > 0)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		BuildHash();
+		Solve();
+		LastSolveMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		WindowSolveMs += LastSolveMs;
+		WindowMaxSolveMs = FMath::Max(WindowMaxSolveMs, LastSolveMs);
+		WindowFrames++;
+	}
+	else
+	{
+		LastSolveMs = 0.0f;
+	}
+
+	WindowTime += DeltaSeconds;
+	if (WindowTime >= 1.0f)
+	{
+		PublishReport();
+	}
+}
+
+void ACellDemoCrowdManager::Snapshot(float DeltaSeconds)
+{
+	const int32 NumAgents = Agents.Num();
+	Positions.SetNumUninitialized(NumAgents, false);
+	Velocities.SetNumUninitialized(NumAgents, false);
+	PreferredVelocities.SetNumUninitialized(NumAgents, false);
+	Radii.SetNumUninitialized(NumAgents, false);
+	MaxSpeeds.SetNumUninitialized(NumAgents, false);
+	Results.SetNumUninitialized(NumAgents, false);
+	SolveAgents.Reset();
+	NumMoving = 0;
+	NumStuck = 0;
+
+	for (int32 Index = 0; Index < NumAgents; Index++)
+	{
+		UCellDemoCrowdMovementComponent* Agent = Agents[Index];
+		Positions[Index] = FVector2D(Agent->CharacterOwner->GetActorLocation());
+		Velocities[Index] = FVector2D(Agent->Velocity);
+		Radii[Index] = Agent->CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleRadius();
+		MaxSpeeds[Index] = Agent->GetMaxSpeed();
+
+		// Standing agents are obstacles to the others, nothing to solve for them
+		if (!Agent->IsCrowdMoving())
+		{
+			PreferredVelocities[Index] = FVector2D::ZeroVector;
+			Agent->bHasAvoidanceVelocity = false;
+			Agent->StuckTime = 0.0f;
+			continue;
+		}
+
+		PreferredVelocities[Index] = FVector2D(Agent->PreferredVelocity);
+		SolveAgents.Add(Index);
+		NumMoving++;
+
+		Agent->StuckTime = Velocities[Index].SizeSquared() < FMath::Square(StuckSpeed) ? Agent->StuckTime + DeltaSeconds : 0.0f;
+		if (Agent->StuckTime >= StuckTime)
+		{
+			NumStuck++;
+		}
+	}
+}
+
+int32 ACellDemoCrowdManager::GetBucket(const FIntPoint& Cell) const
+{
+	// A power of two of buckets, plus the end of the last one
+	const uint32 Hash = ((uint32)Cell.X * 73856093u) ^ ((uint32)Cell.Y * 19349663u);
+	return Hash & (BucketStarts.Num() - 2);
+}
+
+void ACellDemoCrowdManager::BuildHash()
+{
+	// Twice as many buckets as agents keeps the collisions of distinct cells low, the extra entry ends the last bucket
+	const int32 NumAgents = Positions.Num();
+	const int32 NumBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(NumAgents * 2, 64));
+	BucketStarts.Reset();
+	BucketStarts.SetNumZeroed(NumBuckets + 1);
+	AgentCells.SetNumUninitialized(NumAgents, false);
+	SortedAgents.SetNumUninitialized(NumAgents, false);
+
+	// Counting sort: count the agents of every bucket, turn the counts into bucket ends, then fill every bucket from its end
+	for (int32 Index = 0; Index < NumAgents; Index++)
+	{
+		AgentCells[Index] = FIntPoint(FMath::FloorToInt(Positions[Index].X / CellSize), FMath::FloorToInt(Positions[Index].Y / CellSize));
+		BucketStarts[GetBucket(AgentCells[Index])]++;
+	}
+
+	for (int32 Bucket = 1; Bucket < NumBuckets; Bucket++)
+	{
+		BucketStarts[Bucket] += BucketStarts[Bucket - 1];
+	}
+	BucketStarts[NumBuckets] = NumAgents;
+
+	for (int32 Index = NumAgents - 1; Index >= 0; Index--)
+	{
+		SortedAgents[--BucketStarts[GetBucket(AgentCells[Index])]] = Index;
+	}
+}
+
+void ACellDemoCrowdManager::Solve()
+{
+	const int32 NumSolveAgents = SolveAgents.Num();
+	int32 Count = AgentCostMs > 0.0f ? FMath::FloorToInt(BudgetMs / AgentCostMs) : NumSolveAgents;
+	Count = FMath::Clamp(Count, FMath::Min(MinAgentsPerFrame, NumSolveAgents), NumSolveAgents);
+	SolveCursor = SolveCursor < NumSolveAgents ? SolveCursor : 0;
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 NumBatches = FMath::DivideAndRoundUp(Count, BatchSize);
+	ParallelFor(NumBatches, [this, Count, NumSolveAgents](int32 Batch)
+	{
+		const int32 End = FMath::Min((Batch + 1) * BatchSize, Count);
+		for (int32 Solved = Batch * BatchSize; Solved < End; Solved++)
+		{
+			SolveAgent(SolveAgents[(SolveCursor + Solved) % NumSolveAgents]);
+		}
+	});
+
+	// Per agent cost at the current parallelism, the next frame solves what fits in the budget
+	const float CostMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Count;
+	AgentCostMs = AgentCostMs > 0.0f ? FMath::Lerp(AgentCostMs, CostMs, 0.1f) : CostMs;
+
+	for (int32 Solved = 0; Solved < Count; Solved++)
+	{
+		const int32 Index = SolveAgents[(SolveCursor + Solved) % NumSolveAgents];
+		Agents[Index]->AvoidanceVelocity = FVector(Results[Index], 0.0f);
+		Agents[Index]->bHasAvoidanceVelocity = true;
+	}
+
+	SolveCursor = (SolveCursor + Count) % NumSolveAgents;
+	WindowSolved += Count;
+}
+
+void ACellDemoCrowdManager::SolveAgent(int32 Index)
+{
+	const FVector2D Position = Positions[Index];
+	const FVector2D Preferred = PreferredVelocities[Index];
+	const float Radius = Radii[Index];
+	const float MaxSpeed = MaxSpeeds[Index];
+	const FIntPoint Cell = AgentCells[Index];
+	const float NeighbourRadiusSq = FMath::Square(NeighbourRadius);
+
+	// Closest neighbours, the farthest is replaced once full
+	TArray<TPair<float, int32>, TInlineAllocator<16>> Neighbours;
+	for (int32 Y = -1; Y <= 1; Y++)
+	{
+		for (int32 X = -1; X <= 1; X++)
+		{
+			const FIntPoint NeighbourCell(Cell.X + X, Cell.Y + Y);
+			const int32 Bucket = GetBucket(NeighbourCell);
+			for (int32 Sorted = BucketStarts[Bucket]; Sorted < BucketStarts[Bucket + 1]; Sorted++)
+			{
+				// Other cells may share the bucket
+				const int32 Other = SortedAgents[Sorted];
+				if (Other == Index || AgentCells[Other] != NeighbourCell)
+				{
+					continue;
+				}
+
+				const float DistSq = (Positions[Other] - Position).SizeSquared();
+				if (DistSq > NeighbourRadiusSq)
+				{
+					continue;
+				}
+
+				if (Neighbours.Num() < MaxNeighbours)
+				{
+					Neighbours.Emplace(DistSq, Other);
+					continue;
+				}
+
+				int32 Farthest = 0;
+				for (int32 Neighbour = 1; Neighbour < Neighbours.Num(); Neighbour++)
+				{
+					Farthest = Neighbours[Neighbour].Key > Neighbours[Farthest].Key ? Neighbour : Farthest;
+				}
+				if (DistSq < Neighbours[Farthest].Key)
+				{
+					Neighbours[Farthest] = TPair<float, int32>(DistSq, Other);
+				}
+			}
+		}
+	}
+
+	FVector2D Avoidance = FVector2D::ZeroVector;
+	for (const TPair<float, int32>& Neighbour : Neighbours)
+	{
+		const int32 Other = Neighbour.Value;
+		const FVector2D Offset = Positions[Other] - Position;
+		const float CombinedRadius = Radius + Radii[Other];
+
+		// Already overlapping, push apart, the lower index picks a side when they are on top of each other
+		if (Neighbour.Key < FMath::Square(CombinedRadius))
+		{
+			const float Dist = FMath::Sqrt(Neighbour.Key);
+			const FVector2D Away = Dist > KINDA_SMALL_NUMBER ? -Offset / Dist : FVector2D(Index < Other ? 1.0f : -1.0f, 0.0f);
+			Avoidance += Away * MaxSpeed * SeparationStrength * (CombinedRadius - Dist) / CombinedRadius;
+			continue;
+		}
+
+		// Time to collision if this agent takes its preferred velocity and the other one keeps its current velocity
+		const FVector2D RelativeVelocity = Preferred - Velocities[Other];
+		const float A = FVector2D::DotProduct(RelativeVelocity, RelativeVelocity);
+		const float B = FVector2D::DotProduct(Offset, RelativeVelocity);
+		const float C = Neighbour.Key - FMath::Square(CombinedRadius);
+		const float Discriminant = B * B - A * C;
+		if (A < KINDA_SMALL_NUMBER || B <= 0.0f || Discriminant <= 0.0f)
+		{
+			continue;
+		}
+
+		const float TimeToCollision = (B - FMath::Sqrt(Discriminant)) / A;
+		if (TimeToCollision >= TimeHorizon)
+		{
+			continue;
+		}
+
+		// Steer away from where the other one will be, the sooner the harder, and pass on the right of a head on collision
+		const FVector2D CollisionNormal = (Offset - RelativeVelocity * TimeToCollision).GetSafeNormal();
+		const FVector2D Right = FVector2D(RelativeVelocity.Y, -RelativeVelocity.X).GetSafeNormal();
+		const float Strength = MaxSpeed * (TimeHorizon - TimeToCollision) / TimeHorizon;
+		Avoidance -= CollisionNormal * Strength;
+		if (FMath::Abs(FVector2D::DotProduct(CollisionNormal, Right)) < 0.1f)
+		{
+			Avoidance += Right * Strength * 0.5f;
+		}
+	}
+
+	FVector2D Velocity = Preferred + Avoidance;
+	const float Speed = Velocity.Size();
+	if (Speed > MaxSpeed)
+	{
+		Velocity *= MaxSpeed / Speed;
+	}
+	Results[Index] = Velocity;
+}
+
+void ACellDemoCrowdManager::PublishReport()
+{
+	// Quiet when nobody walks
+	if (NumMoving > 0)
+	{
+		UE_LOG(LogCellDemo, Log, TEXT("Crowd: %d agents, %d moving, %d stuck | solve %.2f ms avg %.2f ms max, %d agents per frame"),
+			Agents.Num(), NumMoving, NumStuck, WindowFrames > 0 ? WindowSolveMs / WindowFrames : 0.0f, WindowMaxSolveMs,
+			WindowFrames > 0 ? WindowSolved / WindowFrames : 0);
+	}
+
+	WindowTime = 0.0f;
+	WindowSolveMs = 0.0f;
+	WindowMaxSolveMs = 0.0f;
+	WindowFrames = 0;
+	WindowSolved = 0;
+}
+
+// *******************************
+// Bench
+// *******************************
+
+/**
+*	For every agent count: spawns that many bots, scatters their characters around the first one and sends them all to
+*	its location, then measures the server frames and counts the stuck agents for Duration.
+*	Results are logged and appended to Saved/Profiling/CellCrowd/Bench.csv, with the avoidance on or off.
+*/
+class FCellDemoCrowdBench : public FTickerObjectBase
+{
+public:
+	FCellDemoCrowdBench(UWorld* InWorld, const TArray<int32>& InAgentCounts, float InDuration, bool bInExitWhenDone)
+		: World(InWorld)
+		, AgentCounts(InAgentCounts)
+		, Duration(InDuration)
+		, bExitWhenDone(bInExitWhenDone)
+		, Run(-1)
+		, bRunning(false)
+		, StageStartTime(0.0)
+		, Goal(FVector::ZeroVector)
+		, SolveMs(0.0)
+		, MaxSolveMs(0.0f)
+		, PeakStuck(0)
+	{
+		StartNextRun();
+	}
+
+	bool IsDone() const { return !World.IsValid() || Run >= AgentCounts.Num(); }
+
+	virtual bool Tick(float DeltaTime) override
+	{
+		if (IsDone())
+		{
+			return true;
+		}
+
+		ACellDemoCrowdManager* CrowdManager = ACellDemoCrowdManager::Get(World.Get());
+		if (!bRunning)
+		{
+			// Bots go through the admission queue, wait for their characters
+			TArray<ACellDemoPlayerController*> Bots = GetBots();
+			const int32 NumPawns = Bots.FilterByPredicate([](const ACellDemoPlayerController* Bot) { return Bot->GetPawn() != nullptr; }).Num();
+			if (NumPawns >= AgentCounts[Run] || FPlatformTime::Seconds() - StageStartTime > 60.0)
+			{
+				SendBots(Bots);
+			}
+			return true;
+		}
+
+		GameThreadTimes.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+		if (CrowdManager != nullptr)
+		{
+			SolveMs += CrowdManager->GetLastSolveMs();
+			MaxSolveMs = FMath::Max(MaxSolveMs, CrowdManager->GetLastSolveMs());
+			PeakStuck = FMath::Max(PeakStuck, CrowdManager->GetNumStuck());
+		}
+
+		if (FPlatformTime::Seconds() - StageStartTime > Duration)
+		{
+			Report(CrowdManager);
+			StartNextRun();
+		}
+		return true;
+	}
+
+private:
+	TWeakObjectPtr<UWorld> World;
+	TArray<int32> AgentCounts;
+	float Duration;
+	bool bExitWhenDone;
+
+	/** Index in AgentCounts, spawning while !bRunning */
+	int32 Run;
+	bool bRunning;
+	double StageStartTime;
+	FVector Goal;
+
+	TArray<float> GameThreadTimes;
+	double SolveMs;
+	float MaxSolveMs;
+	int32 PeakStuck;
+
+	TArray<ACellDemoPlayerController*> GetBots() const
+	{
+		TArray<ACellDemoPlayerController*> Bots;
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			ACellDemoPlayerController* Controller = Cast<ACellDemoPlayerController>(It->Get());
+			if (Controller != nullptr && Controller->PlayerState != nullptr && Controller->PlayerState->bIsABot)
+			{
+				Bots.Add(Controller);
+			}
+		}
+		return Bots;
+	}
+
+	void StartNextRun()
+	{
+		ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(World.Get());
+		if (BotManager != nullptr)
+		{
+			BotManager->ClearBots();
+		}
+
+		Run++;
+		bRunning = false;
+		StageStartTime = FPlatformTime::Seconds();
+		if (IsDone())
+		{
+			if (bExitWhenDone)
+			{
+				FPlatformMisc::RequestExit(false);
+			}
+			return;
+		}
+
+		if (BotManager != nullptr)
+		{
+			BotManager->SpawnBots(AgentCounts[Run], ECellBotPattern::Idle, 0.0f);
+		}
+	}
+
+	void SendBots(const TArray<ACellDemoPlayerController*>& Bots)
+	{
+		// Scattered on the navmesh around the first character, so they all come from somewhere else
+		UNavigationSystem* NavSys = World->GetNavigationSystem();
+		const APawn* FirstPawn = Bots.Num() > 0 ? Bots[0]->GetPawn() : nullptr;
+		Goal = FirstPawn != nullptr ? FirstPawn->GetActorLocation() : FVector::ZeroVector;
+		const float ScatterRadius = 500.0f + 150.0f * FMath::Sqrt((float)AgentCounts[Run]);
+
+		for (ACellDemoPlayerController* Bot : Bots)
+		{
+			APawn* Pawn = Bot->GetPawn();
+			if (Pawn == nullptr)
+			{
+				continue;
+			}
+
+			FVector Location = Goal + FVector(FMath::RandPointInCircle(ScatterRadius), 0.0f);
+			FNavLocation NavLocation;
+			if (NavSys != nullptr && NavSys->ProjectPointToNavigation(Location, NavLocation))
+			{
+				Location = NavLocation.Location;
+			}
+			Location.Z = Pawn->GetActorLocation().Z;
+			Pawn->SetActorLocation(Location, false, nullptr, ETeleportType::TeleportPhysics);
+			Bot->IssueMoveDestination(Goal);
+		}
+
+		bRunning = true;
+		StageStartTime = FPlatformTime::Seconds();
+		GameThreadTimes.Reset();
+		SolveMs = 0.0;
+		MaxSolveMs = 0.0f;
+		PeakStuck = 0;
+	}
+
+	void Report(const ACellDemoCrowdManager* CrowdManager)
+	{
+		float AvgGameThreadMs = 0.0f;
+		for (float GameThreadMs : GameThreadTimes)
+		{
+			AvgGameThreadMs += GameThreadMs;
+		}
+		AvgGameThreadMs = GameThreadTimes.Num() > 0 ? AvgGameThreadMs / GameThreadTimes.Num() : 0.0f;
+
+		GameThreadTimes.Sort();
+		const float P95GameThreadMs = GameThreadTimes.Num() > 0 ? GameThreadTimes[FMath::Min(GameThreadTimes.Num() - 1, FMath::FloorToInt(GameThreadTimes.Num() * 0.95f))] : 0.0f;
+		const float AvgSolveMs = GameThreadTimes.Num() > 0 ? SolveMs / GameThreadTimes.Num() : 0.0f;
+
+		const bool bAvoidance = CrowdManager != nullptr && CrowdManager->bEnabled;
+		const int32 NumAgents = CrowdManager != nullptr ? CrowdManager->GetNumAgents() : 0;
+		const int32 NumMoving = CrowdManager != nullptr ? CrowdManager->GetNumMoving() : 0;
+		const int32 NumStuck = CrowdManager != nullptr ? CrowdManager->GetNumStuck() : 0;
+
+		UE_LOG(LogCellDemo, Log, TEXT("Crowd bench: %d agents, avoidance %s | game thread %.2f ms avg, %.2f ms p95 | solve %.2f ms avg, %.2f ms max | %d still moving, %d stuck, %d at peak"),
+			NumAgents, bAvoidance ? TEXT("on") : TEXT("off"), AvgGameThreadMs, P95GameThreadMs, AvgSolveMs, MaxSolveMs, NumMoving, NumStuck, PeakStuck);
+
+		const FString FilePath = FPaths::ProjectSavedDir() / TEXT("Profiling/CellCrowd/Bench.csv");
+		FString Line = FPaths::FileExists(FilePath) ? FString() : TEXT("Date,Agents,Avoidance,AvgGameThreadMs,P95GameThreadMs,AvgSolveMs,MaxSolveMs,Moving,Stuck,PeakStuck\n");
+		Line += FString::Printf(TEXT("%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%d,%d,%d\n"), *FDateTime::Now().ToString(), NumAgents, bAvoidance ? 1 : 0,
+			AvgGameThreadMs, P95GameThreadMs, AvgSolveMs, MaxSolveMs, NumMoving, NumStuck, PeakStuck);
+		FFileHelper::SaveStringToFile(Line, *FilePath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+	}
+};
+
+static TUniquePtr<FCellDemoCrowdBench> GCrowdBench;
+
+/** Deletes the bench once done, from the core ticker so it doesn't delete itself */
+static FDelegateHandle GCrowdBenchDoneHandle;
+
+void ACellDemoCrowdManager::StartBench(UWorld* World, const FString& AgentCounts, float Duration, bool bExitWhenDone)
+{
+	TArray<FString> CountNames;
+	AgentCounts.ParseIntoArray(CountNames, TEXT(","));
+
+	TArray<int32> Counts;
+	for (const FString& CountName : CountNames)
+	{
+		const int32 Count = FCString::Atoi(*CountName);
+		if (Count > 0)
+		{
+			Counts.Add(Count);
+		}
+	}
+
+	if (ACellDemoCrowdManager::Get(World) == nullptr || Counts.Num() == 0)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Crowd bench: needs the server of a cell and agent counts"));
+		return;
+	}
+
+	FTicker::GetCoreTicker().RemoveTicker(GCrowdBenchDoneHandle);
+	GCrowdBench = MakeUnique<FCellDemoCrowdBench>(World, Counts, Duration, bExitWhenDone);
+	GCrowdBenchDoneHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([](float DeltaTime)
+	{
+		if (GCrowdBench.IsValid() && GCrowdBench->IsDone())
+		{
+			GCrowdBench.Reset();
+			return false;
+		}
+		return GCrowdBench.IsValid();
+	}));
+
+	UE_LOG(LogCellDemo, Log, TEXT("Crowd bench: %s agents, %.0f s each"), *AgentCounts, Duration);
+}
+
+// *******************************
+// Console
+// *******************************
+
+static void CrowdEnableCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (ACellDemoCrowdManager* CrowdManager = ACellDemoCrowdManager::Get(World))
+	{
+		CrowdManager->SetEnabled(Args.Num() > 0 ? FCString::Atoi(*Args[0]) != 0 : !CrowdManager->bEnabled);
+	}
+}
+
+static void CrowdBenchCommand(const TArray<FString>& Args, UWorld* World)
+{
+	ACellDemoCrowdManager::StartBench(World, Args.Num() > 0 ? Args[0] : TEXT("100,250,500,1000"), Args.Num() > 1 ? FCString::Atof(*Args[1]) : 20.0f, false);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CrowdEnableCmd(
+	TEXT("CellDemo.Crowd.Enable"),
+	TEXT("Turns the crowd avoidance of the characters on or off. Usage: CellDemo.Crowd.Enable [0|1]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(CrowdEnableCommand));
+
+static FAutoConsoleCommandWithWorldAndArgs CrowdBenchCmd(
+	TEXT("CellDemo.Crowd.Bench"),
+	TEXT("Sends crowds of bots to one point and reports the server frame time and the stuck agents. Usage: CellDemo.Crowd.Bench [Agents,Agents,...] [Seconds]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(CrowdBenchCommand));
@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CellDemoCrowdManager.generated.h"
+
+/**
+*	Server side local avoidance of the characters, scaling with the size of the crowd.
+*
+*	Every frame the agents (UCellDemoCrowdMovementComponent) are snapshotted and sorted into a uniform spatial hash of
+*	CellSize cells, a counting sort into flat arrays, so a neighbour query reads the 3x3 cells around an agent and nothing
+*	else. The agents are then solved in batches spread over the task graph workers: each batch gathers the neighbours
+*	of its agents and computes their avoiding velocity from their preferred one, steering away from every neighbour it
+*	would collide with within TimeHorizon. The solve reads the snapshot and writes its own results only, the velocities
+*	are handed to the agents back on the game thread.
+*
+*	The solve is budgeted: only as many agents as fit in BudgetMs, from the measured cost of an agent, are solved every
+*	frame, round robin, the others keep their last velocity a few more frames.
+*	Agents wanting to move slower than StuckSpeed for StuckTime are counted as stuck, and reported every second.
+*
+*	Console: CellDemo.Crowd.Enable 0|1, CellDemo.Crowd.Bench <Agents[,Agents...]> [Seconds]
+*	Command line: -CellCrowdBench=<Agents[,Agents...]> [-CellCrowdSeconds=<Seconds>], exits once done
+*/
+UCLASS(config = Game)
+class ACellDemoCrowdManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACellDemoCrowdManager();
+
+	/** Returns the crowd manager of the world if there is one, they only exist on the server */
+	static ACellDemoCrowdManager* Get(UWorld* World);
+
+	UPROPERTY(config)
+	bool bEnabled;
+
+	/** Size of a cell of the spatial hash, at least NeighbourRadius */
+	UPROPERTY(config)
+	float CellSize;
+
+	/** Agents further apart are ignored by each other */
+	UPROPERTY(config)
+	float NeighbourRadius;
+
+	/** Closest neighbours considered per agent */
+	UPROPERTY(config)
+	int32 MaxNeighbours;
+
+	/** Collisions further away in time are ignored, in seconds */
+	UPROPERTY(config)
+	float TimeHorizon;
+
+	/** Speed at which overlapping agents are pushed apart, as a share of their max speed */
+	UPROPERTY(config)
+	float SeparationStrength;
+
+	/** Game thread time of the solve per frame, workers included, in milliseconds */
+	UPROPERTY(config)
+	float BudgetMs;
+
+	/** Agents solved per frame whatever the budget */
+	UPROPERTY(config)
+	int32 MinAgentsPerFrame;
+
+	/** Agents solved by one worker task */
+	UPROPERTY(config)
+	int32 BatchSize;
+
+	/** An agent wanting to move slower than StuckSpeed for StuckTime is stuck, in cm/s and seconds */
+	UPROPERTY(config)
+	float StuckSpeed;
+
+	UPROPERTY(config)
+	float StuckTime;
+
+	void RegisterAgent(class UCellDemoCrowdMovementComponent* Agent);
+	void UnregisterAgent(class UCellDemoCrowdMovementComponent* Agent);
+
+	void SetEnabled(bool bInEnabled);
+
+	/** Starts the bench on the server, AgentCounts being a comma separated list of runs. It replaces the running bots. */
+	static void StartBench(UWorld* World, const FString& AgentCounts, float Duration, bool bExitWhenDone);
+
+	int32 GetNumAgents() const { return Agents.Num(); }
+	int32 GetNumMoving() const { return NumMoving; }
+	int32 GetNumStuck() const { return NumStuck; }
+
+	/** Duration of the last solve, in milliseconds */
+	float GetLastSolveMs() const { return LastSolveMs; }
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	UPROPERTY(Transient)
+	TArray<class UCellDemoCrowdMovementComponent*> Agents;
+
+	/** Snapshot of the agents, by index in Agents */
+	TArray<FVector2D> Positions;
+	TArray<FVector2D> Velocities;
+	TArray<FVector2D> PreferredVelocities;
+	TArray<float> Radii;
+	TArray<float> MaxSpeeds;
+	TArray<FVector2D> Results;
+
+	/** Spatial hash: cell of every agent, agents sorted by bucket, and where every bucket starts in SortedAgents */
+	TArray<FIntPoint> AgentCells;
+	TArray<int32> SortedAgents;
+	TArray<int32> BucketStarts;
+
+	/** Moving agents of this frame, and where the solve of the next frame starts in them */
+	TArray<int32> SolveAgents;
+	int32 SolveCursor;
+
+	/** Measured cost of solving one agent, in milliseconds */
+	float AgentCostMs;
+
+	int32 NumMoving;
+	int32 NumStuck;
+	float LastSolveMs;
+
+	/** Report of the current one second window */
+	float WindowTime;
+	float WindowSolveMs;
+	float WindowMaxSolveMs;
+	int32 WindowFrames;
+	int32 WindowSolved;
+
+	void Snapshot(float DeltaSeconds);
+	void BuildHash();
+	void Solve();
+	void SolveAgent(int32 Index);
+	void PublishReport();
+
+	int32 GetBucket(const FIntPoint& Cell) const;
+};
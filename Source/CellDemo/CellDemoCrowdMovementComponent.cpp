@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoCrowdMovementComponent.h"
+#include "CellDemoCrowdManager.h"
+
+UCellDemoCrowdMovementComponent::UCellDemoCrowdMovementComponent()
+{
+	PreferredVelocity = FVector::ZeroVector;
+	PreferredVelocityTime = -1.0f;
+	AvoidanceVelocity = FVector::ZeroVector;
+	bHasAvoidanceVelocity = false;
+	StuckTime = 0.0f;
+}
+
+bool UCellDemoCrowdMovementComponent::IsCrowdMoving() const
+{
+	// Path following requests once per frame, a request older than two frames means the move is over
+	return PreferredVelocityTime >= 0.0f && GetWorld()->GetTimeSeconds() - PreferredVelocityTime <= 2.0f * GetWorld()->GetDeltaSeconds() + KINDA_SMALL_NUMBER;
+}
+
+void UCellDemoCrowdMovementComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (ACellDemoCrowdManager* CrowdManager = ACellDemoCrowdManager::Get(GetWorld()))
+	{
+		CrowdManager->RegisterAgent(this);
+	}
+}
+
+void UCellDemoCrowdMovementComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ACellDemoCrowdManager* CrowdManager = ACellDemoCrowdManager::Get(GetWorld()))
+	{
+		CrowdManager->UnregisterAgent(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UCellDemoCrowdMovementComponent::RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed)
+{
+	// The path following asks for the distance to its next point over the frame time, the agent can't go faster than its max speed
+	PreferredVelocity = FVector(MoveVelocity.X, MoveVelocity.Y, 0.0f).GetClampedToMaxSize(GetMaxSpeed());
+	PreferredVelocityTime = GetWorld()->GetTimeSeconds();
+
+	if (bHasAvoidanceVelocity)
+	{
+		Super::RequestDirectMove(AvoidanceVelocity, false);
+	}
+	else
+	{
+		Super::RequestDirectMove(MoveVelocity, bForceMaxSpeed);
+	}
+}
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "CellDemoCrowdMovementComponent.generated.h"
+
+/**
+*	Character movement of a crowd agent.
+*
+*	The path following of a click to move asks for a velocity every frame through RequestDirectMove. On the server that
+*	velocity is kept as the preferred one of the agent, and replaced by the avoiding velocity ACellDemoCrowdManager
+*	solved for it, so the characters walk around each other instead of piling up on their capsules.
+*/
+UCLASS()
+class UCellDemoCrowdMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoCrowdMovementComponent();
+
+	/** Velocity the path following asked for last, clamped to the max speed, and the world time it asked at */
+	FVector PreferredVelocity;
+	float PreferredVelocityTime;
+
+	/** Velocity solved by the crowd manager, used instead of the preferred one while bHasAvoidanceVelocity */
+	FVector AvoidanceVelocity;
+	bool bHasAvoidanceVelocity;
+
+	/** Time the agent has been wanting to move without moving, in seconds */
+	float StuckTime;
+
+	/** The path following asked for a velocity this frame or the previous one */
+	bool IsCrowdMoving() const;
+
+	// Begin UActorComponent interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End UActorComponent interface
+
+	// Begin UNavMovementComponent interface
+	virtual void RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed) override;
+	// End UNavMovementComponent interface
+};
@@ -3,6 +3,13 @@
 #include "CellDemoGameMode.h"
 #include "CellDemoPlayerController.h"
 #include "CellDemoCharacter.h"
+#include "CellDemoGameState.h"
+#include "CellDemoBotManager.h"
+#include "CellDemoNavManager.h"
+#include "CellDemoCrowdManager.h"
+#include "CellDemoTickGovernor.h"
+#include "CellDemoInputTrace.h"
+#include "CellDemo.h"
 #include "UObject/ConstructorHelpers.h"
 
 ACellDemoGameMode::ACellDemoGameMode()
@@ -10,10 +17,172 @@ ACellDemoGameMode::ACellDemoGameMode()
 	// use our custom PlayerController class
 	PlayerControllerClass = ACellDemoPlayerController::StaticClass();
 
+	// use our game state, it keeps the online status of the game instance up to date
+	GameStateClass = ACellDemoGameState::StaticClass();
+
 	// set default pawn class to our Blueprinted character
 	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/TopDownCPP/Blueprints/TopDownCharacter"));
 	if (PlayerPawnBPClass.Class != NULL)
 	{
 		DefaultPawnClass = PlayerPawnBPClass.Class;
 	}
-}
\ No newline at end of file
+
+	// the admission queue is processed on tick
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	bStagedAdmission = true;
+	AdmissionBudgetMs = 2.0f;
+	TotalQueueWait = 0.0;
+	bAdmissionBurst = false;
+}
+
+void ACellDemoGameMode::BeginPlay()
+{
+	Super::BeginPlay();
+
+	SpawnHelpers();
+}
+
+void ACellDemoGameMode::SpawnHelpers()
+{
+	// Schedules the navigation updates of the block churn
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	GetWorld()->SpawnActor<ACellDemoNavManager>(SpawnParams);
+
+	// Keeps the characters from piling up when they click the same spot
+	GetWorld()->SpawnActor<ACellDemoCrowdManager>(SpawnParams);
+
+	// Throttles the hosted cell while nobody plays in it
+	if (GetNetMode() != NM_Standalone)
+	{
+		GetWorld()->SpawnActor<ACellDemoTickGovernor>(SpawnParams);
+	}
+
+	int32 NumBots = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("CellBots="), NumBots) && NumBots > 0)
+	{
+		FString PatternName;
+		FParse::Value(FCommandLine::Get(), TEXT("CellBotPattern="), PatternName);
+		const ECellBotPattern Pattern = UCellDemoBotComponent::ParsePattern(PatternName);
+
+		float ClicksPerSecond = 1.0f;
+		FParse::Value(FCommandLine::Get(), TEXT("CellBotClicks="), ClicksPerSecond);
+
+		if (ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(GetWorld()))
+		{
+			BotManager->SpawnBots(NumBots, Pattern, ClicksPerSecond);
+		}
+	}
+
+	FString CrowdBench;
+	if (FParse::Value(FCommandLine::Get(), TEXT("CellCrowdBench="), CrowdBench))
+	{
+		float CrowdSeconds = 20.0f;
+		FParse::Value(FCommandLine::Get(), TEXT("CellCrowdSeconds="), CrowdSeconds);
+		ACellDemoCrowdManager::StartBench(GetWorld(), CrowdBench, CrowdSeconds, true);
+	}
+
+	FString TraceFile;
+	if (FParse::Value(FCommandLine::Get(), TEXT("CellTraceReplay="), TraceFile))
+	{
+		float TraceSpeed = 1.0f;
+		FParse::Value(FCommandLine::Get(), TEXT("CellTraceSpeed="), TraceSpeed);
+		ACellDemoTraceReplay::Start(GetWorld(), TraceFile, TraceSpeed, true);
+	}
+	else if (FParse::Param(FCommandLine::Get(), TEXT("CellTraceRecord")))
+	{
+		FCellDemoInputTrace::StartRecording(GetWorld());
+	}
+}
+
+void ACellDemoGameMode::PostLogin(APlayerController* NewPlayer)
+{
+	Super::PostLogin(NewPlayer);
+
+	FCellDemoInputTrace::RecordJoin(NewPlayer);
+}
+
+void ACellDemoGameMode::Logout(AController* Exiting)
+{
+	FCellDemoInputTrace::RecordLeave(Exiting);
+
+	Super::Logout(Exiting);
+}
+
+void ACellDemoGameMode::HandleStartingNewPlayer_Implementation(APlayerController* NewPlayer)
+{
+	if (!bStagedAdmission)
+	{
+		Super::HandleStartingNewPlayer_Implementation(NewPlayer);
+		return;
+	}
+
+	FQueuedPlayer QueuedPlayer;
+	QueuedPlayer.Player = NewPlayer;
+	QueuedPlayer.QueueTime = FPlatformTime::Seconds();
+	AdmissionQueue.Add(QueuedPlayer);
+	bAdmissionBurst = true;
+}
+
+void ACellDemoGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bAdmissionBurst)
+	{
+		AdmitQueuedPlayers(DeltaSeconds);
+	}
+}
+
+void ACellDemoGameMode::AdmitQueuedPlayers(float DeltaSeconds)
+{
+	// Sampled before admitting: the frame that just ended had players queued or being admitted, the first and last ones of the burst included
+	CurrentAdmissionReport.MaxFrameTimeMs = FMath::Max(CurrentAdmissionReport.MaxFrameTimeMs, DeltaSeconds * 1000.0f);
+
+	// The last players were admitted during the frame just sampled, the burst is over
+	if (AdmissionQueue.Num() == 0)
+	{
+		if (CurrentAdmissionReport.NumAdmitted > 0)
+		{
+			CurrentAdmissionReport.AvgQueueWaitMs = TotalQueueWait * 1000.0 / CurrentAdmissionReport.NumAdmitted;
+			LastAdmissionReport = CurrentAdmissionReport;
+
+			UE_LOG(LogCellDemo, Log, TEXT("Admission: %d players | queue wait %.1f ms avg %.1f ms max | admit %.2f ms max per frame | frame %.1f ms max"),
+				LastAdmissionReport.NumAdmitted, LastAdmissionReport.AvgQueueWaitMs, LastAdmissionReport.MaxQueueWaitMs,
+				LastAdmissionReport.MaxAdmitTimeMs, LastAdmissionReport.MaxFrameTimeMs);
+		}
+
+		CurrentAdmissionReport = FCellAdmissionReport();
+		TotalQueueWait = 0.0;
+		bAdmissionBurst = false;
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const double Budget = AdmissionBudgetMs / 1000.0;
+
+	int32 NumProcessed = 0;
+	while (NumProcessed < AdmissionQueue.Num() && (NumProcessed == 0 || FPlatformTime::Seconds() - StartTime < Budget))
+	{
+		const FQueuedPlayer& QueuedPlayer = AdmissionQueue[NumProcessed++];
+
+		// Left while waiting
+		APlayerController* Player = QueuedPlayer.Player.Get();
+		if (Player == nullptr || Player->IsPendingKill())
+		{
+			continue;
+		}
+
+		const double QueueWait = FPlatformTime::Seconds() - QueuedPlayer.QueueTime;
+		TotalQueueWait += QueueWait;
+		CurrentAdmissionReport.MaxQueueWaitMs = FMath::Max(CurrentAdmissionReport.MaxQueueWaitMs, (float)(QueueWait * 1000.0));
+		CurrentAdmissionReport.NumAdmitted++;
+
+		Super::HandleStartingNewPlayer_Implementation(Player);
+	}
+	AdmissionQueue.RemoveAt(0, NumProcessed, false);
+
+	CurrentAdmissionReport.MaxAdmitTimeMs = FMath::Max(CurrentAdmissionReport.MaxAdmitTimeMs, (float)((FPlatformTime::Seconds() - StartTime) * 1000.0));
+}
@@ -6,6 +6,40 @@
 #include "GameFramework/GameModeBase.h"
 #include "CellDemoGameMode.generated.h"
 
+/** Cost of the last burst of player admissions, published when the admission queue empties */
+USTRUCT(BlueprintType)
+struct FCellAdmissionReport
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumAdmitted;
+
+	/** Time the players waited in the queue, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AvgQueueWaitMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	float MaxQueueWaitMs;
+
+	/** Longest time spent admitting players in one frame, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float MaxAdmitTimeMs;
+
+	/** Longest frame while the queue was not empty, what the existing players felt, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float MaxFrameTimeMs;
+
+	FCellAdmissionReport()
+		: NumAdmitted(0)
+		, AvgQueueWaitMs(0.0f)
+		, MaxQueueWaitMs(0.0f)
+		, MaxAdmitTimeMs(0.0f)
+		, MaxFrameTimeMs(0.0f)
+	{
+	}
+};
+
 UCLASS(minimalapi)
 class ACellDemoGameMode : public AGameModeBase
 {
@@ -13,7 +47,53 @@ class ACellDemoGameMode : public AGameModeBase
 
 public:
 	ACellDemoGameMode();
-};
 
+	/** Queue the new players instead of spawning their pawn right away, so a join storm is spread over several frames */
+	UPROPERTY(config)
+	bool bStagedAdmission;
+
+	/** Time spent admitting the queued players per frame, in milliseconds. At least one player is admitted per frame. */
+	UPROPERTY(config)
+	float AdmissionBudgetMs;
 
+	UPROPERTY(BlueprintReadOnly, Category = "Network")
+	FCellAdmissionReport LastAdmissionReport;
 
+	int32 GetNumQueuedPlayers() const { return AdmissionQueue.Num(); }
+
+	/** Spawns the helpers of the level, see SpawnHelpers */
+	virtual void BeginPlay() override;
+
+	/** Joins and leaves go to the input trace */
+	virtual void PostLogin(APlayerController* NewPlayer) override;
+	virtual void Logout(AController* Exiting) override;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	struct FQueuedPlayer
+	{
+		TWeakObjectPtr<APlayerController> Player;
+		double QueueTime;
+	};
+
+	TArray<FQueuedPlayer> AdmissionQueue;
+
+	/** Report of the burst being admitted */
+	FCellAdmissionReport CurrentAdmissionReport;
+	double TotalQueueWait;
+
+	/** Players were queued and the report of their burst is not published yet */
+	bool bAdmissionBurst;
+
+	/**
+	*	Spawns the nav manager, the crowd manager, the tick governor of hosted cells, and the bots requested on the command line with -CellBots=<Count> [-CellBotPattern=<Pattern>] [-CellBotClicks=<PerSecond>].
+	*	Starts the crowd bench requested with -CellCrowdBench=<Name> [-CellCrowdSeconds=<Seconds>].
+	*	Starts the input trace requested with -CellTraceRecord or -CellTraceReplay=<File> [-CellTraceSpeed=<Speed>].
+	*/
+	void SpawnHelpers();
+
+	virtual void HandleStartingNewPlayer_Implementation(APlayerController* NewPlayer) override;
+
+	void AdmitQueuedPlayers(float DeltaSeconds);
+};
@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoGameState.h"
+#include "CellNWGameInstance.h"
+
+void ACellDemoGameState::AddPlayerState(APlayerState* PlayerState)
+{
+	const int32 NumPlayers = PlayerArray.Num();
+	Super::AddPlayerState(PlayerState);
+
+	if (PlayerArray.Num() != NumPlayers)
+	{
+		NotifyPlayersChanged();
+	}
+}
+
+void ACellDemoGameState::RemovePlayerState(APlayerState* PlayerState)
+{
+	const int32 NumPlayers = PlayerArray.Num();
+	Super::RemovePlayerState(PlayerState);
+
+	if (PlayerArray.Num() != NumPlayers)
+	{
+		NotifyPlayersChanged();
+	}
+}
+
+void ACellDemoGameState::NotifyPlayersChanged()
+{
+	if (UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetGameInstance()))
+	{
+		GameInstance->RefreshOnlineStatus();
+	}
+}
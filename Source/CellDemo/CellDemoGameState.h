@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameStateBase.h"
+#include "CellDemoGameState.generated.h"
+
+/**
+*	Game state telling the game instance when players join or leave, on the server and on the clients
+*/
+UCLASS()
+class ACellDemoGameState : public AGameStateBase
+{
+	GENERATED_BODY()
+
+public:
+	// Begin AGameStateBase interface
+	virtual void AddPlayerState(APlayerState* PlayerState) override;
+	virtual void RemovePlayerState(APlayerState* PlayerState) override;
+	// End AGameStateBase interface
+
+protected:
+	void NotifyPlayersChanged();
+};
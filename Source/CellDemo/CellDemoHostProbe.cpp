@@ -0,0 +1,371 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoHostProbe.h"
+#include "CellDemo.h"
+#include "Common/UdpSocketBuilder.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+#include "IPAddress.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+static TAutoConsoleVariable<float> CVarProbeEmulatedLatency(
+	TEXT("CellDemo.Probe.EmulatedLatencyMs"),
+	0.0f,
+	TEXT("Round trip latency added by this host to the RTT probe replies"));
+
+static TAutoConsoleVariable<float> CVarProbeEmulatedLoss(
+	TEXT("CellDemo.Probe.EmulatedLossPercent"),
+	0.0f,
+	TEXT("Percentage of RTT probes this host drops"));
+
+static TAutoConsoleVariable<int32> CVarProbeEnabled(
+	TEXT("CellDemo.Probe.Enabled"),
+	1,
+	TEXT("Probe the candidate hosts before joining, 0 joins the first search result to compare the in-session ping"));
+
+/** Magic, sequence, candidate index */
+static const int32 ProbePacketSize = 3 * sizeof(uint32);
+
+static TSharedRef<FInternetAddr> CopyAddress(const FInternetAddr& Address)
+{
+	TSharedRef<FInternetAddr> Copy = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+	uint32 Ip = 0;
+	Address.GetIp(Ip);
+	Copy->SetIp(Ip);
+	Copy->SetPort(Address.GetPort());
+	return Copy;
+}
+
+float FCellHostProbeResult::GetScore() const
+{
+	// Every lost probe costs as much as 10 ms, a few free slots break the ties
+	const float SlotBonusMs = 2.0f * FMath::Min(OpenSlots, 4);
+
+	if (ProbesReceived == 0)
+	{
+		// Never answered, fall behind every host that did
+		return 10000.0f + SearchPingMs - SlotBonusMs;
+	}
+	return AvgRttMs + GetLossPercent() * 10.0f - SlotBonusMs;
+}
+
+// *******************************
+// Responder
+// *******************************
+
+/** Echo loop of the responder, it only ever touches the socket and its own queue */
+class FCellProbeEchoRunnable : public FRunnable
+{
+public:
+	FCellProbeEchoRunnable(FSocket* InSocket)
+		: Socket(InSocket)
+	{
+	}
+
+	// Begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override { bStopping = true; }
+	// End FRunnable interface
+
+private:
+	struct FPendingReply
+	{
+		double SendTime;
+		TArray<uint8> Data;
+		TSharedPtr<FInternetAddr> Address;
+	};
+
+	FSocket* Socket;
+	FThreadSafeBool bStopping;
+
+	/** Replies held back by the emulated latency */
+	TArray<FPendingReply> PendingReplies;
+
+	void ReceiveProbes();
+	void SendDueReplies();
+};
+
+uint32 FCellProbeEchoRunnable::Run()
+{
+	while (!bStopping)
+	{
+		// Sleep until the next probe, or until the next reply held back is due
+		FTimespan WaitTime = FTimespan::FromMilliseconds(10.0);
+		if (PendingReplies.Num() > 0)
+		{
+			WaitTime = FTimespan::FromSeconds(FMath::Clamp(PendingReplies[0].SendTime - FPlatformTime::Seconds(), 0.0, 0.01));
+		}
+
+		if (Socket->Wait(ESocketWaitConditions::WaitForRead, WaitTime))
+		{
+			ReceiveProbes();
+		}
+		SendDueReplies();
+	}
+	return 0;
+}
+
+void FCellProbeEchoRunnable::ReceiveProbes()
+{
+	const double Now = FPlatformTime::Seconds();
+	const double Latency = CVarProbeEmulatedLatency.GetValueOnAnyThread() / 1000.0;
+	const float LossPercent = CVarProbeEmulatedLoss.GetValueOnAnyThread();
+
+	uint8 Buffer[ProbePacketSize];
+	TSharedRef<FInternetAddr> FromAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+	uint32 PendingSize = 0;
+	while (Socket->HasPendingData(PendingSize))
+	{
+		int32 BytesRead = 0;
+		if (!Socket->RecvFrom(Buffer, sizeof(Buffer), BytesRead, *FromAddress) || BytesRead != ProbePacketSize)
+		{
+			continue;
+		}
+
+		uint32 Magic = 0;
+		FMemory::Memcpy(&Magic, Buffer, sizeof(Magic));
+		if (Magic != FCellDemoHostProber::ProbeMagic || FMath::FRand() * 100.0f < LossPercent)
+		{
+			continue;
+		}
+
+		FPendingReply Reply;
+		Reply.SendTime = Now + Latency;
+		Reply.Data.Append(Buffer, BytesRead);
+		Reply.Address = CopyAddress(*FromAddress);
+		PendingReplies.Add(Reply);
+	}
+}
+
+void FCellProbeEchoRunnable::SendDueReplies()
+{
+	const double Now = FPlatformTime::Seconds();
+
+	// Replies are queued in arrival order so they are also due in that order
+	int32 NumSent = 0;
+	for (; NumSent < PendingReplies.Num() && PendingReplies[NumSent].SendTime <= Now; NumSent++)
+	{
+		int32 BytesSent = 0;
+		Socket->SendTo(PendingReplies[NumSent].Data.GetData(), PendingReplies[NumSent].Data.Num(), BytesSent, *PendingReplies[NumSent].Address);
+	}
+	PendingReplies.RemoveAt(0, NumSent, false);
+}
+
+FCellDemoProbeResponder::FCellDemoProbeResponder()
+	: Socket(nullptr)
+	, Port(0)
+	, Runnable(nullptr)
+	, Thread(nullptr)
+{
+}
+
+FCellDemoProbeResponder::~FCellDemoProbeResponder()
+{
+	Stop();
+}
+
+int32 FCellDemoProbeResponder::Start()
+{
+	Stop();
+
+	for (int32 Try = 0; Try < MaxPortTries && Socket == nullptr; Try++)
+	{
+		Socket = FUdpSocketBuilder(TEXT("CellProbeResponder")).AsNonBlocking().BoundToPort(BasePort + Try).Build();
+		if (Socket != nullptr)
+		{
+			Port = BasePort + Try;
+		}
+	}
+
+	if (Socket == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Probe: could not open the responder socket"));
+		return Port;
+	}
+
+	Runnable = new FCellProbeEchoRunnable(Socket);
+	Thread = FRunnableThread::Create(Runnable, TEXT("CellProbeResponder"), 64 * 1024, TPri_AboveNormal);
+	return Port;
+}
+
+void FCellDemoProbeResponder::Stop()
+{
+	// The thread goes first, it uses the socket
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	delete Runnable;
+	Runnable = nullptr;
+
+	if (Socket != nullptr)
+	{
+		Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+	Port = 0;
+}
+
+// *******************************
+// Prober
+// *******************************
+
+FCellDemoHostProber::FCellDemoHostProber()
+	: ProbesPerHost(5)
+	, ProbeInterval(0.05f)
+	, Deadline(1.0f)
+	, Socket(nullptr)
+	, StartTime(0.0)
+	, LastSendTime(0.0)
+	, NextSequence(0)
+{
+}
+
+FCellDemoHostProber::~FCellDemoHostProber()
+{
+	Cancel();
+}
+
+bool FCellDemoHostProber::IsEnabled()
+{
+	return CVarProbeEnabled.GetValueOnGameThread() != 0;
+}
+
+void FCellDemoHostProber::Start(const TArray<FCellHostProbeResult>& Candidates, const FOnCellHostProbeComplete& OnComplete)
+{
+	Cancel();
+
+	Results = Candidates;
+	CompleteDelegate = OnComplete;
+	SendTimes.Reset();
+	SendTimes.SetNum(Results.Num());
+	NextSequence = 0;
+
+	Socket = FUdpSocketBuilder(TEXT("CellProbeClient")).AsNonBlocking().Build();
+	if (Socket == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Probe: could not open the probe socket"));
+		Complete();
+		return;
+	}
+
+	StartTime = FPlatformTime::Seconds();
+	SendProbes();
+}
+
+void FCellDemoHostProber::Cancel()
+{
+	if (Socket != nullptr)
+	{
+		Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+	CompleteDelegate.Unbind();
+}
+
+bool FCellDemoHostProber::Tick(float DeltaTime)
+{
+	if (Socket == nullptr)
+	{
+		return true;
+	}
+
+	ReceiveReplies();
+
+	const double Now = FPlatformTime::Seconds();
+	if (NextSequence < ProbesPerHost && Now - LastSendTime >= ProbeInterval)
+	{
+		SendProbes();
+	}
+
+	bool bAllReceived = NextSequence >= ProbesPerHost;
+	for (const FCellHostProbeResult& Result : Results)
+	{
+		bAllReceived &= Result.Address.IsValid() ? Result.ProbesReceived == Result.ProbesSent : true;
+	}
+
+	if (bAllReceived || Now - StartTime > Deadline)
+	{
+		Complete();
+	}
+	return true;
+}
+
+void FCellDemoHostProber::SendProbes()
+{
+	LastSendTime = FPlatformTime::Seconds();
+
+	// One probe to every candidate per round, so they are all measured under the same conditions
+	for (int32 Index = 0; Index < Results.Num(); Index++)
+	{
+		if (!Results[Index].Address.IsValid())
+		{
+			continue;
+		}
+
+		const uint32 Payload[3] = { ProbeMagic, (uint32)NextSequence, (uint32)Index };
+		int32 BytesSent = 0;
+		if (Socket->SendTo((const uint8*)Payload, ProbePacketSize, BytesSent, *Results[Index].Address))
+		{
+			SendTimes[Index].SetNumZeroed(NextSequence + 1);
+			SendTimes[Index][NextSequence] = LastSendTime;
+			Results[Index].ProbesSent++;
+		}
+	}
+	NextSequence++;
+}
+
+void FCellDemoHostProber::ReceiveReplies()
+{
+	const double Now = FPlatformTime::Seconds();
+
+	uint32 Payload[3];
+	TSharedRef<FInternetAddr> FromAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+	uint32 PendingSize = 0;
+	while (Socket->HasPendingData(PendingSize))
+	{
+		int32 BytesRead = 0;
+		if (!Socket->RecvFrom((uint8*)Payload, ProbePacketSize, BytesRead, *FromAddress) || BytesRead != ProbePacketSize || Payload[0] != ProbeMagic)
+		{
+			continue;
+		}
+
+		const int32 Sequence = Payload[1];
+		const int32 Index = Payload[2];
+		if (!SendTimes.IsValidIndex(Index) || !SendTimes[Index].IsValidIndex(Sequence) || SendTimes[Index][Sequence] == 0.0)
+		{
+			continue;
+		}
+
+		// Running average, and forget the send time so duplicates don't count twice
+		FCellHostProbeResult& Result = Results[Index];
+		const float RttMs = (Now - SendTimes[Index][Sequence]) * 1000.0f;
+		Result.AvgRttMs = (Result.AvgRttMs * Result.ProbesReceived + RttMs) / (Result.ProbesReceived + 1);
+		Result.ProbesReceived++;
+		SendTimes[Index][Sequence] = 0.0;
+	}
+}
+
+void FCellDemoHostProber::Complete()
+{
+	FOnCellHostProbeComplete Delegate = CompleteDelegate;
+	Cancel();
+
+	Results.Sort([](const FCellHostProbeResult& A, const FCellHostProbeResult& B) { return A.GetScore() < B.GetScore(); });
+
+	for (const FCellHostProbeResult& Result : Results)
+	{
+		UE_LOG(LogCellDemo, Log, TEXT("Probe: result %d rtt %.1f ms loss %.0f%% slots %d score %.1f"),
+			Result.SearchResultIndex, Result.AvgRttMs, Result.GetLossPercent(), Result.OpenSlots, Result.GetScore());
+	}
+
+	Delegate.ExecuteIfBound(Results);
+}
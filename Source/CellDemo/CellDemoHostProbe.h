@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+class FSocket;
+class FInternetAddr;
+
+/** A host to probe, and what we measured */
+struct FCellHostProbeResult
+{
+	/** Index in the session search results */
+	int32 SearchResultIndex;
+
+	/** Probe address of the host, ip:port */
+	TSharedPtr<FInternetAddr> Address;
+
+	/** Ping reported by the online subsystem, used when the host never answers */
+	int32 SearchPingMs;
+
+	int32 OpenSlots;
+
+	int32 ProbesSent;
+	int32 ProbesReceived;
+	float AvgRttMs;
+
+	float GetLossPercent() const { return ProbesSent > 0 ? 100.0f * (ProbesSent - ProbesReceived) / ProbesSent : 100.0f; }
+
+	/** Lower is better */
+	float GetScore() const;
+
+	FCellHostProbeResult()
+		: SearchResultIndex(INDEX_NONE)
+		, SearchPingMs(0)
+		, OpenSlots(0)
+		, ProbesSent(0)
+		, ProbesReceived(0)
+		, AvgRttMs(0.0f)
+	{
+	}
+};
+
+DECLARE_DELEGATE_OneParam(FOnCellHostProbeComplete, const TArray<FCellHostProbeResult>& /*Results sorted best first*/);
+
+/**
+*	Host side of the RTT probe, echoes every probe datagram back to its sender.
+*	The probes are answered from a thread of their own, a host idling at a low frame rate answers as fast as a busy one.
+*	CellDemo.Probe.EmulatedLatencyMs and CellDemo.Probe.EmulatedLossPercent fake a distant host when testing
+*	several hosts on one machine, use Net PktLag on the same host to get the matching in-session ping.
+*/
+class FCellDemoProbeResponder
+{
+public:
+	/** First port tried, the next ones are used when several hosts run on the same machine */
+	static const int32 BasePort = 7787;
+	static const int32 MaxPortTries = 16;
+
+	FCellDemoProbeResponder();
+	~FCellDemoProbeResponder();
+
+	/** Returns the port the responder listens on, 0 on failure */
+	int32 Start();
+	void Stop();
+
+	int32 GetPort() const { return Port; }
+
+private:
+	FSocket* Socket;
+	int32 Port;
+
+	/** Receives and echoes the probes, see CellDemoHostProbe.cpp */
+	class FCellProbeEchoRunnable* Runnable;
+	class FRunnableThread* Thread;
+};
+
+/**
+*	Client side of the RTT probe: sends a few datagrams to every candidate at the same time and
+*	ranks them by round trip time, loss and open slots once they all answered or the deadline passed.
+*/
+class FCellDemoHostProber : public FTickerObjectBase
+{
+public:
+	static const uint32 ProbeMagic = 0x42525043; // 'CPRB'
+
+	FCellDemoHostProber();
+	virtual ~FCellDemoHostProber();
+
+	/** CellDemo.Probe.Enabled, when off the first search result is joined without probing, to compare the in-session ping */
+	static bool IsEnabled();
+
+	/** Starts probing, OnComplete is always called, even if nothing could be sent */
+	void Start(const TArray<FCellHostProbeResult>& Candidates, const FOnCellHostProbeComplete& OnComplete);
+	void Cancel();
+
+	bool IsRunning() const { return Socket != nullptr; }
+
+	int32 ProbesPerHost;
+	float ProbeInterval;
+	float Deadline;
+
+	// Begin FTickerObjectBase interface
+	virtual bool Tick(float DeltaTime) override;
+	// End FTickerObjectBase interface
+
+private:
+	FSocket* Socket;
+	TArray<FCellHostProbeResult> Results;
+	FOnCellHostProbeComplete CompleteDelegate;
+
+	/** Send time of every probe, indexed by candidate then sequence */
+	TArray<TArray<double>> SendTimes;
+
+	double StartTime;
+	double LastSendTime;
+	int32 NextSequence;
+
+	void SendProbes();
+	void ReceiveReplies();
+	void Complete();
+};
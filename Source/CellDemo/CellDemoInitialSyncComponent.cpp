@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoInitialSyncComponent.h"
+#include "CellDemo.h"
+#include "CellNWGameInstance.h"
+#include "CellDemoSessionMigration.h"
+#include "CellDemoBandwidthComponent.h"
+#include "CellDemoPlayerController.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+
+UCellDemoInitialSyncComponent::UCellDemoInitialSyncComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = true;
+	SetIsReplicated(true);
+
+	SyncNetSpeed = 8000;
+	InitialRadius = 1500.0f;
+	RadiusStep = 1500.0f;
+	MaxRadius = 20000.0f;
+	StepInterval = 0.2f;
+	Timeout = 15.0f;
+
+	Progress = 0.0f;
+	JoinToPlayableMs = 0.0f;
+	JoinToCompleteMs = 0.0f;
+	PeakBytesPerSecond = 0;
+
+	Stage = EStage::Waiting;
+	SyncRadius = 0.0f;
+	bPlayable = false;
+	SavedNetSpeed = 0;
+	StartTime = 0.0;
+	LastStepTime = 0.0;
+}
+
+void UCellDemoInitialSyncComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Driven by the server, clients get the updates
+	SetComponentTickEnabled(GetOwnerRole() == ROLE_Authority);
+}
+
+bool UCellDemoInitialSyncComponent::IsRelevantDuringSync(const AActor* Actor, const FVector& ViewLocation) const
+{
+	if (Stage != EStage::Syncing)
+	{
+		return true;
+	}
+
+	// Own pawn first
+	const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	if (Controller != nullptr && Actor == Controller->GetPawn())
+	{
+		return true;
+	}
+
+	return FVector::DistSquared(Actor->GetActorLocation(), ViewLocation) <= FMath::Square(SyncRadius);
+}
+
+void UCellDemoInitialSyncComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// Local players of a listen server and bots have nothing to sync
+	APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	UNetConnection* Connection = GetOwner()->GetNetConnection();
+	if (Controller == nullptr || Connection == nullptr)
+	{
+		if (Controller != nullptr && Controller->IsLocalController())
+		{
+			SetComponentTickEnabled(false);
+		}
+		return;
+	}
+
+	if (Stage == EStage::Waiting)
+	{
+		BeginSync(Connection);
+		return;
+	}
+
+	// The speed may have been changed by the player in the meantime, keep what they asked for
+	if (GetBandwidth() == nullptr && Connection->CurrentNetSpeed != FMath::Min(SavedNetSpeed, SyncNetSpeed))
+	{
+		SavedNetSpeed = Connection->CurrentNetSpeed;
+		Connection->CurrentNetSpeed = FMath::Min(SavedNetSpeed, SyncNetSpeed);
+	}
+	PeakBytesPerSecond = FMath::Max(PeakBytesPerSecond, Connection->OutBytesPerSecond);
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now - StartTime > Timeout)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Sync: timed out at radius %.0f"), SyncRadius);
+		EndSync(Connection);
+		return;
+	}
+
+	// Everything the current radius made relevant has been sent, go one step further
+	if (Now - LastStepTime < StepInterval || !Connection->IsNetReady(false) || Controller->GetPawn() == nullptr)
+	{
+		return;
+	}
+
+	if (!bPlayable)
+	{
+		bPlayable = true;
+		ClientSyncPlayable();
+	}
+
+	if (SyncRadius >= MaxRadius)
+	{
+		EndSync(Connection);
+		return;
+	}
+
+	SyncRadius = FMath::Min(SyncRadius + RadiusStep, MaxRadius);
+	LastStepTime = Now;
+	Progress = SyncRadius / MaxRadius;
+	ClientSyncProgress(FMath::RoundToInt(Progress * 100.0f));
+}
+
+UCellDemoBandwidthComponent* UCellDemoInitialSyncComponent::GetBandwidth() const
+{
+	const ACellDemoPlayerController* Controller = Cast<ACellDemoPlayerController>(GetOwner());
+	return Controller != nullptr ? Controller->Bandwidth : nullptr;
+}
+
+void UCellDemoInitialSyncComponent::BeginSync(UNetConnection* Connection)
+{
+	Stage = EStage::Syncing;
+	SyncRadius = InitialRadius;
+	if (UCellDemoBandwidthComponent* Bandwidth = GetBandwidth())
+	{
+		Bandwidth->SetSyncNetSpeed(SyncNetSpeed);
+	}
+	else
+	{
+		SavedNetSpeed = Connection->CurrentNetSpeed;
+		Connection->CurrentNetSpeed = FMath::Min(SavedNetSpeed, SyncNetSpeed);
+	}
+	StartTime = FPlatformTime::Seconds();
+	LastStepTime = StartTime;
+	PeakBytesPerSecond = 0;
+}
+
+void UCellDemoInitialSyncComponent::EndSync(UNetConnection* Connection)
+{
+	Stage = EStage::Done;
+	if (UCellDemoBandwidthComponent* Bandwidth = GetBandwidth())
+	{
+		Bandwidth->SetSyncNetSpeed(0);
+	}
+	else
+	{
+		Connection->CurrentNetSpeed = SavedNetSpeed;
+	}
+	Progress = 1.0f;
+	SetComponentTickEnabled(false);
+
+	const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	UE_LOG(LogCellDemo, Log, TEXT("Sync: %s synced in %.0f ms, peak %d B/s"),
+		Controller->PlayerState != nullptr ? *Controller->PlayerState->PlayerName : *Controller->GetName(),
+		(FPlatformTime::Seconds() - StartTime) * 1000.0, PeakBytesPerSecond);
+
+	ClientSyncComplete(PeakBytesPerSecond);
+}
+
+float UCellDemoInitialSyncComponent::GetTimeSinceJoinMs() const
+{
+	const UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetWorld()->GetGameInstance());
+	return GameInstance != nullptr && GameInstance->JoinTravelStartTime > 0.0 ? (FPlatformTime::Seconds() - GameInstance->JoinTravelStartTime) * 1000.0 : 0.0f;
+}
+
+void UCellDemoInitialSyncComponent::ClientSyncProgress_Implementation(uint8 Percent)
+{
+	// Unreliable, an older update may come late
+	const float NewProgress = Percent / 100.0f;
+	if (NewProgress > Progress)
+	{
+		Progress = NewProgress;
+		OnSyncProgress.Broadcast(Progress);
+	}
+}
+
+void UCellDemoInitialSyncComponent::ClientSyncPlayable_Implementation()
+{
+	JoinToPlayableMs = GetTimeSinceJoinMs();
+	UE_LOG(LogCellDemo, Log, TEXT("Sync: playable %.0f ms after joining"), JoinToPlayableMs);
+
+	// A migrated cell is back once playable on the new host
+	UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetWorld()->GetGameInstance());
+	if (GameInstance != nullptr && GameInstance->SessionMigration != nullptr)
+	{
+		GameInstance->SessionMigration->NotifyPlayable();
+	}
+
+	OnPlayable.Broadcast();
+}
+
+void UCellDemoInitialSyncComponent::ClientSyncComplete_Implementation(int32 InPeakBytesPerSecond)
+{
+	JoinToCompleteMs = GetTimeSinceJoinMs();
+	PeakBytesPerSecond = InPeakBytesPerSecond;
+	Progress = 1.0f;
+	UE_LOG(LogCellDemo, Log, TEXT("Sync: complete %.0f ms after joining, peak %d B/s"), JoinToCompleteMs, PeakBytesPerSecond);
+
+	if (UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetWorld()->GetGameInstance()))
+	{
+		GameInstance->JoinTravelStartTime = 0.0;
+	}
+
+	OnSyncProgress.Broadcast(Progress);
+	OnSyncComplete.Broadcast();
+}
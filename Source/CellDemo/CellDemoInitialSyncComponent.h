@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CellDemoInitialSyncComponent.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCellSyncProgress, float, Progress);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnCellSyncStage);
+
+/**
+*	Initial state streaming of a player joining a cell in progress.
+*
+*	Instead of getting every character and block at once after the travel, the joining connection is capped to
+*	SyncNetSpeed and the characters are only relevant within a sync radius around the view location. The engine
+*	replicates the own pawn and the closest actors first within the capped rate, and the radius grows by one step every
+*	time the connection has drained what the previous step made relevant. The client is playable after the first step,
+*	the sync is complete when the radius reaches MaxRadius and the connection speed is restored.
+*
+*	Progress, playable and complete are reported to the owning client, which measures the time from its join travel.
+*	When the player controller has a UCellDemoBandwidthComponent, the cap is handed to it instead of set on the connection.
+*/
+UCLASS(ClassGroup = (CellDemo), meta = (BlueprintSpawnableComponent))
+class UCellDemoInitialSyncComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoInitialSyncComponent();
+
+	/** Connection speed while syncing, in bytes per second, the size of the chunks of state streamed every second */
+	UPROPERTY(EditAnywhere, Category = "Sync")
+	int32 SyncNetSpeed;
+
+	/** Radius around the view location synced before the client is playable */
+	UPROPERTY(EditAnywhere, Category = "Sync")
+	float InitialRadius;
+
+	UPROPERTY(EditAnywhere, Category = "Sync")
+	float RadiusStep;
+
+	/** Radius covering the whole cell, the sync is complete when it is reached */
+	UPROPERTY(EditAnywhere, Category = "Sync")
+	float MaxRadius;
+
+	/** Least time between two radius steps, so the replication goes through the actors of the new step first */
+	UPROPERTY(EditAnywhere, Category = "Sync")
+	float StepInterval;
+
+	/** The sync completes after this long whatever the radius, in seconds */
+	UPROPERTY(EditAnywhere, Category = "Sync")
+	float Timeout;
+
+	/** 0 to 1 */
+	UPROPERTY(BlueprintReadOnly, Category = "Sync")
+	float Progress;
+
+	/** Measured on the client from the join travel, in milliseconds */
+	UPROPERTY(BlueprintReadOnly, Category = "Sync")
+	float JoinToPlayableMs;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sync")
+	float JoinToCompleteMs;
+
+	/** Highest outgoing rate of the connection during the sync, measured on the server, in bytes per second */
+	UPROPERTY(BlueprintReadOnly, Category = "Sync")
+	int32 PeakBytesPerSecond;
+
+	UPROPERTY(BlueprintAssignable, Category = "Sync")
+	FOnCellSyncProgress OnSyncProgress;
+
+	UPROPERTY(BlueprintAssignable, Category = "Sync")
+	FOnCellSyncStage OnPlayable;
+
+	UPROPERTY(BlueprintAssignable, Category = "Sync")
+	FOnCellSyncStage OnSyncComplete;
+
+	/** Server side, false for the actors the owning player should not get yet */
+	bool IsRelevantDuringSync(const AActor* Actor, const FVector& ViewLocation) const;
+
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	UFUNCTION(Client, Unreliable)
+	void ClientSyncProgress(uint8 Percent);
+
+	UFUNCTION(Client, Reliable)
+	void ClientSyncPlayable();
+
+	UFUNCTION(Client, Reliable)
+	void ClientSyncComplete(int32 InPeakBytesPerSecond);
+
+	enum class EStage : uint8
+	{
+		Waiting,
+		Syncing,
+		Done
+	};
+
+	EStage Stage;
+	float SyncRadius;
+	bool bPlayable;
+	int32 SavedNetSpeed;
+	double StartTime;
+	double LastStepTime;
+
+	/** Scheduler of the connection speed of the owner, if any */
+	class UCellDemoBandwidthComponent* GetBandwidth() const;
+
+	void BeginSync(class UNetConnection* Connection);
+	void EndSync(class UNetConnection* Connection);
+
+	/** Time since the join travel of the game instance, in milliseconds, 0 if this client didn't join */
+	float GetTimeSinceJoinMs() const;
+};
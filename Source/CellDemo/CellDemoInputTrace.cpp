@@ -0,0 +1,500 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoInputTrace.h"
+#include "CellDemo.h"
+#include "CellDemoBotManager.h"
+#include "CellDemoMessagingComponent.h"
+#include "CellDemoPlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static FString GetTraceDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Profiling/CellTrace");
+}
+
+/** Locations are stored in centimeters, small signed values stay small once packed */
+static void SerializeZigZag(FArchive& Ar, int32& Value)
+{
+	uint32 Packed = (uint32)(Value << 1) ^ (uint32)(Value >> 31);
+	Ar.SerializeIntPacked(Packed);
+	Value = (int32)(Packed >> 1) ^ -(int32)(Packed & 1);
+}
+
+void FCellDemoInputTrace::SerializeRecord(FArchive& Ar, FCellTraceRecord& Record, uint32& PreviousTimeMs)
+{
+	uint32 DeltaMs = Record.TimeMs - PreviousTimeMs;
+	Ar.SerializeIntPacked(DeltaMs);
+	Record.TimeMs = PreviousTimeMs + DeltaMs;
+	PreviousTimeMs = Record.TimeMs;
+
+	uint8 Type = (uint8)Record.Type;
+	Ar << Type;
+	Record.Type = (ECellTraceEvent)Type;
+	Ar.SerializeIntPacked(Record.Player);
+
+	if (Record.Type == ECellTraceEvent::Join || Record.Type == ECellTraceEvent::Move)
+	{
+		int32 X = FMath::RoundToInt(Record.Location.X);
+		int32 Y = FMath::RoundToInt(Record.Location.Y);
+		int32 Z = FMath::RoundToInt(Record.Location.Z);
+		SerializeZigZag(Ar, X);
+		SerializeZigZag(Ar, Y);
+		SerializeZigZag(Ar, Z);
+		Record.Location = FVector(X, Y, Z);
+	}
+	else if (Record.Type == ECellTraceEvent::Message)
+	{
+		Ar << Record.Text;
+	}
+}
+
+// *******************************
+// Recording
+// *******************************
+
+/** State of the recording in progress */
+struct FCellTraceRecorder
+{
+	FArchive* Writer;
+	TWeakObjectPtr<UWorld> World;
+	float StartTime;
+	uint32 LastTimeMs;
+	int32 NumRecords;
+	TMap<TWeakObjectPtr<const AController>, uint32> PlayerIds;
+	FDelegateHandle WorldCleanupHandle;
+
+	FCellTraceRecorder()
+		: Writer(nullptr)
+		, StartTime(0.0f)
+		, LastTimeMs(0)
+		, NumRecords(0)
+	{
+	}
+};
+
+static FCellTraceRecorder GRecorder;
+
+FString FCellDemoInputTrace::StartRecording(UWorld* World)
+{
+	StopRecording();
+
+	if (World == nullptr || World->GetAuthGameMode() == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Trace: input traces are recorded on the server"));
+		return FString();
+	}
+
+	const FString FilePath = GetTraceDir() / FDateTime::Now().ToString() + TEXT(".celltrace");
+	GRecorder.Writer = IFileManager::Get().CreateFileWriter(*FilePath);
+	if (GRecorder.Writer == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Trace: could not create %s"), *FilePath);
+		return FString();
+	}
+
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	FString MapName = World->GetMapName();
+	MapName.RemoveFromStart(World->StreamingLevelsPrefix);
+	*GRecorder.Writer << FileMagic << FileVersion << MapName;
+
+	GRecorder.World = World;
+	GRecorder.StartTime = World->GetTimeSeconds();
+	GRecorder.LastTimeMs = 0;
+	GRecorder.NumRecords = 0;
+	GRecorder.PlayerIds.Reset();
+
+	// The trace only makes sense on its map
+	GRecorder.WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* CleanedWorld, bool bSessionEnded, bool bCleanupResources)
+	{
+		if (CleanedWorld == GRecorder.World.Get())
+		{
+			StopRecording();
+		}
+	});
+
+	// The players already in the session join at the start of the trace
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		RecordJoin(It->Get());
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Trace: recording to %s"), *FilePath);
+	return FilePath;
+}
+
+void FCellDemoInputTrace::StopRecording()
+{
+	if (GRecorder.Writer == nullptr)
+	{
+		return;
+	}
+
+	GRecorder.Writer->Close();
+	delete GRecorder.Writer;
+	GRecorder.Writer = nullptr;
+
+	FWorldDelegates::OnWorldCleanup.Remove(GRecorder.WorldCleanupHandle);
+	GRecorder.WorldCleanupHandle.Reset();
+
+	UE_LOG(LogCellDemo, Log, TEXT("Trace: %d records of %d players over %.1f s"), GRecorder.NumRecords, GRecorder.PlayerIds.Num(), GRecorder.LastTimeMs / 1000.0f);
+}
+
+bool FCellDemoInputTrace::IsRecording()
+{
+	return GRecorder.Writer != nullptr;
+}
+
+/** Fills the time and player of a record, returns false if the controller is not recorded */
+static bool BeginRecord(const AController* Controller, FCellTraceRecord& Record)
+{
+	if (GRecorder.Writer == nullptr || Controller == nullptr || Controller->GetWorld() != GRecorder.World.Get())
+	{
+		return false;
+	}
+
+	// The replay is made of bots, recording them would replay them twice
+	if (Controller->PlayerState != nullptr && Controller->PlayerState->bIsABot)
+	{
+		return false;
+	}
+
+	const uint32* PlayerId = GRecorder.PlayerIds.Find(Controller);
+	Record.Player = PlayerId != nullptr ? *PlayerId : GRecorder.PlayerIds.Add(Controller, GRecorder.PlayerIds.Num());
+	Record.TimeMs = FMath::Max(FMath::RoundToInt((Controller->GetWorld()->GetTimeSeconds() - GRecorder.StartTime) * 1000.0f), 0);
+	return true;
+}
+
+static void WriteRecord(FCellTraceRecord& Record)
+{
+	// Records of the same frame can round to an earlier time than the last one
+	Record.TimeMs = FMath::Max(Record.TimeMs, GRecorder.LastTimeMs);
+	FCellDemoInputTrace::SerializeRecord(*GRecorder.Writer, Record, GRecorder.LastTimeMs);
+	GRecorder.NumRecords++;
+}
+
+void FCellDemoInputTrace::RecordJoin(const AController* Controller)
+{
+	FCellTraceRecord Record;
+	if (BeginRecord(Controller, Record))
+	{
+		Record.Type = ECellTraceEvent::Join;
+		Record.Location = Controller->GetPawn() != nullptr ? Controller->GetPawn()->GetActorLocation() : FVector::ZeroVector;
+		WriteRecord(Record);
+	}
+}
+
+void FCellDemoInputTrace::RecordLeave(const AController* Controller)
+{
+	FCellTraceRecord Record;
+	if (BeginRecord(Controller, Record))
+	{
+		Record.Type = ECellTraceEvent::Leave;
+		WriteRecord(Record);
+	}
+}
+
+void FCellDemoInputTrace::RecordMove(const AController* Controller, const FVector& Location)
+{
+	FCellTraceRecord Record;
+	if (BeginRecord(Controller, Record))
+	{
+		Record.Type = ECellTraceEvent::Move;
+		Record.Location = Location;
+		WriteRecord(Record);
+	}
+}
+
+void FCellDemoInputTrace::RecordMessage(const AController* Controller, const FString& Text)
+{
+	FCellTraceRecord Record;
+	if (BeginRecord(Controller, Record))
+	{
+		Record.Type = ECellTraceEvent::Message;
+		Record.Text = Text;
+		WriteRecord(Record);
+	}
+}
+
+bool FCellDemoInputTrace::Load(const FString& FilePath, FString& OutMapName, TArray<FCellTraceRecord>& OutRecords)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePath));
+	if (!Reader.IsValid())
+	{
+		return false;
+	}
+
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	*Reader << FileMagic << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+	*Reader << OutMapName;
+
+	OutRecords.Reset();
+	uint32 PreviousTimeMs = 0;
+	while (!Reader->AtEnd() && !Reader->IsError())
+	{
+		FCellTraceRecord& Record = OutRecords[OutRecords.AddDefaulted()];
+		SerializeRecord(*Reader, Record, PreviousTimeMs);
+	}
+
+	if (Reader->IsError())
+	{
+		OutRecords.Pop();
+	}
+	return true;
+}
+
+// *******************************
+// Replay
+// *******************************
+
+ACellDemoTraceReplay::ACellDemoTraceReplay()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	FixedFrameRate = 30.0f;
+	TailTime = 5.0f;
+
+	NextRecord = 0;
+	Speed = 1.0f;
+	bExitWhenDone = false;
+	bFixedTimeStep = false;
+	ReplayTime = 0.0;
+	StartWallTime = 0.0;
+}
+
+ACellDemoTraceReplay* ACellDemoTraceReplay::Start(UWorld* World, const FString& FilePath, float Speed, bool bExitWhenDone)
+{
+	if (World == nullptr || ACellDemoBotManager::Get(World) == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Trace: input traces are replayed on the server"));
+		return nullptr;
+	}
+
+	const FString FullPath = FPaths::IsRelative(FilePath) && !FPaths::FileExists(FilePath) ? GetTraceDir() / FilePath : FilePath;
+
+	FString MapName;
+	TArray<FCellTraceRecord> Records;
+	if (!FCellDemoInputTrace::Load(FullPath, MapName, Records))
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Trace: could not load %s"), *FullPath);
+		return nullptr;
+	}
+
+	FString CurrentMapName = World->GetMapName();
+	CurrentMapName.RemoveFromStart(World->StreamingLevelsPrefix);
+	if (MapName != CurrentMapName)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Trace: recorded on %s, replayed on %s"), *MapName, *CurrentMapName);
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	ACellDemoTraceReplay* Replay = World->SpawnActor<ACellDemoTraceReplay>(SpawnParams);
+	Replay->TraceName = FPaths::GetBaseFilename(FullPath);
+	Replay->Records = MoveTemp(Records);
+	Replay->Speed = Speed;
+	Replay->bExitWhenDone = bExitWhenDone;
+
+	// Same random streams on every run
+	FMath::RandInit(0);
+	FMath::SRandInit(0);
+
+	if (Speed <= 0.0f)
+	{
+		Replay->bFixedTimeStep = true;
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(1.0 / Replay->FixedFrameRate);
+	}
+
+	Replay->StartWallTime = FPlatformTime::Seconds();
+	Replay->StartStats = FCellDemoServerStatsSample::Capture();
+
+	UE_LOG(LogCellDemo, Log, TEXT("Trace: replaying %d records of %s at %s"), Replay->Records.Num(), *Replay->TraceName,
+		Speed > 0.0f ? *FString::Printf(TEXT("%.1fx"), Speed) : TEXT("full speed"));
+	return Replay;
+}
+
+void ACellDemoTraceReplay::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bFixedTimeStep)
+	{
+		FApp::SetUseFixedTimeStep(false);
+		bFixedTimeStep = false;
+	}
+
+	if (ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(GetWorld()))
+	{
+		for (const TPair<int32, ACellDemoPlayerController*>& Player : Players)
+		{
+			BotManager->RemoveBot(Player.Value);
+		}
+	}
+	Players.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACellDemoTraceReplay::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// The first frame is the one that spawned the replay
+	if (ReplayTime > 0.0)
+	{
+		GameThreadTimes.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+	}
+
+	ReplayTime += DeltaSeconds * (Speed > 0.0f ? Speed : 1.0f);
+	const uint32 ReplayTimeMs = ReplayTime * 1000.0;
+
+	while (NextRecord < Records.Num() && Records[NextRecord].TimeMs <= ReplayTimeMs)
+	{
+		ReplayRecord(Records[NextRecord++]);
+	}
+
+	for (auto It = PendingLocations.CreateIterator(); It; ++It)
+	{
+		ACellDemoPlayerController* const* Player = Players.Find(It.Key());
+		APawn* Pawn = Player != nullptr && *Player != nullptr ? (*Player)->GetPawn() : nullptr;
+		if (Pawn != nullptr)
+		{
+			Pawn->SetActorLocation(It.Value(), false, nullptr, ETeleportType::TeleportPhysics);
+			It.RemoveCurrent();
+		}
+	}
+
+	const double EndTime = (Records.Num() > 0 ? Records.Last().TimeMs / 1000.0 : 0.0) + TailTime;
+	if (NextRecord >= Records.Num() && ReplayTime >= EndTime)
+	{
+		Finish();
+	}
+}
+
+void ACellDemoTraceReplay::ReplayRecord(const FCellTraceRecord& Record)
+{
+	ACellDemoPlayerController* const* Found = Players.Find(Record.Player);
+	ACellDemoPlayerController* Player = Found != nullptr ? *Found : nullptr;
+
+	switch (Record.Type)
+	{
+	case ECellTraceEvent::Join:
+		if (Player == nullptr)
+		{
+			ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(GetWorld());
+			Player = BotManager != nullptr ? BotManager->SpawnBot(ECellBotPattern::Idle, 0.0f) : nullptr;
+			if (Player != nullptr)
+			{
+				Players.Add(Record.Player, Player);
+				if (!Record.Location.IsZero())
+				{
+					PendingLocations.Add(Record.Player, Record.Location);
+				}
+			}
+		}
+		break;
+
+	case ECellTraceEvent::Leave:
+		if (Player != nullptr)
+		{
+			if (ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(GetWorld()))
+			{
+				BotManager->RemoveBot(Player);
+			}
+			Players.Remove(Record.Player);
+			PendingLocations.Remove(Record.Player);
+		}
+		break;
+
+	case ECellTraceEvent::Move:
+		if (Player != nullptr)
+		{
+			Player->IssueMoveDestination(Record.Location);
+		}
+		break;
+
+	case ECellTraceEvent::Message:
+		if (Player != nullptr && Player->Messaging != nullptr)
+		{
+			Player->Messaging->PostMessage(Record.Text);
+		}
+		break;
+	}
+}
+
+void ACellDemoTraceReplay::Finish()
+{
+	const double WallTime = FPlatformTime::Seconds() - StartWallTime;
+	const FCellDemoServerStatsSample Stats = FCellDemoServerStatsSample::Capture();
+	const int32 NavQueries = Stats.NavQueries - StartStats.NavQueries;
+	const float AvgNavQueryMs = NavQueries > 0 ? (Stats.NavQueryTime - StartStats.NavQueryTime) * 1000.0 / NavQueries : 0.0f;
+
+	float AvgGameThreadMs = 0.0f;
+	for (float GameThreadMs : GameThreadTimes)
+	{
+		AvgGameThreadMs += GameThreadMs;
+	}
+	AvgGameThreadMs = GameThreadTimes.Num() > 0 ? AvgGameThreadMs / GameThreadTimes.Num() : 0.0f;
+
+	GameThreadTimes.Sort();
+	const float P95GameThreadMs = GameThreadTimes.Num() > 0 ? GameThreadTimes[FMath::Min(GameThreadTimes.Num() - 1, FMath::FloorToInt(GameThreadTimes.Num() * 0.95f))] : 0.0f;
+	const float MaxGameThreadMs = GameThreadTimes.Num() > 0 ? GameThreadTimes.Last() : 0.0f;
+
+	UE_LOG(LogCellDemo, Log, TEXT("Trace: replayed %d records of %s | %.1f s of game in %.1f s | %d frames, game thread %.2f ms avg, %.2f ms p95, %.2f ms max | %d nav queries, %.3f ms avg"),
+		Records.Num(), *TraceName, ReplayTime, WallTime, GameThreadTimes.Num(), AvgGameThreadMs, P95GameThreadMs, MaxGameThreadMs, NavQueries, AvgNavQueryMs);
+
+	const FString SummaryPath = GetTraceDir() / TEXT("Replays.csv");
+	FString Summary = FPaths::FileExists(SummaryPath) ? FString() : TEXT("Trace,Speed,Records,GameTime,WallTime,Frames,AvgGameThreadMs,P95GameThreadMs,MaxGameThreadMs,NavQueries,AvgNavQueryMs\n");
+	Summary += FString::Printf(TEXT("%s,%.2f,%d,%.2f,%.2f,%d,%.3f,%.3f,%.3f,%d,%.4f\n"), *TraceName, Speed, Records.Num(), ReplayTime, WallTime,
+		GameThreadTimes.Num(), AvgGameThreadMs, P95GameThreadMs, MaxGameThreadMs, NavQueries, AvgNavQueryMs);
+	FFileHelper::SaveStringToFile(Summary, *SummaryPath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+
+	if (bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+	Destroy();
+}
+
+// *******************************
+// Console
+// *******************************
+
+static void TraceRecordCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (Args.Num() > 0 && Args[0] == TEXT("stop"))
+	{
+		FCellDemoInputTrace::StopRecording();
+		return;
+	}
+	FCellDemoInputTrace::StartRecording(World);
+}
+
+static void TraceReplayCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (Args.Num() == 0)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Usage: CellDemo.Trace.Replay <File> [Speed]"));
+		return;
+	}
+	ACellDemoTraceReplay::Start(World, Args[0], Args.Num() > 1 ? FCString::Atof(*Args[1]) : 1.0f, false);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs TraceRecordCmd(
+	TEXT("CellDemo.Trace.Record"),
+	TEXT("Records the moves, messages, joins and leaves of the players to an input trace. Usage: CellDemo.Trace.Record [stop]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(TraceRecordCommand));
+
+static FAutoConsoleCommandWithWorldAndArgs TraceReplayCmd(
+	TEXT("CellDemo.Trace.Replay"),
+	TEXT("Replays an input trace with bots, 0 as the speed runs it as fast as possible. Usage: CellDemo.Trace.Replay <File> [Speed]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(TraceReplayCommand));
@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CellDemoStats.h"
+#include "CellDemoInputTrace.generated.h"
+
+/** What a player did, as seen by the server */
+enum class ECellTraceEvent : uint8
+{
+	/** Joined the session, Location is where its pawn stands, zero if it has none yet and spawns at a player start */
+	Join,
+	Leave,
+	/** SetNewMoveDestination to Location */
+	Move,
+	/** Phone message with Text */
+	Message
+};
+
+struct FCellTraceRecord
+{
+	/** Since the start of the recording, in milliseconds of game time */
+	uint32 TimeMs;
+	ECellTraceEvent Type;
+	uint32 Player;
+	FVector Location;
+	FString Text;
+
+	FCellTraceRecord()
+		: TimeMs(0)
+		, Type(ECellTraceEvent::Move)
+		, Player(0)
+		, Location(FVector::ZeroVector)
+	{
+	}
+};
+
+/**
+*	Records the input-derived server calls of the human players to a compact binary trace, so the load of a real session
+*	can be replayed by ACellDemoTraceReplay.
+*
+*	File: Saved/Profiling/CellTrace/<Date>.celltrace
+*		uint32 Magic, uint32 Version, FString MapName
+*		then records of packed uint32 DeltaMs since the previous record, uint8 Type, packed uint32 Player,
+*		followed by the location in centimeters as 3 packed zigzag integers (Join, Move) or a FString (Message)
+*
+*	Bots are not recorded, the replay is made of bots.
+*	Console: CellDemo.Trace.Record [stop]
+*/
+class FCellDemoInputTrace
+{
+public:
+	static const uint32 Magic = 0x43525443; // 'CTRC'
+	static const uint32 Version = 1;
+
+	/** Returns the path of the trace file, empty if it could not be created */
+	static FString StartRecording(UWorld* World);
+	static void StopRecording();
+	static bool IsRecording();
+
+	static void RecordJoin(const AController* Controller);
+	static void RecordLeave(const AController* Controller);
+	static void RecordMove(const AController* Controller, const FVector& Location);
+	static void RecordMessage(const AController* Controller, const FString& Text);
+
+	static bool Load(const FString& FilePath, FString& OutMapName, TArray<FCellTraceRecord>& OutRecords);
+
+	/** Reads or writes one record, PreviousTimeMs is the time of the previous record of the file */
+	static void SerializeRecord(FArchive& Ar, FCellTraceRecord& Record, uint32& PreviousTimeMs);
+};
+
+/**
+*	Feeds an input trace back into the server: a bot player controller per recorded player, whose moves and messages go
+*	through the same server calls as the recorded ones.
+*
+*	Speed scales the recorded timing. At 0 the replay runs as fast as possible with a fixed time step of
+*	1 / FixedFrameRate, so the game time, and the frame a record lands on, are the same on every run.
+*	The frames are accounted from the start of the replay to TailTime after the last record, the summary is logged and
+*	appended to Saved/Profiling/CellTrace/Replays.csv for before/after comparisons.
+*
+*	Console: CellDemo.Trace.Replay <File> [Speed]
+*	Command line: -CellTraceReplay=<File> [-CellTraceSpeed=<Speed>], exits once done
+*/
+UCLASS()
+class ACellDemoTraceReplay : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACellDemoTraceReplay();
+
+	/** Starts a replay on the server, a relative path is looked up in Saved/Profiling/CellTrace */
+	static ACellDemoTraceReplay* Start(UWorld* World, const FString& FilePath, float Speed, bool bExitWhenDone);
+
+	UPROPERTY(EditAnywhere, Category = "Replay")
+	float FixedFrameRate;
+
+	/** Time accounted after the last record, for the moves it started to finish */
+	UPROPERTY(EditAnywhere, Category = "Replay")
+	float TailTime;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	FString TraceName;
+	TArray<FCellTraceRecord> Records;
+	int32 NextRecord;
+	float Speed;
+	bool bExitWhenDone;
+	bool bFixedTimeStep;
+
+	/** Bot standing for every recorded player */
+	UPROPERTY(Transient)
+	TMap<int32, class ACellDemoPlayerController*> Players;
+
+	/** Where the pawn of a player joined, applied once the admission spawned it */
+	TMap<int32, FVector> PendingLocations;
+
+	double ReplayTime;
+	double StartWallTime;
+	TArray<float> GameThreadTimes;
+	FCellDemoServerStatsSample StartStats;
+
+	void ReplayRecord(const FCellTraceRecord& Record);
+	void Finish();
+};
@@ -0,0 +1,188 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoLinkQualityComponent.h"
+#include "CellDemo.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+
+UCellDemoLinkQualityComponent::UCellDemoLinkQualityComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = true;
+	SetIsReplicated(true);
+
+	SampleInterval = 0.25f;
+	Smoothing = 0.25f;
+	LevelHoldTime = 1.0f;
+	SendInterval = 2.0f;
+	RttThresholdsMs = { 80.0f, 150.0f, 250.0f, 400.0f };
+	JitterThresholdsMs = { 10.0f, 25.0f, 50.0f, 100.0f };
+	LossThresholdsPercent = { 1.0f, 3.0f, 8.0f, 15.0f };
+	SaturationThresholds = { 0.5f, 0.75f, 0.9f, 1.0f };
+
+	Level = MaxLevel;
+	SampleTime = 0.0f;
+	SendTime = 0.0f;
+	bSampled = false;
+	PendingLevel = MaxLevel;
+	PendingLevelTime = 0.0f;
+	LastRttMs = 0.0f;
+	LastPackets = 0;
+	LastPacketsLost = 0;
+}
+
+void UCellDemoLinkQualityComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Measured on the server only, clients get the updates
+	SetComponentTickEnabled(GetOwnerRole() == ROLE_Authority);
+}
+
+void UCellDemoLinkQualityComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// Local players of a listen server and bots have no connection and keep the best level
+	UNetConnection* Connection = GetOwner()->GetNetConnection();
+	if (Connection == nullptr)
+	{
+		return;
+	}
+
+	SampleTime += DeltaTime;
+	if (SampleTime < SampleInterval)
+	{
+		return;
+	}
+	SampleTime = 0.0f;
+
+	SampleConnection(Connection);
+
+	const int32 NewLevel = ComputeLevel();
+	if (NewLevel == Level)
+	{
+		PendingLevel = Level;
+		PendingLevelTime = 0.0f;
+	}
+	else if (NewLevel != PendingLevel)
+	{
+		PendingLevel = NewLevel;
+		PendingLevelTime = 0.0f;
+	}
+	else
+	{
+		PendingLevelTime += SampleInterval;
+		if (PendingLevelTime >= LevelHoldTime)
+		{
+			SetLevel(NewLevel);
+			SendUpdate();
+		}
+	}
+
+	SendTime += SampleInterval;
+	if (SendTime >= SendInterval)
+	{
+		SendUpdate();
+	}
+}
+
+void UCellDemoLinkQualityComponent::SampleConnection(UNetConnection* Connection)
+{
+	const float RttMs = Connection->AvgLag * 1000.0f;
+
+	// The counters restart from 0 every stat period
+	const int32 Packets = Connection->InPackets + Connection->OutPackets;
+	const int32 PacketsLost = Connection->InPacketsLost + Connection->OutPacketsLost;
+	const int32 NewPackets = Packets >= LastPackets ? Packets - LastPackets : Packets;
+	const int32 NewPacketsLost = PacketsLost >= LastPacketsLost ? PacketsLost - LastPacketsLost : PacketsLost;
+	LastPackets = Packets;
+	LastPacketsLost = PacketsLost;
+	const float LossPercent = NewPackets + NewPacketsLost > 0 ? 100.0f * NewPacketsLost / (NewPackets + NewPacketsLost) : 0.0f;
+
+	float Saturation = Connection->CurrentNetSpeed > 0 ? (float)Connection->OutBytesPerSecond / Connection->CurrentNetSpeed : 0.0f;
+	if (!Connection->IsNetReady(false))
+	{
+		Saturation = FMath::Max(Saturation, 1.0f);
+	}
+
+	if (!bSampled)
+	{
+		Quality.RttMs = RttMs;
+		Quality.JitterMs = 0.0f;
+		Quality.LossPercent = LossPercent;
+		Quality.Saturation = Saturation;
+		LastRttMs = RttMs;
+		bSampled = true;
+		return;
+	}
+
+	Quality.RttMs = FMath::Lerp(Quality.RttMs, RttMs, Smoothing);
+	Quality.JitterMs = FMath::Lerp(Quality.JitterMs, FMath::Abs(RttMs - LastRttMs), Smoothing);
+	Quality.LossPercent = FMath::Lerp(Quality.LossPercent, LossPercent, Smoothing);
+	Quality.Saturation = FMath::Lerp(Quality.Saturation, Saturation, Smoothing);
+	LastRttMs = RttMs;
+}
+
+int32 UCellDemoLinkQualityComponent::CountExceeded(const TArray<float>& Thresholds, float Value)
+{
+	int32 Count = 0;
+	for (float Threshold : Thresholds)
+	{
+		Count += Value > Threshold ? 1 : 0;
+	}
+	return Count;
+}
+
+int32 UCellDemoLinkQualityComponent::ComputeLevel() const
+{
+	// The worst measurement decides, a perfect RTT doesn't make up for a saturated link
+	int32 Penalty = CountExceeded(RttThresholdsMs, Quality.RttMs);
+	Penalty = FMath::Max(Penalty, CountExceeded(JitterThresholdsMs, Quality.JitterMs));
+	Penalty = FMath::Max(Penalty, CountExceeded(LossThresholdsPercent, Quality.LossPercent));
+	Penalty = FMath::Max(Penalty, CountExceeded(SaturationThresholds, Quality.Saturation));
+	return FMath::Max(MaxLevel - Penalty, 0);
+}
+
+void UCellDemoLinkQualityComponent::SendUpdate()
+{
+	SendTime = 0.0f;
+	ClientUpdateLinkQuality(Level,
+		FMath::Clamp(FMath::RoundToInt(Quality.RttMs), 0, 65535),
+		FMath::Clamp(FMath::RoundToInt(Quality.JitterMs), 0, 255),
+		FMath::Clamp(FMath::RoundToInt(Quality.LossPercent), 0, 100),
+		FMath::Clamp(FMath::RoundToInt(Quality.Saturation * 100.0f), 0, 255));
+}
+
+void UCellDemoLinkQualityComponent::ClientUpdateLinkQuality_Implementation(uint8 NewLevel, uint16 RttMs, uint8 JitterMs, uint8 LossPercent, uint8 SaturationPercent)
+{
+	Quality.RttMs = RttMs;
+	Quality.JitterMs = JitterMs;
+	Quality.LossPercent = LossPercent;
+	Quality.Saturation = SaturationPercent / 100.0f;
+	SetLevel(FMath::Min((int32)NewLevel, MaxLevel));
+}
+
+void UCellDemoLinkQualityComponent::SetLevel(int32 NewLevel)
+{
+	if (NewLevel == Level)
+	{
+		return;
+	}
+
+	const int32 OldLevel = Level;
+	Level = NewLevel;
+	PendingLevel = NewLevel;
+	PendingLevelTime = 0.0f;
+
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+		UE_LOG(LogCellDemo, Log, TEXT("Link: %s level %d -> %d (rtt %.0f ms, jitter %.0f ms, loss %.1f%%, saturation %.2f)"),
+			Controller != nullptr && Controller->PlayerState != nullptr ? *Controller->PlayerState->PlayerName : *GetOwner()->GetName(),
+			OldLevel, NewLevel, Quality.RttMs, Quality.JitterMs, Quality.LossPercent, Quality.Saturation);
+	}
+
+	OnLevelChanged.Broadcast(NewLevel, OldLevel);
+}
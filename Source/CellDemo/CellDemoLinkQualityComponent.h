@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CellDemoLinkQualityComponent.generated.h"
+
+/** Smoothed measurements of the link of a player */
+USTRUCT(BlueprintType)
+struct FCellLinkQuality
+{
+	GENERATED_BODY()
+
+	/** Round trip time, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float RttMs;
+
+	/** Variation of the round trip time, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float JitterMs;
+
+	/** Packets lost in both directions, in percent */
+	UPROPERTY(BlueprintReadOnly)
+	float LossPercent;
+
+	/** Outgoing traffic over the connection speed, 1 and above when the connection is saturated */
+	UPROPERTY(BlueprintReadOnly)
+	float Saturation;
+
+	FCellLinkQuality()
+		: RttMs(0.0f)
+		, JitterMs(0.0f)
+		, LossPercent(0.0f)
+		, Saturation(0.0f)
+	{
+	}
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnCellLinkLevelChanged, int32, NewLevel, int32, OldLevel);
+
+/**
+*	Signal level of the connection of a player, what the ConnectionLevel indicator shows.
+*
+*	The server samples the UNetConnection of the owning player controller for RTT, jitter, packet loss and saturation,
+*	smooths them and quantizes them into a level from 0 to MaxLevel. The level and the measurements are sent to the
+*	owning client on an unreliable call when the level changes, and every SendInterval in case it was lost.
+*	OnLevelChanged is raised on both sides only when the level actually changes, so the UI does not need to poll.
+*/
+UCLASS(ClassGroup = (CellDemo), meta = (BlueprintSpawnableComponent))
+class UCellDemoLinkQualityComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoLinkQualityComponent();
+
+	static const int32 MaxLevel = 4;
+
+	/** Time between two samples of the connection, in seconds */
+	UPROPERTY(EditAnywhere, Category = "Link")
+	float SampleInterval;
+
+	/** Weight of a new sample in the smoothed measurements */
+	UPROPERTY(EditAnywhere, Category = "Link", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float Smoothing;
+
+	/** A new level is only applied once it held for this long, so a single spike doesn't flicker the indicator */
+	UPROPERTY(EditAnywhere, Category = "Link")
+	float LevelHoldTime;
+
+	/** Time between two updates sent to the client when the level doesn't change */
+	UPROPERTY(EditAnywhere, Category = "Link")
+	float SendInterval;
+
+	/** Every threshold a measurement is above of costs one level, from the best to the worst */
+	UPROPERTY(EditAnywhere, Category = "Link")
+	TArray<float> RttThresholdsMs;
+
+	UPROPERTY(EditAnywhere, Category = "Link")
+	TArray<float> JitterThresholdsMs;
+
+	UPROPERTY(EditAnywhere, Category = "Link")
+	TArray<float> LossThresholdsPercent;
+
+	UPROPERTY(EditAnywhere, Category = "Link")
+	TArray<float> SaturationThresholds;
+
+	/** Current signal level, MaxLevel is the best */
+	UPROPERTY(BlueprintReadOnly, Category = "Link")
+	int32 Level;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Link")
+	FCellLinkQuality Quality;
+
+	UPROPERTY(BlueprintAssignable, Category = "Link")
+	FOnCellLinkLevelChanged OnLevelChanged;
+
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	/** Quantized to keep the update a few bytes */
+	UFUNCTION(Client, Unreliable)
+	void ClientUpdateLinkQuality(uint8 NewLevel, uint16 RttMs, uint8 JitterMs, uint8 LossPercent, uint8 SaturationPercent);
+
+	float SampleTime;
+	float SendTime;
+	bool bSampled;
+
+	/** Level waiting for LevelHoldTime before being applied */
+	int32 PendingLevel;
+	float PendingLevelTime;
+
+	/** Previous raw values, the packet counters of the connection are reset every stat period */
+	float LastRttMs;
+	int32 LastPackets;
+	int32 LastPacketsLost;
+
+	void SampleConnection(class UNetConnection* Connection);
+	int32 ComputeLevel() const;
+	void SendUpdate();
+	void SetLevel(int32 NewLevel);
+
+	static int32 CountExceeded(const TArray<float>& Thresholds, float Value);
+};
@@ -0,0 +1,582 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoMessagingComponent.h"
+#include "CellDemo.h"
+#include "CellDemoInputTrace.h"
+#include "CellDemoBandwidthComponent.h"
+#include "CellDemoPlayerController.h"
+#include "Containers/Ticker.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+/** String reference codes: 0 is an inline string, then (Id + 1) * 2, +1 when the string follows to be interned */
+static const uint32 InlineStringCode = 0;
+static const int32 MaxInternedStrings = 4096;
+
+/** Interned texts stop here, the rest of the table is for the senders */
+static const int32 MaxInternedTexts = 3072;
+static const int32 MaxSeenTexts = 256;
+
+/** Caps of a batch, the last message may go over the bytes */
+static const int32 MaxBatchMessages = 128;
+static const int32 MaxBatchBytes = 4096;
+
+/** Totals of the server side, for the bench */
+static int32 GNumMessagesSent = 0;
+static int32 GNumBatchesSent = 0;
+static int64 GNumBatchBytesSent = 0;
+
+/** Totals reported by the receiving clients, for the bench */
+static int32 GNumDeliveryReports = 0;
+static int64 GNumMessagesDelivered = 0;
+static double GDeliveryRateSum = 0.0;
+
+UCellDemoMessagingComponent::UCellDemoMessagingComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = true;
+
+	// Flush right before the net driver sends the frame
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+	SetIsReplicated(true);
+
+	NextSlot = 0;
+	NumMessages = 0;
+	MessageSerial = 0;
+	bCountingDelivery = false;
+	DeliveryCount = 0;
+	DeliveryCountStartTime = 0.0;
+}
+
+void UCellDemoMessagingComponent::PostMessage(const FString& Text)
+{
+	ServerPostMessage(Text);
+}
+
+bool UCellDemoMessagingComponent::ServerPostMessage_Validate(const FString& Text)
+{
+	return Text.Len() <= 256;
+}
+
+void UCellDemoMessagingComponent::ServerPostMessage_Implementation(const FString& Text)
+{
+	const APlayerController* Controller = Cast<APlayerController>(GetOwner());
+	FCellDemoInputTrace::RecordMessage(Controller, Text);
+
+	const FString Sender = Controller != nullptr && Controller->PlayerState != nullptr ? Controller->PlayerState->PlayerName : FString();
+	BroadcastMessage(GetWorld(), Sender, Text);
+}
+
+void UCellDemoMessagingComponent::BroadcastMessage(UWorld* World, const FString& Sender, const FString& Text)
+{
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (UCellDemoMessagingComponent* Messaging = It->IsValid() ? (*It)->FindComponentByClass<UCellDemoMessagingComponent>() : nullptr)
+		{
+			Messaging->QueueMessage(Sender, Text);
+		}
+	}
+}
+
+void UCellDemoMessagingComponent::QueueMessage(const FString& Sender, const FString& Text)
+{
+	FQueuedMessage Message;
+	Message.Sender = Sender;
+	Message.Text = Text;
+	Message.Time = GetWorld()->GetTimeSeconds();
+	Queue.Add(Message);
+}
+
+void UCellDemoMessagingComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (Queue.Num() == 0 || GetOwnerRole() != ROLE_Authority)
+	{
+		return;
+	}
+
+	// Paced by the bandwidth scheduler on a weak link, the queue keeps growing meanwhile and drains over several flushes
+	const ACellDemoPlayerController* Controller = Cast<ACellDemoPlayerController>(GetOwner());
+	UCellDemoBandwidthComponent* Bandwidth = Controller != nullptr ? Controller->Bandwidth : nullptr;
+	if (Bandwidth != nullptr && !Bandwidth->CanSendMessages(Queue[0].Time))
+	{
+		return;
+	}
+
+	const int32 BatchBytes = Flush();
+	if (Bandwidth != nullptr)
+	{
+		Bandwidth->ConsumeMessageBytes(BatchBytes);
+	}
+}
+
+int32 UCellDemoMessagingComponent::Flush()
+{
+	float BatchTime = GetWorld()->GetTimeSeconds();
+
+	// The messages first, the count in front of them is only known once the caps are hit
+	TArray<uint8> Messages;
+	FMemoryWriter MessagesWriter(Messages);
+
+	uint32 Count = 0;
+	while ((int32)Count < Queue.Num() && (int32)Count < MaxBatchMessages && Messages.Num() < MaxBatchBytes)
+	{
+		const FQueuedMessage& Message = Queue[Count];
+		WriteString(MessagesWriter, Message.Sender, true);
+		WriteString(MessagesWriter, Message.Text, false);
+
+		// Queued during this frame or the previous ones, a small age is cheaper than a time
+		uint32 AgeMs = FMath::Max(FMath::RoundToInt((BatchTime - Message.Time) * 1000.0f), 0);
+		MessagesWriter.SerializeIntPacked(AgeMs);
+		Count++;
+	}
+
+	TArray<uint8> Batch;
+	FMemoryWriter Writer(Batch);
+	Writer.SerializeIntPacked(Count);
+	Writer << BatchTime;
+	Batch.Append(Messages);
+
+	GNumMessagesSent += Count;
+	GNumBatchesSent++;
+	GNumBatchBytesSent += Batch.Num();
+
+	Queue.RemoveAt(0, Count, false);
+	ClientReceiveMessages(Batch);
+	return Batch.Num();
+}
+
+void UCellDemoMessagingComponent::WriteString(FArchive& Ar, const FString& String, bool bIsSender)
+{
+	if (const uint16* Id = InternedIds.Find(String))
+	{
+		uint32 Code = (*Id + 1) * 2;
+		Ar.SerializeIntPacked(Code);
+		return;
+	}
+
+	// A text is only worth a slot of the table once it repeats
+	bool bIntern = bIsSender;
+	if (!bIsSender && InternedIds.Num() < MaxInternedTexts)
+	{
+		bIntern = SeenTexts.Remove(String) > 0;
+		if (!bIntern)
+		{
+			if (SeenTexts.Num() >= MaxSeenTexts)
+			{
+				SeenTexts.Reset();
+			}
+			SeenTexts.Add(String);
+		}
+	}
+
+	FString Copy = String;
+	if (bIntern && InternedIds.Num() < MaxInternedStrings)
+	{
+		const uint16 Id = InternedIds.Num();
+		InternedIds.Add(String, Id);
+
+		uint32 Code = (Id + 1) * 2 + 1;
+		Ar.SerializeIntPacked(Code);
+		Ar << Copy;
+		return;
+	}
+
+	uint32 Code = InlineStringCode;
+	Ar.SerializeIntPacked(Code);
+	Ar << Copy;
+}
+
+uint16 UCellDemoMessagingComponent::ReadString(FArchive& Ar, FString& OutInline)
+{
+	uint32 Code = 0;
+	Ar.SerializeIntPacked(Code);
+
+	if (Code == InlineStringCode)
+	{
+		Ar << OutInline;
+		return MAX_uint16;
+	}
+
+	const int32 Id = Code / 2 - 1;
+	if (Code & 1)
+	{
+		FString String;
+		Ar << String;
+		if (Id == InternedStrings.Num())
+		{
+			InternedStrings.Add(MoveTemp(String));
+		}
+	}
+
+	OutInline.Reset();
+	return Id;
+}
+
+const FString& UCellDemoMessagingComponent::ResolveString(uint16 Id, const FString& Inline) const
+{
+	return InternedStrings.IsValidIndex(Id) ? InternedStrings[Id] : Inline;
+}
+
+void UCellDemoMessagingComponent::ClientReceiveMessages_Implementation(const TArray<uint8>& Batch)
+{
+	FMemoryReader Reader(Batch);
+
+	uint32 Count = 0;
+	float BatchTime = 0.0f;
+	Reader.SerializeIntPacked(Count);
+	Reader << BatchTime;
+
+	int32 NumReceived = 0;
+	for (uint32 Index = 0; Index < Count && !Reader.IsError(); Index++)
+	{
+		FMessageSlot& Slot = Slots[NextSlot];
+		Slot.SenderId = ReadString(Reader, Slot.InlineSender);
+		Slot.TextId = ReadString(Reader, Slot.InlineText);
+
+		uint32 AgeMs = 0;
+		Reader.SerializeIntPacked(AgeMs);
+		Slot.Time = BatchTime - AgeMs / 1000.0f;
+
+		NextSlot = (NextSlot + 1) % Capacity;
+		NumMessages = FMath::Min(NumMessages + 1, Capacity);
+		NumReceived++;
+	}
+
+	if (Reader.IsError())
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Messaging: malformed batch of %d bytes"), Batch.Num());
+	}
+
+	MessageSerial += NumReceived;
+	if (bCountingDelivery)
+	{
+		DeliveryCount += NumReceived;
+	}
+	OnMessagesReceived.Broadcast(NumReceived);
+}
+
+void UCellDemoMessagingComponent::ClientBeginDeliveryCount_Implementation()
+{
+	bCountingDelivery = true;
+	DeliveryCount = 0;
+	DeliveryCountStartTime = FPlatformTime::Seconds();
+}
+
+void UCellDemoMessagingComponent::ClientEndDeliveryCount_Implementation()
+{
+	if (bCountingDelivery)
+	{
+		bCountingDelivery = false;
+		ServerReportDelivery(DeliveryCount, FPlatformTime::Seconds() - DeliveryCountStartTime);
+	}
+}
+
+bool UCellDemoMessagingComponent::ServerReportDelivery_Validate(int32 NumReceived, float ReceiveTime)
+{
+	return NumReceived >= 0 && ReceiveTime >= 0.0f;
+}
+
+void UCellDemoMessagingComponent::ServerReportDelivery_Implementation(int32 NumReceived, float ReceiveTime)
+{
+	GNumDeliveryReports++;
+	GNumMessagesDelivered += NumReceived;
+	GDeliveryRateSum += ReceiveTime > 0.0f ? NumReceived / ReceiveTime : 0.0f;
+}
+
+void UCellDemoMessagingComponent::GetMessages(int32 MaxCount, TArray<FCellPhoneMessage>& OutMessages) const
+{
+	const int32 Count = FMath::Clamp(MaxCount, 0, NumMessages);
+	OutMessages.Reset(Count);
+
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		const FMessageSlot& Slot = Slots[(NextSlot - Count + Index + Capacity) % Capacity];
+
+		FCellPhoneMessage& Message = OutMessages[OutMessages.AddDefaulted()];
+		Message.Sender = ResolveString(Slot.SenderId, Slot.InlineSender);
+		Message.Text = ResolveString(Slot.TextId, Slot.InlineText);
+		Message.Time = Slot.Time;
+	}
+}
+
+// *******************************
+// Bench
+// *******************************
+
+/** Calls Function on the messaging component of every remote player, the ones that can report what they received */
+static void ForEachRemoteMessaging(UWorld* World, TFunctionRef<void(UCellDemoMessagingComponent*)> Function)
+{
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* Controller = It->Get();
+		if (Controller == nullptr || Controller->IsLocalController() || Controller->GetNetConnection() == nullptr
+			|| (Controller->PlayerState != nullptr && Controller->PlayerState->bIsABot))
+		{
+			continue;
+		}
+
+		if (UCellDemoMessagingComponent* Messaging = Controller->FindComponentByClass<UCellDemoMessagingComponent>())
+		{
+			Function(Messaging);
+		}
+	}
+}
+
+/** Longest wait of the bench for the queues to flush after the posting, then for the players to report, in seconds */
+static const float MessagingBenchDrainTimeout = 2.0f;
+static const float MessagingBenchReportTimeout = 5.0f;
+
+/**
+*	Broadcasts generated messages at a fixed rate, then reports the throughput measured by the receiving clients
+*	and the packed size of a message measured by the server. Only the remote players count, not the bots or the host.
+*/
+class FCellDemoMessagingBench : public FTickerObjectBase
+{
+public:
+	FCellDemoMessagingBench(UWorld* InWorld, float InMessagesPerSecond, float InDuration, int32 InDistinctTexts)
+		: World(InWorld)
+		, MessagesPerSecond(InMessagesPerSecond)
+		, Duration(InDuration)
+		, DistinctTexts(FMath::Max(InDistinctTexts, 1))
+		, Phase(EPhase::Posting)
+		, StartTime(FPlatformTime::Seconds())
+		, PhaseStartTime(StartTime)
+		, Accumulator(0.0f)
+		, NumPosted(0)
+		, NumClients(0)
+		, StartMessages(GNumMessagesSent)
+		, StartBatches(GNumBatchesSent)
+		, StartBytes(GNumBatchBytesSent)
+		, NetOutBytes(0.0)
+	{
+		GNumDeliveryReports = 0;
+		GNumMessagesDelivered = 0;
+		GDeliveryRateSum = 0.0;
+		ForEachRemoteMessaging(InWorld, [](UCellDemoMessagingComponent* Messaging) { Messaging->ClientBeginDeliveryCount(); });
+	}
+
+	bool IsDone() const { return !World.IsValid() || Phase == EPhase::Done; }
+
+	virtual bool Tick(float DeltaTime) override
+	{
+		if (IsDone())
+		{
+			return true;
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		switch (Phase)
+		{
+		case EPhase::Posting:
+			if (Now - StartTime > Duration)
+			{
+				SetPhase(EPhase::Draining);
+				break;
+			}
+
+			Accumulator += DeltaTime * MessagesPerSecond;
+			while (Accumulator >= 1.0f)
+			{
+				Accumulator -= 1.0f;
+				UCellDemoMessagingComponent::BroadcastMessage(World.Get(), TEXT("Bench"), FString::Printf(TEXT("Bench message %d"), NumPosted % DistinctTexts));
+				NumPosted++;
+			}
+			break;
+
+		case EPhase::Draining:
+		{
+			// The end marker goes after the last batch, a paced queue may take a few more frames to flush
+			int32 NumQueued = 0;
+			ForEachRemoteMessaging(World.Get(), [&NumQueued](UCellDemoMessagingComponent* Messaging) { NumQueued += Messaging->GetNumQueued(); });
+			if (NumQueued == 0 || Now - PhaseStartTime > MessagingBenchDrainTimeout)
+			{
+				ForEachRemoteMessaging(World.Get(), [this](UCellDemoMessagingComponent* Messaging)
+				{
+					Messaging->ClientEndDeliveryCount();
+					NumClients++;
+				});
+				SetPhase(EPhase::Reporting);
+			}
+			break;
+		}
+
+		case EPhase::Reporting:
+			if (GNumDeliveryReports >= NumClients || Now - PhaseStartTime > MessagingBenchReportTimeout)
+			{
+				SetPhase(EPhase::Done);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (UNetDriver* NetDriver = World->GetNetDriver())
+		{
+			NetOutBytes += NetDriver->OutBytesPerSecond * DeltaTime;
+		}
+		return true;
+	}
+
+	void Report() const
+	{
+		const double Time = FPlatformTime::Seconds() - StartTime;
+		const int32 NumMessages = GNumMessagesSent - StartMessages;
+		const int32 NumBatches = GNumBatchesSent - StartBatches;
+		const int64 NumBytes = GNumBatchBytesSent - StartBytes;
+
+		UE_LOG(LogCellDemo, Log, TEXT("Messaging bench: %d posted for %d players in %.1f s | received: %d of %d players reported, %lld of %lld messages, %.0f msg/s per player | sent: %d batches, %.1f msg/batch, %.2f payload bytes/msg, %.0f net bytes/s out"),
+			NumPosted, NumClients, Time, GNumDeliveryReports, NumClients, GNumMessagesDelivered, (int64)NumPosted * NumClients,
+			GNumDeliveryReports > 0 ? GDeliveryRateSum / GNumDeliveryReports : 0.0, NumBatches, NumBatches > 0 ? (float)NumMessages / NumBatches : 0.0f,
+			NumMessages > 0 ? (double)NumBytes / NumMessages : 0.0, NetOutBytes / Time);
+	}
+
+private:
+	enum class EPhase : uint8
+	{
+		Posting,
+		Draining,
+		Reporting,
+		Done
+	};
+
+	TWeakObjectPtr<UWorld> World;
+	float MessagesPerSecond;
+	float Duration;
+	int32 DistinctTexts;
+	EPhase Phase;
+	double StartTime;
+	double PhaseStartTime;
+	float Accumulator;
+	int32 NumPosted;
+	int32 NumClients;
+	int32 StartMessages;
+	int32 StartBatches;
+	int64 StartBytes;
+	double NetOutBytes;
+
+	void SetPhase(EPhase NewPhase)
+	{
+		Phase = NewPhase;
+		PhaseStartTime = FPlatformTime::Seconds();
+	}
+};
+
+static TUniquePtr<FCellDemoMessagingBench> GMessagingBench;
+
+/** Reports and deletes the bench once done, from the core ticker so it doesn't delete itself */
+static FDelegateHandle GMessagingBenchReportHandle;
+
+static void MessagingBenchCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr || World->GetAuthGameMode() == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("The messaging bench runs on the server"));
+		return;
+	}
+
+	const float MessagesPerSecond = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 100.0f;
+	const float Duration = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+	const int32 DistinctTexts = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 16;
+
+	FTicker::GetCoreTicker().RemoveTicker(GMessagingBenchReportHandle);
+	GMessagingBench = MakeUnique<FCellDemoMessagingBench>(World, MessagesPerSecond, Duration, DistinctTexts);
+	GMessagingBenchReportHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([](float DeltaTime)
+	{
+		if (GMessagingBench.IsValid() && GMessagingBench->IsDone())
+		{
+			GMessagingBench->Report();
+			GMessagingBench.Reset();
+			return false;
+		}
+		return GMessagingBench.IsValid();
+	}));
+
+	UE_LOG(LogCellDemo, Log, TEXT("Messaging bench: %.0f msg/s for %.0f s, %d distinct texts"), MessagesPerSecond, Duration, DistinctTexts);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs MessagingBenchCmd(
+	TEXT("CellDemo.Messages.Bench"),
+	TEXT("Broadcasts generated phone messages and reports the throughput received by the players. Usage: CellDemo.Messages.Bench <MessagesPerSecond> [Seconds] [DistinctTexts]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(MessagingBenchCommand));
+
+// *******************************
+// Automation
+// *******************************
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** Writes strings with the server side of the codec and reads them back with the client side of another component */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCellMessagingInternCodecTest, "CellDemo.Messaging.InternCodec", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCellMessagingInternCodecTest::RunTest(const FString& Parameters)
+{
+	UCellDemoMessagingComponent* Server = NewObject<UCellDemoMessagingComponent>();
+	UCellDemoMessagingComponent* Client = NewObject<UCellDemoMessagingComponent>();
+
+	// Round trips one string, returns its size on the wire
+	auto RoundTrip = [this, Server, Client](const FString& String, bool bIsSender) -> int32
+	{
+		TArray<uint8> Bytes;
+		FMemoryWriter Writer(Bytes);
+		Server->WriteString(Writer, String, bIsSender);
+
+		FMemoryReader Reader(Bytes);
+		FString Inline;
+		const uint16 Id = Client->ReadString(Reader, Inline);
+		TestFalse(TEXT("Read error"), Reader.IsError());
+		TestEqual(TEXT("Bytes read"), (int32)Reader.Tell(), Bytes.Num());
+		TestEqual(TEXT("Resolved string"), Client->ResolveString(Id, Inline), String);
+		return Bytes.Num();
+	};
+
+	// A sender is interned right away, then only its id goes
+	const int32 FirstSenderBytes = RoundTrip(TEXT("Alice"), true);
+	TestTrue(TEXT("Interned sender sent as an id"), RoundTrip(TEXT("Alice"), true) < FirstSenderBytes);
+
+	// A text is inline the first time, interned the second, then only its id goes
+	const FString Text = TEXT("See you at the fountain");
+	const int32 InlineBytes = RoundTrip(Text, false);
+	TestEqual(TEXT("Text inline the first time"), Client->InternedStrings.Num(), 1);
+	RoundTrip(Text, false);
+	TestEqual(TEXT("Repeated text interned on its second time"), Client->InternedStrings.Num(), 2);
+	TestTrue(TEXT("Interned text sent as an id"), RoundTrip(Text, false) < InlineBytes);
+
+	// One-off texts never take a slot, even past the seen texts limit
+	for (int32 Index = 0; Index < MaxSeenTexts * 2; Index++)
+	{
+		RoundTrip(FString::Printf(TEXT("One-off %d"), Index), false);
+	}
+	TestEqual(TEXT("One-off texts not interned"), Client->InternedStrings.Num(), 2);
+
+	// Repeated texts stop at MaxInternedTexts, the senders still get the rest of the table
+	for (int32 Index = 0; Index < MaxInternedTexts; Index++)
+	{
+		const FString Repeated = FString::Printf(TEXT("Repeated %d"), Index);
+		RoundTrip(Repeated, false);
+		RoundTrip(Repeated, false);
+	}
+	TestEqual(TEXT("Texts interned up to their share"), Client->InternedStrings.Num(), MaxInternedTexts);
+	RoundTrip(TEXT("Bob"), true);
+	TestEqual(TEXT("Sender interned past the texts share"), Client->InternedStrings.Num(), MaxInternedTexts + 1);
+
+	// Once the table is full everything goes inline
+	for (int32 Index = Client->InternedStrings.Num(); Index < MaxInternedStrings; Index++)
+	{
+		RoundTrip(FString::Printf(TEXT("Sender %d"), Index), true);
+	}
+	TestEqual(TEXT("Table full"), Client->InternedStrings.Num(), MaxInternedStrings);
+	RoundTrip(TEXT("Carol"), true);
+	TestEqual(TEXT("Sender inline once the table is full"), Client->InternedStrings.Num(), MaxInternedStrings);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CellDemoMessagingComponent.generated.h"
+
+/** A phone message, as read by the UI */
+USTRUCT(BlueprintType)
+struct FCellPhoneMessage
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FString Sender;
+
+	UPROPERTY(BlueprintReadOnly)
+	FString Text;
+
+	/** Server time the message was posted at */
+	UPROPERTY(BlueprintReadOnly)
+	float Time;
+
+	FCellPhoneMessage()
+		: Time(0.0f)
+	{
+	}
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCellMessagesReceived, int32, NumNewMessages);
+
+/**
+*	In-session phone messaging of a player.
+*
+*	Server side, the messages for the owning player are queued and sent once per net tick in a single packed call.
+*	Strings are interned per connection, sent once with their id and then only the id: the senders right away, the texts
+*	only once they come a second time, so one-off texts don't fill the table. Part of the table is kept for the senders.
+*	Client side, the messages land in a fixed capacity ring buffer holding the ids, the UI reads it when it needs to
+*	(GetMessageSerial tells whether anything arrived) and the strings are only built then.
+*	On a weak link the flushes are paced by the UCellDemoBandwidthComponent of the player controller. A batch is capped
+*	in messages and bytes so a queue grown while paced doesn't go out as one oversized reliable call, the rest waits
+*	for the next flushes.
+*
+*	Console: CellDemo.Messages.Bench <MessagesPerSecond> [Seconds] [DistinctTexts]
+*/
+UCLASS(ClassGroup = (CellDemo), meta = (BlueprintSpawnableComponent))
+class UCellDemoMessagingComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoMessagingComponent();
+
+	/** Messages kept on the client, the oldest are overwritten */
+	static const int32 Capacity = 64;
+
+	/** Sends a message from the owning player to everybody in the session */
+	UFUNCTION(BlueprintCallable, Category = "Messaging")
+	void PostMessage(const FString& Text);
+
+	/** Server, queues a message for the owning player */
+	void QueueMessage(const FString& Sender, const FString& Text);
+
+	/** Server, queues a message for every player of the world */
+	static void BroadcastMessage(UWorld* World, const FString& Sender, const FString& Text);
+
+	/** Incremented for every message received, the UI only needs to read the messages when it changed */
+	UFUNCTION(BlueprintPure, Category = "Messaging")
+	int32 GetMessageSerial() const { return MessageSerial; }
+
+	UFUNCTION(BlueprintPure, Category = "Messaging")
+	int32 GetNumMessages() const { return NumMessages; }
+
+	/** Copies the newest MaxCount messages, oldest first */
+	UFUNCTION(BlueprintCallable, Category = "Messaging")
+	void GetMessages(int32 MaxCount, TArray<FCellPhoneMessage>& OutMessages) const;
+
+	/** Raised once per received batch */
+	UPROPERTY(BlueprintAssignable, Category = "Messaging")
+	FOnCellMessagesReceived OnMessagesReceived;
+
+	/** Server, messages waiting for the next flush */
+	int32 GetNumQueued() const { return Queue.Num(); }
+
+	/**
+	*	Bench: the client counts the messages it receives between the two calls, which are ordered with the batches,
+	*	and reports them back with ServerReportDelivery.
+	*/
+	UFUNCTION(Client, Reliable)
+	void ClientBeginDeliveryCount();
+
+	UFUNCTION(Client, Reliable)
+	void ClientEndDeliveryCount();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerPostMessage(const FString& Text);
+
+	UFUNCTION(Client, Reliable)
+	void ClientReceiveMessages(const TArray<uint8>& Batch);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerReportDelivery(int32 NumReceived, float ReceiveTime);
+
+	/** Server: messages waiting for the next flush */
+	struct FQueuedMessage
+	{
+		FString Sender;
+		FString Text;
+		float Time;
+	};
+	TArray<FQueuedMessage> Queue;
+
+	/** Server: ids of the strings the owning client already knows */
+	TMap<FString, uint16> InternedIds;
+
+	/** Server: texts sent inline once, interned if they come again. Forgotten when full. */
+	TSet<FString> SeenTexts;
+
+	/** Client: strings by id */
+	TArray<FString> InternedStrings;
+
+	/** Client: ring buffer, a slot holds the interned ids, or the text itself when the table is full */
+	struct FMessageSlot
+	{
+		uint16 SenderId;
+		uint16 TextId;
+		FString InlineSender;
+		FString InlineText;
+		float Time;
+	};
+	FMessageSlot Slots[Capacity];
+	int32 NextSlot;
+	int32 NumMessages;
+	int32 MessageSerial;
+
+	/** Client: bench delivery count, see ClientBeginDeliveryCount */
+	bool bCountingDelivery;
+	int32 DeliveryCount;
+	double DeliveryCountStartTime;
+
+	/** Sends the oldest queued messages, up to the batch caps. Returns the size of the batch sent, in bytes */
+	int32 Flush();
+	void WriteString(FArchive& Ar, const FString& String, bool bIsSender);
+	uint16 ReadString(FArchive& Ar, FString& OutInline);
+	const FString& ResolveString(uint16 Id, const FString& Inline) const;
+
+	friend class FCellMessagingInternCodecTest;
+};
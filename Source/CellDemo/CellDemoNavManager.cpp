@@ -0,0 +1,230 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoNavManager.h"
+#include "CellDemo.h"
+#include "CellDemoBlockNavComponent.h"
+#include "AI/Navigation/NavigationSystem.h"
+#include "AI/Navigation/RecastNavMesh.h"
+#include "EngineUtils.h"
+
+/** Obstacles register often during churn, don't look for the manager in the actor list every time */
+static TWeakObjectPtr<ACellDemoNavManager> GNavManager;
+
+ACellDemoNavManager::ACellDemoNavManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	UpdateBudgetMs = 1.0f;
+	RebuildBudgetMs = 50.0f;
+	MaxTilesPerRebuild = 16;
+	MaxCoalesceDelay = 0.5f;
+	PathCacheCellSize = 100.0f;
+	PathCacheMaxEntries = 1024;
+
+	OldestPendingTime = 0.0;
+	RebuildStartTime = 0.0;
+	DirtyTilesTime = 0.0;
+	RebuildNumTiles = 0;
+	TileRebuildMs = 0.0f;
+	WindowTime = 0.0f;
+	WindowRebuilds = 0;
+	WindowRebuildTimeMs = 0.0f;
+	WindowMaxRebuildTimeMs = 0.0f;
+}
+
+ACellDemoNavManager* ACellDemoNavManager::Get(UWorld* World)
+{
+	ACellDemoNavManager* NavManager = GNavManager.Get();
+	return NavManager != nullptr && World != nullptr && NavManager->GetWorld() == World && !NavManager->IsPendingKill() ? NavManager : nullptr;
+}
+
+void ACellDemoNavManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	GNavManager = this;
+	PathCache.CellSize = PathCacheCellSize;
+	PathCache.MaxEntries = PathCacheMaxEntries;
+	WindowStartStats = FCellDemoServerStatsSample::Capture();
+
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ACellDemoNavManager::OnActorSpawned));
+
+	// Blocks placed in the level
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		OnActorSpawned(*It);
+	}
+}
+
+void ACellDemoNavManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	if (GNavManager.Get() == this)
+	{
+		GNavManager.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACellDemoNavManager::OnActorSpawned(AActor* Actor)
+{
+	if (Actor != nullptr && ObstacleClassNames.Contains(Actor->GetClass()->GetName()) && Actor->FindComponentByClass<UCellDemoBlockNavComponent>() == nullptr)
+	{
+		AddObstacle(Actor);
+	}
+}
+
+void ACellDemoNavManager::AddObstacle(AActor* Actor)
+{
+	UCellDemoBlockNavComponent* Obstacle = NewObject<UCellDemoBlockNavComponent>(Actor);
+	Obstacle->RegisterComponent();
+}
+
+void ACellDemoNavManager::QueueObstacle(UCellDemoBlockNavComponent* Obstacle)
+{
+	if (PendingObstacles.Num() == 0)
+	{
+		OldestPendingTime = FPlatformTime::Seconds();
+	}
+	PendingObstacles.Add(Obstacle);
+}
+
+void ACellDemoNavManager::OnObstacleChanged(const FBox& Bounds)
+{
+	// Paths found until the rebuild is done still go through the old tiles, they are dropped again at the end of the rebuild
+	PathCache.Invalidate(Bounds);
+	DirtyBounds.Add(Bounds);
+	AddDirtyTiles(Bounds);
+}
+
+void ACellDemoNavManager::AddDirtyTiles(const FBox& Bounds)
+{
+	UNavigationSystem* NavSys = GetWorld()->GetNavigationSystem();
+	const ARecastNavMesh* NavMesh = NavSys != nullptr ? Cast<ARecastNavMesh>(NavSys->GetMainNavData(FNavigationSystem::DontCreate)) : nullptr;
+	const float TileSize = NavMesh != nullptr ? NavMesh->TileSizeUU : 1000.0f;
+
+	if (DirtyTiles.Num() == 0)
+	{
+		DirtyTilesTime = FPlatformTime::Seconds();
+	}
+
+	const int32 MinX = FMath::FloorToInt(Bounds.Min.X / TileSize);
+	const int32 MaxX = FMath::FloorToInt(Bounds.Max.X / TileSize);
+	const int32 MinY = FMath::FloorToInt(Bounds.Min.Y / TileSize);
+	const int32 MaxY = FMath::FloorToInt(Bounds.Max.Y / TileSize);
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		for (int32 X = MinX; X <= MaxX; X++)
+		{
+			DirtyTiles.Add(FIntPoint(X, Y));
+		}
+	}
+}
+
+int32 ACellDemoNavManager::GetTileBudget() const
+{
+	if (TileRebuildMs <= 0.0f)
+	{
+		return MaxTilesPerRebuild;
+	}
+	return FMath::Clamp(FMath::FloorToInt(RebuildBudgetMs / TileRebuildMs), 1, MaxTilesPerRebuild);
+}
+
+void ACellDemoNavManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const double Now = FPlatformTime::Seconds();
+	UNavigationSystem* NavSys = GetWorld()->GetNavigationSystem();
+	const bool bRebuilding = NavSys != nullptr && NavSys->IsNavigationBuildInProgress();
+
+	if (bRebuilding && RebuildStartTime == 0.0)
+	{
+		RebuildStartTime = Now;
+		RebuildDirtyBounds = MoveTemp(DirtyBounds);
+		DirtyBounds.Reset();
+		RebuildNumTiles = DirtyTiles.Num();
+		DirtyTiles.Reset();
+	}
+	else if (!bRebuilding && RebuildStartTime != 0.0)
+	{
+		const float RebuildTimeMs = (Now - RebuildStartTime) * 1000.0;
+		WindowRebuilds++;
+		WindowRebuildTimeMs += RebuildTimeMs;
+		WindowMaxRebuildTimeMs = FMath::Max(WindowMaxRebuildTimeMs, RebuildTimeMs);
+		RebuildStartTime = 0.0;
+
+		if (RebuildNumTiles > 0)
+		{
+			const float SampleMs = RebuildTimeMs / RebuildNumTiles;
+			TileRebuildMs = TileRebuildMs > 0.0f ? FMath::Lerp(TileRebuildMs, SampleMs, 0.25f) : SampleMs;
+		}
+
+		for (const FBox& Bounds : RebuildDirtyBounds)
+		{
+			PathCache.Invalidate(Bounds);
+		}
+		RebuildDirtyBounds.Reset();
+	}
+
+	// A rebuild short enough to start and finish between two frames is never seen, don't wait for it forever
+	if (!bRebuilding && DirtyTiles.Num() > 0 && Now - DirtyTilesTime > MaxCoalesceDelay)
+	{
+		DirtyTiles.Reset();
+	}
+
+	// Let the changes pile up while tiles are being rebuilt, they will all go in the next rebuild
+	if (PendingObstacles.Num() > 0 && (!bRebuilding || Now - OldestPendingTime > MaxCoalesceDelay))
+	{
+		UpdatePendingObstacles();
+	}
+
+	WindowTime += DeltaSeconds;
+	if (WindowTime >= 1.0f)
+	{
+		PublishReport();
+	}
+}
+
+void ACellDemoNavManager::UpdatePendingObstacles()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const double Budget = UpdateBudgetMs / 1000.0;
+	const int32 TileBudget = GetTileBudget();
+
+	// The tiles already dirty are rebuilt anyway, an obstacle only counts for the tiles it adds. The last one may go over the budget.
+	int32 NumEnabled = 0;
+	while (NumEnabled < PendingObstacles.Num() && DirtyTiles.Num() < TileBudget && FPlatformTime::Seconds() - StartTime < Budget)
+	{
+		if (UCellDemoBlockNavComponent* Obstacle = PendingObstacles[NumEnabled].Get())
+		{
+			Obstacle->EnableObstacle();
+		}
+		NumEnabled++;
+	}
+
+	PendingObstacles.RemoveAt(0, NumEnabled, false);
+	OldestPendingTime = FPlatformTime::Seconds();
+}
+
+void ACellDemoNavManager::PublishReport()
+{
+	const FCellDemoServerStatsSample Stats = FCellDemoServerStatsSample::Capture();
+	const int32 ObstacleChanges = Stats.NavObstacleChanges - WindowStartStats.NavObstacleChanges;
+
+	// Quiet when there is no block churn
+	if (ObstacleChanges > 0 || WindowRebuilds > 0 || PendingObstacles.Num() > 0)
+	{
+		UE_LOG(LogCellDemo, Log, TEXT("Nav: %d obstacle changes, %d pending | %d rebuilds %.1f ms avg %.1f ms max, %.1f ms per tile, %d tiles per rebuild | %d path queries, %d stalls"),
+			ObstacleChanges, PendingObstacles.Num(), WindowRebuilds, WindowRebuilds > 0 ? WindowRebuildTimeMs / WindowRebuilds : 0.0f, WindowMaxRebuildTimeMs,
+			TileRebuildMs, GetTileBudget(), Stats.NavQueries - WindowStartStats.NavQueries, Stats.NavQueryStalls - WindowStartStats.NavQueryStalls);
+	}
+
+	WindowStartStats = Stats;
+	WindowTime = 0.0f;
+	WindowRebuilds = 0;
+	WindowRebuildTimeMs = 0.0f;
+	WindowMaxRebuildTimeMs = 0.0f;
+}
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CellDemoStats.h"
+#include "CellDemoPathCache.h"
+#include "CellDemoNavManager.generated.h"
+
+/**
+*	Server side navigation update scheduler for the cell levels.
+*
+*	Blocks are turned into nav modifier obstacles (UCellDemoBlockNavComponent) when they spawn, their collision stops
+*	affecting the navigation so the tiles only change when the nav manager enables or removes a modifier. New obstacles are held back while a tile
+*	rebuild is running so the changes of a burst of block churn coalesce into the next rebuild. They are then enabled
+*	until the tiles they dirty would take longer than RebuildBudgetMs to rebuild, from the measured time per tile, the
+*	others wait for the next rebuild. The rebuild times and the path query stalls are logged every second of churn.
+*	It also owns the path cache of the move requests and invalidates it where the obstacles change.
+*
+*	The navmesh stays fully dynamic (RuntimeGeneration=Dynamic): a rebuilt tile gathers the level geometry again,
+*	so a block placed in the level going away leaves no hole behind once its tiles are rebuilt.
+*/
+UCLASS(config = Game)
+class ACellDemoNavManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACellDemoNavManager();
+
+	/** Returns the nav manager of the world if there is one, they only exist on the server */
+	static ACellDemoNavManager* Get(UWorld* World);
+
+	/** Classes of the actors made into obstacles, by name */
+	UPROPERTY(config)
+	TArray<FString> ObstacleClassNames;
+
+	/** Game thread time spent enabling obstacles per frame, in milliseconds, the rebuilds are bounded by RebuildBudgetMs */
+	UPROPERTY(config)
+	float UpdateBudgetMs;
+
+	/** Time a rebuild of the tiles dirtied by the enabled obstacles should take, in milliseconds */
+	UPROPERTY(config)
+	float RebuildBudgetMs;
+
+	/** Most tiles dirtied per rebuild, also the limit until the time per tile is measured */
+	UPROPERTY(config)
+	int32 MaxTilesPerRebuild;
+
+	/** Longest time an obstacle waits for the running rebuild to finish, in seconds */
+	UPROPERTY(config)
+	float MaxCoalesceDelay;
+
+	/** See FCellDemoPathCache */
+	UPROPERTY(config)
+	float PathCacheCellSize;
+
+	UPROPERTY(config)
+	int32 PathCacheMaxEntries;
+
+	/** Called by the obstacles when they register */
+	void QueueObstacle(class UCellDemoBlockNavComponent* Obstacle);
+
+	int32 GetNumPendingObstacles() const { return PendingObstacles.Num(); }
+
+	/** Called by the obstacles when they start or stop affecting the navmesh */
+	void OnObstacleChanged(const FBox& Bounds);
+
+	FCellDemoPathCache& GetPathCache() { return PathCache; }
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	TArray<TWeakObjectPtr<class UCellDemoBlockNavComponent>> PendingObstacles;
+
+	/** Time the oldest pending obstacle was queued at */
+	double OldestPendingTime;
+
+	/** Time the running tile rebuild started at, 0 if none */
+	double RebuildStartTime;
+
+	FDelegateHandle ActorSpawnedHandle;
+
+	FCellDemoPathCache PathCache;
+
+	/** Bounds of the obstacle changes waiting for a rebuild, and of the ones applied by the running rebuild */
+	TArray<FBox> DirtyBounds;
+	TArray<FBox> RebuildDirtyBounds;
+
+	/** Tiles dirtied since the last rebuild started, when the first of them was, and how many the running rebuild has */
+	TSet<FIntPoint> DirtyTiles;
+	double DirtyTilesTime;
+	int32 RebuildNumTiles;
+
+	/** Smoothed rebuild time per tile, 0 until a rebuild was measured */
+	float TileRebuildMs;
+
+	/** Report of the current one second window */
+	float WindowTime;
+	int32 WindowRebuilds;
+	float WindowRebuildTimeMs;
+	float WindowMaxRebuildTimeMs;
+	FCellDemoServerStatsSample WindowStartStats;
+
+	void OnActorSpawned(AActor* Actor);
+	void AddObstacle(AActor* Actor);
+	void UpdatePendingObstacles();
+	void PublishReport();
+
+	/** Tiles a rebuild can take within RebuildBudgetMs */
+	int32 GetTileBudget() const;
+	void AddDirtyTiles(const FBox& Bounds);
+};
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoPathCache.h"
+#include "AI/Navigation/NavigationSystem.h"
+#include "AI/Navigation/RecastNavMesh.h"
+#include "CellDemoStats.h"
+
+FCellDemoPathCache::FCellDemoPathCache()
+	: CellSize(100.0f)
+	, MaxEntries(1024)
+	, AvgMissTime(0.0)
+	, NumTimedMisses(0)
+{
+}
+
+FNavPathSharedPtr FCellDemoPathCache::FindPath(UNavigationSystem& NavSys, const ANavigationData& NavData, const UObject* Querier, const FVector& Start, const FVector& Goal)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FNavLocation StartLocation;
+	FNavLocation GoalLocation;
+	const bool bProjected = NavData.ProjectPoint(Start, StartLocation, NavData.GetDefaultQueryExtent(), nullptr, Querier)
+		&& NavData.ProjectPoint(Goal, GoalLocation, NavData.GetDefaultQueryExtent(), nullptr, Querier);
+
+	FCellPathCacheKey Key;
+	if (bProjected)
+	{
+		Key.StartPoly = StartLocation.NodeRef;
+		Key.GoalPoly = GoalLocation.NodeRef;
+		Key.StartCell = FIntPoint(FMath::FloorToInt(Start.X / CellSize), FMath::FloorToInt(Start.Y / CellSize));
+		Key.GoalCell = FIntPoint(FMath::FloorToInt(Goal.X / CellSize), FMath::FloorToInt(Goal.Y / CellSize));
+
+		if (FEntry* Entry = Entries.Find(Key))
+		{
+			Entry->LastUseTime = StartTime;
+			FNavPathSharedPtr Path = MakeSplicedPath(*Entry, NavData, Querier, StartLocation, GoalLocation);
+
+			FCellDemoServerStats::PathCacheHits++;
+			FCellDemoServerStats::PathCacheSavedTime += FMath::Max(0.0, AvgMissTime - (FPlatformTime::Seconds() - StartTime));
+			return Path;
+		}
+	}
+
+	FPathFindingQuery Query(Querier, NavData, Start, Goal);
+	const FPathFindingResult Result = NavSys.FindPathSync(Query);
+
+	const double MissTime = FPlatformTime::Seconds() - StartTime;
+	AvgMissTime = (AvgMissTime * NumTimedMisses + MissTime) / (NumTimedMisses + 1);
+	NumTimedMisses = FMath::Min(NumTimedMisses + 1, 100);
+	FCellDemoServerStats::PathCacheMisses++;
+
+	// Partial paths depend on where the goal is exactly, only keep the complete ones
+	const FNavMeshPath* MeshPath = Result.IsSuccessful() && !Result.IsPartial() ? Result.Path->CastPath<FNavMeshPath>() : nullptr;
+	if (bProjected && MeshPath != nullptr && MeshPath->GetPathPoints().Num() > 1)
+	{
+		FEntry& Entry = Entries.Add(Key);
+		Entry.PathPoints = MeshPath->GetPathPoints();
+		Entry.PathCorridor = MeshPath->PathCorridor;
+		Entry.Bounds = FBox(ForceInit);
+		for (const FNavPathPoint& PathPoint : Entry.PathPoints)
+		{
+			Entry.Bounds += PathPoint.Location;
+		}
+		Entry.LastUseTime = StartTime;
+
+		if (Entries.Num() > MaxEntries)
+		{
+			Trim();
+		}
+	}
+
+	return Result.Path;
+}
+
+FNavPathSharedPtr FCellDemoPathCache::MakeSplicedPath(const FEntry& Entry, const ANavigationData& NavData, const UObject* Querier, const FNavLocation& Start, const FNavLocation& Goal) const
+{
+	// Start and goal share their polygons with the ends of the cached path, the polygons are convex so going through
+	// the cached ends is always valid. Skip them when the next corner can be reached directly.
+	const TArray<FNavPathPoint>& CachedPoints = Entry.PathPoints;
+	const int32 LastIndex = CachedPoints.Num() - 1;
+	FVector HitLocation;
+
+	int32 FirstIndex = 0;
+	if (LastIndex > 1 && !NavData.Raycast(Start.Location, CachedPoints[1].Location, HitLocation, nullptr, Querier))
+	{
+		FirstIndex = 1;
+	}
+
+	int32 EndIndex = LastIndex;
+	if (LastIndex - 1 > FirstIndex && !NavData.Raycast(CachedPoints[LastIndex - 1].Location, Goal.Location, HitLocation, nullptr, Querier))
+	{
+		EndIndex = LastIndex - 1;
+	}
+
+	FNavMeshPath* Path = new FNavMeshPath();
+	Path->GetPathPoints().Reserve(EndIndex - FirstIndex + 3);
+	Path->GetPathPoints().Add(FNavPathPoint(Start.Location, Start.NodeRef));
+	for (int32 Index = FirstIndex; Index <= EndIndex; Index++)
+	{
+		Path->GetPathPoints().Add(CachedPoints[Index]);
+	}
+	Path->GetPathPoints().Add(FNavPathPoint(Goal.Location, Goal.NodeRef));
+
+	Path->PathCorridor = Entry.PathCorridor;
+	Path->bStringPulled = true;
+	Path->SetNavigationDataUsed(&NavData);
+	Path->SetQuerier(Querier);
+	Path->MarkReady();
+
+	return MakeShareable(Path);
+}
+
+void FCellDemoPathCache::Invalidate(const FBox& Bounds)
+{
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (It.Value().Bounds.Intersect(Bounds))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FCellDemoPathCache::Empty()
+{
+	Entries.Empty();
+}
+
+void FCellDemoPathCache::Trim()
+{
+	// Drop the least recently used quarter at once, so the sort doesn't run on every miss
+	TArray<TPair<double, FCellPathCacheKey>> UseTimes;
+	UseTimes.Reserve(Entries.Num());
+	for (const TPair<FCellPathCacheKey, FEntry>& Entry : Entries)
+	{
+		UseTimes.Add(TPair<double, FCellPathCacheKey>(Entry.Value.LastUseTime, Entry.Key));
+	}
+	UseTimes.Sort([](const TPair<double, FCellPathCacheKey>& A, const TPair<double, FCellPathCacheKey>& B) { return A.Key < B.Key; });
+
+	const int32 NumRemoved = UseTimes.Num() - MaxEntries * 3 / 4;
+	for (int32 Index = 0; Index < NumRemoved; Index++)
+	{
+		Entries.Remove(UseTimes[Index].Value);
+	}
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/Navigation/NavigationTypes.h"
+
+class ANavigationData;
+class UNavigationSystem;
+
+/** Start and goal navmesh polygons, and the cells of the start and goal points so large polygons don't share one path */
+struct FCellPathCacheKey
+{
+	NavNodeRef StartPoly;
+	NavNodeRef GoalPoly;
+	FIntPoint StartCell;
+	FIntPoint GoalCell;
+
+	bool operator==(const FCellPathCacheKey& Other) const
+	{
+		return StartPoly == Other.StartPoly && GoalPoly == Other.GoalPoly && StartCell == Other.StartCell && GoalCell == Other.GoalCell;
+	}
+
+	friend uint32 GetTypeHash(const FCellPathCacheKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.StartPoly), GetTypeHash(Key.GoalPoly)), HashCombine(GetTypeHash(Key.StartCell), GetTypeHash(Key.GoalCell)));
+	}
+};
+
+/**
+*	Server side cache of the navmesh paths of the move requests.
+*
+*	Players of a cell click toward the same areas, a path found for one pawn is reused for the next requests going
+*	between the same polygons and cells. The cached path is spliced to the actual start and goal of the pawn with a
+*	navmesh raycast at both ends. Entries crossing the bounds of a navigation change are dropped, the nav manager
+*	reports the bounds of the obstacles when they change and again when the tile rebuild applying them is done.
+*/
+class CELLDEMO_API FCellDemoPathCache
+{
+public:
+	FCellDemoPathCache();
+
+	/** Size of the cells the start and goal points are quantized to, in world units */
+	float CellSize;
+
+	/** Least recently used entries are dropped above this count */
+	int32 MaxEntries;
+
+	/** Finds a path from Start to Goal, from the cache when possible. Counts the hits and misses in the server stats. */
+	FNavPathSharedPtr FindPath(UNavigationSystem& NavSys, const ANavigationData& NavData, const UObject* Querier, const FVector& Start, const FVector& Goal);
+
+	/** Drops the paths going through Bounds */
+	void Invalidate(const FBox& Bounds);
+
+	void Empty();
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	struct FEntry
+	{
+		TArray<FNavPathPoint> PathPoints;
+		TArray<NavNodeRef> PathCorridor;
+		FBox Bounds;
+		double LastUseTime;
+	};
+
+	TMap<FCellPathCacheKey, FEntry> Entries;
+
+	/** Running average of the path finding time of the misses, what a hit is assumed to save */
+	double AvgMissTime;
+	int32 NumTimedMisses;
+
+	FNavPathSharedPtr MakeSplicedPath(const FEntry& Entry, const ANavigationData& NavData, const UObject* Querier, const FNavLocation& Start, const FNavLocation& Goal) const;
+	void Trim();
+};
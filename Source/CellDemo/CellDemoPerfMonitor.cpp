@@ -0,0 +1,234 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoPerfMonitor.h"
+#include "CellDemo.h"
+#include "Debug/DebugDrawService.h"
+#include "Engine/Canvas.h"
+#include "HAL/FileManager.h"
+#include "Misc/App.h"
+#include "Misc/Paths.h"
+
+UCellDemoPerfMonitor::UCellDemoPerfMonitor()
+{
+	GameInstance = nullptr;
+	HistoryHead = 0;
+	CaptureWriter = nullptr;
+	CaptureStartTime = 0.0;
+	CaptureDuration = 0.0f;
+}
+
+void UCellDemoPerfMonitor::Initialize(UCellNWGameInstance* InGameInstance)
+{
+	GameInstance = InGameInstance;
+	History.SetNum(HistorySize);
+	HistoryHead = 0;
+}
+
+void UCellDemoPerfMonitor::BeginDestroy()
+{
+	SetOverlayVisible(false);
+	StopCapture();
+
+	Super::BeginDestroy();
+}
+
+void UCellDemoPerfMonitor::SetOverlayVisible(bool bVisible)
+{
+	if (bVisible && !DrawHandle.IsValid())
+	{
+		DrawHandle = UDebugDrawService::Register(TEXT("Game"), FDebugDrawDelegate::CreateUObject(this, &UCellDemoPerfMonitor::DrawOverlay));
+	}
+	else if (!bVisible && DrawHandle.IsValid())
+	{
+		UDebugDrawService::Unregister(DrawHandle);
+		DrawHandle.Reset();
+	}
+}
+
+FString UCellDemoPerfMonitor::StartCapture(float Duration)
+{
+	StopCapture();
+
+	const FString FilePath = FPaths::ProjectSavedDir() / TEXT("Profiling/CellPerf") / FDateTime::Now().ToString() + TEXT(".cellperf");
+	CaptureWriter = IFileManager::Get().CreateFileWriter(*FilePath);
+	if (CaptureWriter == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("PerfCapture: could not create %s"), *FilePath);
+		return FString();
+	}
+
+	uint32 Magic = CaptureMagic;
+	uint32 Version = CaptureVersion;
+	FString BuildVersion = FApp::GetBuildVersion();
+	FString Platform = FPlatformProperties::IniPlatformName();
+	*CaptureWriter << Magic << Version << BuildVersion << Platform;
+
+	CaptureStartTime = FPlatformTime::Seconds();
+	CaptureDuration = Duration;
+
+	// Always start with the current session timings so a capture can be read on its own
+	WriteSessionTimings(0.0f);
+
+	UE_LOG(LogCellDemo, Log, TEXT("PerfCapture: recording %.1f seconds to %s"), Duration, *FilePath);
+	return FilePath;
+}
+
+void UCellDemoPerfMonitor::StopCapture()
+{
+	if (CaptureWriter != nullptr)
+	{
+		CaptureWriter->Close();
+		delete CaptureWriter;
+		CaptureWriter = nullptr;
+
+		UE_LOG(LogCellDemo, Log, TEXT("PerfCapture: done"));
+	}
+}
+
+bool UCellDemoPerfMonitor::IsTickable() const
+{
+	return IsOverlayVisible() || IsCapturing();
+}
+
+TStatId UCellDemoPerfMonitor::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellDemoPerfMonitor, STATGROUP_Tickables);
+}
+
+void UCellDemoPerfMonitor::Tick(float DeltaTime)
+{
+	FCellDemoFrameSample Sample = FCellDemoFrameSample::Capture(GameInstance != nullptr ? GameInstance->GetWorld() : nullptr);
+
+	History[HistoryHead] = Sample;
+	HistoryHead = (HistoryHead + 1) % HistorySize;
+
+	if (CaptureWriter != nullptr)
+	{
+		float Time = FPlatformTime::Seconds() - CaptureStartTime;
+
+		if (GameInstance != nullptr && !(GameInstance->SessionStageTimings == CapturedSessionTimings))
+		{
+			WriteSessionTimings(Time);
+		}
+
+		uint8 Type = 0;
+		*CaptureWriter << Type << Time << Sample;
+
+		if (Time > CaptureDuration)
+		{
+			StopCapture();
+		}
+	}
+}
+
+void UCellDemoPerfMonitor::WriteSessionTimings(float Time)
+{
+	if (GameInstance == nullptr)
+	{
+		return;
+	}
+
+	CapturedSessionTimings = GameInstance->SessionStageTimings;
+
+	uint8 Type = 1;
+	*CaptureWriter << Type << Time;
+	*CaptureWriter << CapturedSessionTimings.CreateMs << CapturedSessionTimings.StartMs << CapturedSessionTimings.FindMs;
+	*CaptureWriter << CapturedSessionTimings.JoinMs << CapturedSessionTimings.DestroyMs;
+}
+
+void UCellDemoPerfMonitor::DrawOverlay(UCanvas* Canvas, APlayerController* PC)
+{
+	UFont* Font = GEngine->GetSmallFont();
+	const float Left = 20.0f;
+	const float Width = 2.0f * HistorySize;
+	const float Height = 100.0f;
+	const float Top = Canvas->ClipY * 0.5f - Height;
+
+	// Graph scale is 0-66ms, with a line at the 30 fps budget
+	const float MaxMs = 66.6f;
+	const float BudgetY = Top + Height - Height * 33.3f / MaxMs;
+	Canvas->K2_DrawLine(FVector2D(Left, Top + Height), FVector2D(Left + Width, Top + Height), 1.0f, FLinearColor::Gray);
+	Canvas->K2_DrawLine(FVector2D(Left, BudgetY), FVector2D(Left + Width, BudgetY), 1.0f, FLinearColor::Yellow);
+
+	float AvgFrameMs = 0.0f;
+	float MaxFrameMs = 0.0f;
+	for (int32 i = 1; i < HistorySize; i++)
+	{
+		const FCellDemoFrameSample& Previous = History[(HistoryHead + i - 1) % HistorySize];
+		const FCellDemoFrameSample& Current = History[(HistoryHead + i) % HistorySize];
+
+		const float X0 = Left + 2.0f * (i - 1);
+		const float Y0 = Top + Height - Height * FMath::Min(Previous.FrameMs, MaxMs) / MaxMs;
+		const float Y1 = Top + Height - Height * FMath::Min(Current.FrameMs, MaxMs) / MaxMs;
+		Canvas->K2_DrawLine(FVector2D(X0, Y0), FVector2D(X0 + 2.0f, Y1), 1.0f, Current.FrameMs > 33.3f ? FLinearColor::Red : FLinearColor::Green);
+
+		AvgFrameMs += Current.FrameMs;
+		MaxFrameMs = FMath::Max(MaxFrameMs, Current.FrameMs);
+	}
+	AvgFrameMs /= HistorySize - 1;
+
+	const FCellDemoFrameSample& Last = History[(HistoryHead + HistorySize - 1) % HistorySize];
+
+	float Y = Top + Height + 5.0f;
+	Canvas->SetDrawColor(FColor::White);
+	Y += Canvas->DrawText(Font, FString::Printf(TEXT("Frame %.1f ms (avg %.1f, max %.1f)"), Last.FrameMs, AvgFrameMs, MaxFrameMs), Left, Y);
+	Y += Canvas->DrawText(Font, FString::Printf(TEXT("Game %.1f ms  Render %.1f ms  GPU %.1f ms"), Last.GameThreadMs, Last.RenderThreadMs, Last.GPUMs), Left, Y);
+	Y += Canvas->DrawText(Font, FString::Printf(TEXT("Net in %.1f KB/s  out %.1f KB/s"), Last.NetInBytesPerSecond / 1024.0f, Last.NetOutBytesPerSecond / 1024.0f), Left, Y);
+	Y += Canvas->DrawText(Font, FString::Printf(TEXT("Ping %.0f ms  Loss %.1f%%  Mem %.0f MB"), Last.PingMs, Last.PacketLossPercent, Last.UsedMemoryMB), Left, Y);
+
+	if (GameInstance != nullptr)
+	{
+		const FCellSessionStageTimings& Timings = GameInstance->SessionStageTimings;
+		Y += Canvas->DrawText(Font, FString::Printf(TEXT("Session create %.0f  start %.0f  find %.0f  join %.0f  destroy %.0f ms"),
+			Timings.CreateMs, Timings.StartMs, Timings.FindMs, Timings.JoinMs, Timings.DestroyMs), Left, Y);
+	}
+
+	if (IsCapturing())
+	{
+		Canvas->SetDrawColor(FColor::Red);
+		Canvas->DrawText(Font, FString::Printf(TEXT("Capturing %.0f s"), FPlatformTime::Seconds() - CaptureStartTime), Left, Y);
+	}
+}
+
+// *******************************
+// Console
+// *******************************
+
+static UCellDemoPerfMonitor* GetPerfMonitor(UWorld* World)
+{
+	UCellNWGameInstance* GameInstance = World != nullptr ? Cast<UCellNWGameInstance>(World->GetGameInstance()) : nullptr;
+	return GameInstance != nullptr ? GameInstance->PerfMonitor : nullptr;
+}
+
+static void PerfOverlayCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (UCellDemoPerfMonitor* PerfMonitor = GetPerfMonitor(World))
+	{
+		PerfMonitor->SetOverlayVisible(Args.Num() > 0 ? Args[0].ToBool() : !PerfMonitor->IsOverlayVisible());
+	}
+}
+
+static void PerfCaptureCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (UCellDemoPerfMonitor* PerfMonitor = GetPerfMonitor(World))
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("stop"))
+		{
+			PerfMonitor->StopCapture();
+		}
+		else
+		{
+			PerfMonitor->StartCapture(Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.0f);
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs PerfOverlayCmd(
+	TEXT("CellDemo.PerfOverlay"),
+	TEXT("Shows or hides the performance overlay. Usage: CellDemo.PerfOverlay [0|1]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(PerfOverlayCommand));
+
+static FAutoConsoleCommandWithWorldAndArgs PerfCaptureCmd(
+	TEXT("CellDemo.PerfCapture"),
+	TEXT("Records a binary performance trace. Usage: CellDemo.PerfCapture <Seconds>|stop"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(PerfCaptureCommand));
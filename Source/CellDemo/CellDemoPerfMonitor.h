@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Tickable.h"
+#include "CellDemoStats.h"
+#include "CellNWGameInstance.h"
+#include "CellDemoPerfMonitor.generated.h"
+
+/**
+*	On device performance overlay and binary capture.
+*
+*	The overlay draws a rolling frame time graph, the game/render/GPU split, the net traffic, ping and packet loss
+*	of the current session and the last session stage timings of the game instance.
+*	A capture writes the same data every frame to Saved/Profiling/CellPerf/<Date>.cellperf:
+*		uint32 Magic, uint32 Version, FString BuildVersion, FString Platform
+*		then records of uint8 Type, float Time followed by a FCellDemoFrameSample (Type 0) or a FCellSessionStageTimings (Type 1)
+*
+*	Console: CellDemo.PerfOverlay [0|1], CellDemo.PerfCapture <Seconds>|stop
+*/
+UCLASS()
+class UCellDemoPerfMonitor : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoPerfMonitor();
+
+	static const uint32 CaptureMagic = 0x46525043; // 'CPRF'
+	static const uint32 CaptureVersion = 1;
+
+	void Initialize(class UCellNWGameInstance* InGameInstance);
+
+	virtual void BeginDestroy() override;
+
+	void SetOverlayVisible(bool bVisible);
+	bool IsOverlayVisible() const { return DrawHandle.IsValid(); }
+
+	/** Returns the path of the capture file, empty if it could not be created */
+	FString StartCapture(float Duration);
+	void StopCapture();
+	bool IsCapturing() const { return CaptureWriter != nullptr; }
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+protected:
+	/** Number of frames in the rolling graph */
+	static const int32 HistorySize = 240;
+
+	UPROPERTY(Transient)
+	class UCellNWGameInstance* GameInstance;
+
+	TArray<FCellDemoFrameSample> History;
+	int32 HistoryHead;
+
+	FDelegateHandle DrawHandle;
+
+	FArchive* CaptureWriter;
+	double CaptureStartTime;
+	float CaptureDuration;
+	FCellSessionStageTimings CapturedSessionTimings;
+
+	void DrawOverlay(class UCanvas* Canvas, class APlayerController* PC);
+	void WriteSessionTimings(float Time);
+};
@@ -0,0 +1,605 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoPerfSuite.h"
+#include "CellDemo.h"
+#include "CellNWGameInstance.h"
+#include "CellDemoBotManager.h"
+#include "Online.h"
+#include "Engine/Engine.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+
+UCellDemoPerfSuite::UCellDemoPerfSuite()
+{
+	NumCharacters = 16;
+	ClicksPerSecond = 1.0f;
+	WarmupTime = 5.0f;
+	SampleTime = 30.0f;
+	TravelTimeout = 60.0f;
+	JoinArguments = TEXT("-nullrhi -unattended -nosound");
+	JoinRetryInterval = 5.0f;
+	BaselineFile = TEXT("PerfBaselines/CellPerfBaseline.csv");
+	TolerancePercent = 15.0f;
+	MinAbsoluteDelta = 0.5f;
+
+	GameInstance = nullptr;
+	Stage = EStage::Idle;
+	MapIndex = 0;
+	StageStartTime = 0.0;
+	bMapLoaded = false;
+	bFailed = false;
+	bExitWhenDone = false;
+	RunResult = ECellPerfResult::Pass;
+	LastSearchTime = 0.0;
+}
+
+bool UCellDemoPerfSuite::Start(UCellNWGameInstance* InGameInstance, const TArray<FString>& InMaps, bool bInExitWhenDone)
+{
+	if (IsRunning())
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("CellPerf: the suite is already running"));
+		return false;
+	}
+
+	GameInstance = InGameInstance;
+	RunMaps = InMaps;
+	MapIndex = 0;
+	bFailed = false;
+	bExitWhenDone = bInExitWhenDone;
+	RunResult = ECellPerfResult::Pass;
+	Results.Empty();
+
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UCellDemoPerfSuite::OnPostLoadMap);
+
+	UE_LOG(LogCellDemo, Log, TEXT("CellPerf: starting suite on %d maps"), RunMaps.Num());
+	BeginMap();
+	return true;
+}
+
+void UCellDemoPerfSuite::StartJoin(UCellNWGameInstance* InGameInstance, const FString& InSessionId)
+{
+	GameInstance = InGameInstance;
+	SessionId = InSessionId;
+	LastSearchTime = 0.0;
+
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UCellDemoPerfSuite::OnPostLoadMap);
+
+	UE_LOG(LogCellDemo, Log, TEXT("CellPerf: joining %s"), *SessionId);
+	SetStage(EStage::Searching);
+}
+
+const TCHAR* UCellDemoPerfSuite::GetResultName(ECellPerfResult InResult)
+{
+	switch (InResult)
+	{
+	case ECellPerfResult::Pass:
+		return TEXT("PASS");
+	case ECellPerfResult::NoBaseline:
+		return TEXT("NOBASELINE");
+	default:
+		return TEXT("FAIL");
+	}
+}
+
+FString UCellDemoPerfSuite::GetOutputDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Profiling/CellPerf");
+}
+
+FString UCellDemoPerfSuite::GetJoinedPath(const FString& InSessionId)
+{
+	return GetOutputDir() / InSessionId + TEXT(".joined");
+}
+
+bool UCellDemoPerfSuite::IsTickable() const
+{
+	return Stage != EStage::Idle && Stage != EStage::Done && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UCellDemoPerfSuite::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellDemoPerfSuite, STATGROUP_Tickables);
+}
+
+void UCellDemoPerfSuite::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (LoadedWorld == nullptr)
+	{
+		return;
+	}
+
+	switch (Stage)
+	{
+	case EStage::Hosting:
+		// Only the map we asked for, hosted, the default map loading after the boot is not it
+		if (LoadedWorld->GetNetMode() == NM_ListenServer && LoadedWorld->GetMapName() == FPackageName::GetShortName(RunMaps[MapIndex]))
+		{
+			bMapLoaded = true;
+		}
+		break;
+
+	case EStage::Searching:
+		if (LoadedWorld->GetNetMode() == NM_Client)
+		{
+			bMapLoaded = true;
+		}
+		break;
+
+	case EStage::Leaving:
+	case EStage::Joined:
+		// Back to the Phone level, out of the session
+		if (LoadedWorld->GetNetMode() == NM_Standalone)
+		{
+			bMapLoaded = true;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UCellDemoPerfSuite::SetStage(EStage NewStage)
+{
+	Stage = NewStage;
+	StageStartTime = FPlatformTime::Seconds();
+	bMapLoaded = false;
+}
+
+void UCellDemoPerfSuite::BeginMap()
+{
+	if (MapIndex >= RunMaps.Num())
+	{
+		Finish();
+		return;
+	}
+
+	CurrentResult = FCellPerfMapResult();
+	CurrentResult.MapName = FPaths::GetBaseFilename(RunMaps[MapIndex]);
+	SessionId = FString::Printf(TEXT("CellPerf-%s"), *CurrentResult.MapName);
+	Samples.Reset();
+
+	UE_LOG(LogCellDemo, Log, TEXT("CellPerf: hosting %s"), *RunMaps[MapIndex]);
+
+	// Go through the real session code, the host travels to the map as a listen server once the session started.
+	// The bots don't take a slot, the joining process does.
+	SetStage(EStage::Hosting);
+	GameInstance->StartOnlineGame(RunMaps[MapIndex], 2, SessionId);
+}
+
+void UCellDemoPerfSuite::FailMap()
+{
+	CurrentResult.bFailed = true;
+	bFailed = true;
+}
+
+bool UCellDemoPerfSuite::LaunchJoinProcess()
+{
+	IFileManager::Get().Delete(*GetJoinedPath(SessionId), false, true, true);
+
+	FString Arguments = FString::Printf(TEXT("-CellPerfJoin=%s %s"), *SessionId, *JoinArguments);
+
+	// An uncooked game runs from the editor executable, which needs the project
+	if (!FPlatformProperties::RequiresCookedData())
+	{
+		Arguments = FString::Printf(TEXT("\"%s\" -game %s"), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *Arguments);
+	}
+
+	const FString ExecutablePath = FPaths::ConvertRelativePathToFull(FString(FPlatformProcess::BaseDir()) / FPlatformProcess::ExecutableName(false));
+	JoinProcess = FPlatformProcess::CreateProc(*ExecutablePath, *Arguments, true, false, false, nullptr, 0, nullptr, nullptr);
+	if (!JoinProcess.IsValid())
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellPerf: could not start the joining process %s"), *ExecutablePath);
+		return false;
+	}
+
+	return true;
+}
+
+void UCellDemoPerfSuite::StopJoinProcess()
+{
+	if (JoinProcess.IsValid())
+	{
+		// It exits by itself once the session is gone, unless it never made it in
+		if (FPlatformProcess::IsProcRunning(JoinProcess))
+		{
+			FPlatformProcess::TerminateProc(JoinProcess);
+		}
+		FPlatformProcess::CloseProc(JoinProcess);
+	}
+}
+
+void UCellDemoPerfSuite::Tick(float DeltaTime)
+{
+	const double StageTime = FPlatformTime::Seconds() - StageStartTime;
+
+	switch (Stage)
+	{
+	case EStage::Hosting:
+		if (bMapLoaded)
+		{
+			CurrentResult.HostTimeMs = StageTime * 1000.0f;
+			if (LaunchJoinProcess())
+			{
+				SetStage(EStage::Joining);
+			}
+			else
+			{
+				FailMap();
+				SetStage(EStage::Warmup);
+			}
+		}
+		else if (StageTime > TravelTimeout)
+		{
+			// Nothing to sample, but the map still gets its FAIL row in the summary
+			UE_LOG(LogCellDemo, Error, TEXT("CellPerf: timed out hosting %s"), *RunMaps[MapIndex]);
+			FailMap();
+			CurrentResult.HostTimeMs = StageTime * 1000.0f;
+			Results.Add(CurrentResult);
+			MapIndex++;
+			BeginMap();
+		}
+		break;
+
+	case EStage::Joining:
+		if (FPaths::FileExists(GetJoinedPath(SessionId)))
+		{
+			FString JoinTimeMs;
+			FFileHelper::LoadFileToString(JoinTimeMs, *GetJoinedPath(SessionId));
+			CurrentResult.JoinTimeMs = FCString::Atof(*JoinTimeMs);
+			SetStage(EStage::Warmup);
+		}
+		else if (StageTime > TravelTimeout || !FPlatformProcess::IsProcRunning(JoinProcess))
+		{
+			// Still worth sampling the host alone
+			UE_LOG(LogCellDemo, Error, TEXT("CellPerf: the joining process did not join %s"), *RunMaps[MapIndex]);
+			FailMap();
+			StopJoinProcess();
+			SetStage(EStage::Warmup);
+		}
+		break;
+
+	case EStage::Warmup:
+		if (StageTime > WarmupTime)
+		{
+			if (ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(GameInstance->GetWorld()))
+			{
+				BotManager->bLogReport = false;
+				BotManager->SpawnBots(NumCharacters, ECellBotPattern::RandomWalk, ClicksPerSecond);
+			}
+			SetStage(EStage::Running);
+		}
+		break;
+
+	case EStage::Running:
+		Samples.Add(FCellDemoFrameSample::Capture(GameInstance->GetWorld()));
+		if (StageTime > SampleTime)
+		{
+			FinishSampling();
+			SetStage(EStage::Leaving);
+			GameInstance->DestroySessionAndLeaveGame();
+		}
+		break;
+
+	case EStage::Leaving:
+		if (bMapLoaded || StageTime > TravelTimeout)
+		{
+			if (!bMapLoaded)
+			{
+				UE_LOG(LogCellDemo, Error, TEXT("CellPerf: timed out leaving %s"), *RunMaps[MapIndex]);
+				FailMap();
+			}
+			StopJoinProcess();
+			CurrentResult.LeaveTimeMs = StageTime * 1000.0f;
+			Results.Add(CurrentResult);
+			MapIndex++;
+			BeginMap();
+		}
+		break;
+
+	case EStage::Searching:
+	case EStage::Joined:
+		TickJoin(StageTime);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UCellDemoPerfSuite::TickJoin(double StageTime)
+{
+	if (Stage == EStage::Joined)
+	{
+		// The host hung up, the run of this map is over
+		if (bMapLoaded)
+		{
+			FinishJoin();
+		}
+		return;
+	}
+
+	if (bMapLoaded)
+	{
+		// Find, probe, join and travel, as seen by a player
+		const FString JoinTimeMs = FString::Printf(TEXT("%.1f"), StageTime * 1000.0);
+		FFileHelper::SaveStringToFile(JoinTimeMs, *GetJoinedPath(SessionId));
+		UE_LOG(LogCellDemo, Log, TEXT("CellPerf: joined %s in %s ms"), *SessionId, *JoinTimeMs);
+		SetStage(EStage::Joined);
+	}
+	else if (StageTime > TravelTimeout)
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellPerf: timed out joining %s"), *SessionId);
+		FinishJoin();
+	}
+	else if (FPlatformTime::Seconds() - LastSearchTime > JoinRetryInterval)
+	{
+		// The search can miss a session advertised a moment ago, look again unless a join is already on its way
+		IOnlineSubsystem* OnlineSub = IOnlineSubsystem::IsLoaded() ? IOnlineSubsystem::Get() : nullptr;
+		IOnlineSessionPtr Sessions = OnlineSub != nullptr ? OnlineSub->GetSessionInterface() : nullptr;
+		const bool bJoining = GameInstance->GetNumRegisteredSessionDelegates() > 0 || GameInstance->HostProber.IsRunning()
+			|| (Sessions.IsValid() && Sessions->GetNamedSession(GameSessionName) != nullptr);
+
+		if (!bJoining)
+		{
+			LastSearchTime = FPlatformTime::Seconds();
+			GameInstance->FindAndJoinOnlineGame(SessionId);
+		}
+	}
+}
+
+void UCellDemoPerfSuite::FinishJoin()
+{
+	Stage = EStage::Done;
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+	FPlatformMisc::RequestExit(false);
+}
+
+void UCellDemoPerfSuite::FinishSampling()
+{
+	if (ACellDemoBotManager* BotManager = ACellDemoBotManager::Get(GameInstance->GetWorld()))
+	{
+		BotManager->ClearBots();
+	}
+
+	if (Samples.Num() == 0)
+	{
+		return;
+	}
+
+	FString Csv = TEXT("Frame,FrameMs,GameThreadMs,RenderThreadMs,NetInBytesPerSecond,NetOutBytesPerSecond,UsedMemoryMB\n");
+	TArray<float> FrameTimes;
+	FrameTimes.Reserve(Samples.Num());
+
+	for (int32 i = 0; i < Samples.Num(); i++)
+	{
+		const FCellDemoFrameSample& Sample = Samples[i];
+		Csv += FString::Printf(TEXT("%d,%.3f,%.3f,%.3f,%u,%u,%.1f\n"), i, Sample.FrameMs, Sample.GameThreadMs, Sample.RenderThreadMs,
+			Sample.NetInBytesPerSecond, Sample.NetOutBytesPerSecond, Sample.UsedMemoryMB);
+
+		FrameTimes.Add(Sample.FrameMs);
+		CurrentResult.AvgFrameMs += Sample.FrameMs;
+		CurrentResult.AvgGameThreadMs += Sample.GameThreadMs;
+		CurrentResult.AvgNetOutKBps += Sample.NetOutBytesPerSecond / 1024.0f;
+		CurrentResult.PeakMemoryMB = FMath::Max(CurrentResult.PeakMemoryMB, Sample.UsedMemoryMB);
+	}
+
+	CurrentResult.AvgFrameMs /= Samples.Num();
+	CurrentResult.AvgGameThreadMs /= Samples.Num();
+	CurrentResult.AvgNetOutKBps /= Samples.Num();
+
+	FrameTimes.Sort();
+	CurrentResult.P95FrameMs = FrameTimes[FMath::Min(FrameTimes.Num() - 1, FMath::FloorToInt(FrameTimes.Num() * 0.95f))];
+
+	FFileHelper::SaveStringToFile(Csv, *(GetOutputDir() / CurrentResult.MapName + TEXT(".csv")));
+}
+
+void UCellDemoPerfSuite::Finish()
+{
+	Stage = EStage::Done;
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+	StopJoinProcess();
+
+	const FString OutputDir = GetOutputDir();
+
+	FString Summary = GetSummaryHeader();
+	for (const FCellPerfMapResult& Result : Results)
+	{
+		Summary += ToSummaryLine(Result);
+	}
+	FFileHelper::SaveStringToFile(Summary, *(OutputDir / TEXT("Summary.csv")));
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("CellPerfRecordBaseline")))
+	{
+		// A failed map has no numbers worth comparing to, keep the previous baseline
+		if (bFailed)
+		{
+			UE_LOG(LogCellDemo, Error, TEXT("CellPerf: the run failed, baseline %s left as is"), *BaselineFile);
+		}
+		else
+		{
+			FFileHelper::SaveStringToFile(Summary, *(FPaths::ProjectDir() / BaselineFile));
+			UE_LOG(LogCellDemo, Log, TEXT("CellPerf: baseline recorded to %s"), *BaselineFile);
+		}
+		RunResult = bFailed ? ECellPerfResult::Fail : ECellPerfResult::Pass;
+	}
+	else
+	{
+		RunResult = bFailed ? ECellPerfResult::Fail : CompareToBaseline();
+	}
+
+	// CI reads this file, the log only has the details. Anything but PASS fails the gate.
+	FFileHelper::SaveStringToFile(GetResultName(RunResult), *(OutputDir / TEXT("Result.txt")));
+
+	if (RunResult == ECellPerfResult::Pass)
+	{
+		UE_LOG(LogCellDemo, Log, TEXT("CellPerf: PASS"));
+	}
+	else
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellPerf: %s"), GetResultName(RunResult));
+	}
+
+	if (bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+ECellPerfResult UCellDemoPerfSuite::CompareToBaseline()
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *(FPaths::ProjectDir() / BaselineFile)))
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellPerf: no baseline found at %s, run with -CellPerfRecordBaseline to create it"), *BaselineFile);
+		return ECellPerfResult::NoBaseline;
+	}
+
+	static const TCHAR* MetricNames[] = { TEXT("AvgFrameMs"), TEXT("P95FrameMs"), TEXT("AvgGameThreadMs"), TEXT("AvgNetOutKBps"), TEXT("PeakMemoryMB"),
+		TEXT("HostTimeMs"), TEXT("JoinTimeMs"), TEXT("LeaveTimeMs") };
+
+	bool bRegressed = false;
+	bool bMissingBaseline = false;
+	for (const FCellPerfMapResult& Result : Results)
+	{
+		// Already failing the run, and its metrics are partial
+		if (Result.bFailed)
+		{
+			continue;
+		}
+
+		const float Current[] = { Result.AvgFrameMs, Result.P95FrameMs, Result.AvgGameThreadMs, Result.AvgNetOutKBps, Result.PeakMemoryMB,
+			Result.HostTimeMs, Result.JoinTimeMs, Result.LeaveTimeMs };
+		bool bFound = false;
+
+		// First line is the header
+		for (int32 LineIdx = 1; LineIdx < Lines.Num(); LineIdx++)
+		{
+			TArray<FString> Columns;
+			Lines[LineIdx].ParseIntoArray(Columns, TEXT(","));
+			// Map, metrics, result
+			if (Columns.Num() != ARRAY_COUNT(MetricNames) + 2 || Columns[0] != Result.MapName)
+			{
+				continue;
+			}
+			bFound = true;
+
+			for (int32 Metric = 0; Metric < ARRAY_COUNT(MetricNames); Metric++)
+			{
+				const float Baseline = FCString::Atof(*Columns[Metric + 1]);
+				const float Delta = Current[Metric] - Baseline;
+				if (Delta > MinAbsoluteDelta && Delta > Baseline * TolerancePercent / 100.0f)
+				{
+					UE_LOG(LogCellDemo, Error, TEXT("CellPerf: %s regressed on %s: %.2f (baseline %.2f)"), MetricNames[Metric], *Result.MapName, Current[Metric], Baseline);
+					bRegressed = true;
+				}
+			}
+		}
+
+		if (!bFound)
+		{
+			UE_LOG(LogCellDemo, Error, TEXT("CellPerf: %s has no line in the baseline %s, run with -CellPerfRecordBaseline to add it"), *Result.MapName, *BaselineFile);
+			bMissingBaseline = true;
+		}
+	}
+
+	if (bRegressed)
+	{
+		return ECellPerfResult::Fail;
+	}
+	return bMissingBaseline ? ECellPerfResult::NoBaseline : ECellPerfResult::Pass;
+}
+
+FString UCellDemoPerfSuite::GetSummaryHeader()
+{
+	return TEXT("Map,AvgFrameMs,P95FrameMs,AvgGameThreadMs,AvgNetOutKBps,PeakMemoryMB,HostTimeMs,JoinTimeMs,LeaveTimeMs,Result\n");
+}
+
+FString UCellDemoPerfSuite::ToSummaryLine(const FCellPerfMapResult& Result)
+{
+	return FString::Printf(TEXT("%s,%.3f,%.3f,%.3f,%.2f,%.1f,%.1f,%.1f,%.1f,%s\n"), *Result.MapName, Result.AvgFrameMs, Result.P95FrameMs,
+		Result.AvgGameThreadMs, Result.AvgNetOutKBps, Result.PeakMemoryMB, Result.HostTimeMs, Result.JoinTimeMs, Result.LeaveTimeMs,
+		Result.bFailed ? TEXT("FAIL") : TEXT("PASS"));
+}
+
+// *******************************
+// Automation
+// *******************************
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** Waits for the end of the run and fails the test unless the suite passed */
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FCellPerfWaitForSuiteCommand, TWeakObjectPtr<UCellDemoPerfSuite>, Suite, FAutomationTestBase*, Test);
+
+bool FCellPerfWaitForSuiteCommand::Update()
+{
+	if (!Suite.IsValid())
+	{
+		Test->AddError(TEXT("CellPerf: the suite went away before the end of the run"));
+		return true;
+	}
+
+	if (Suite->IsRunning())
+	{
+		return false;
+	}
+
+	if (Suite->GetResult() != ECellPerfResult::Pass)
+	{
+		Test->AddError(FString::Printf(TEXT("CellPerf: %s, see the log and Saved/Profiling/CellPerf"), UCellDemoPerfSuite::GetResultName(Suite->GetResult())));
+	}
+	return true;
+}
+
+/** One test per map of the suite, hosted and joined like with -CellPerfSuite, in the running game */
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FCellPerfSuiteTest, "CellDemo.Perf.Suite", EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FCellPerfSuiteTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for (const FString& Map : GetDefault<UCellDemoPerfSuite>()->Maps)
+	{
+		OutBeautifiedNames.Add(FPackageName::GetShortName(Map));
+		OutTestCommands.Add(Map);
+	}
+}
+
+bool FCellPerfSuiteTest::RunTest(const FString& Parameters)
+{
+	// The suite goes through the session functions, which need the local player of a running game
+	UCellNWGameInstance* GameInstance = nullptr;
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		if ((Context.WorldType == EWorldType::Game || Context.WorldType == EWorldType::PIE) && Context.OwningGameInstance != nullptr)
+		{
+			GameInstance = Cast<UCellNWGameInstance>(Context.OwningGameInstance);
+			break;
+		}
+	}
+
+	if (GameInstance == nullptr || GameInstance->GetFirstGamePlayer() == nullptr)
+	{
+		AddError(TEXT("CellPerf: needs a running game with a local player"));
+		return false;
+	}
+
+	if (GameInstance->PerfSuite == nullptr)
+	{
+		GameInstance->PerfSuite = NewObject<UCellDemoPerfSuite>(GameInstance);
+	}
+
+	TArray<FString> TestMaps;
+	TestMaps.Add(Parameters);
+	if (!GameInstance->PerfSuite->Start(GameInstance, TestMaps, false))
+	{
+		AddError(TEXT("CellPerf: the suite is already running"));
+		return false;
+	}
+
+	ADD_LATENT_AUTOMATION_COMMAND(FCellPerfWaitForSuiteCommand(GameInstance->PerfSuite, this));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
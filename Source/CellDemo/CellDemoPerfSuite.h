@@ -0,0 +1,196 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "HAL/PlatformProcess.h"
+#include "Tickable.h"
+#include "CellDemoStats.h"
+#include "CellDemoPerfSuite.generated.h"
+
+/** Summary of the run of one map, this is what gets compared to the baseline */
+struct FCellPerfMapResult
+{
+	FString MapName;
+	float AvgFrameMs;
+	float P95FrameMs;
+	float AvgGameThreadMs;
+	float AvgNetOutKBps;
+	float PeakMemoryMB;
+	float HostTimeMs;
+	float JoinTimeMs;
+	float LeaveTimeMs;
+
+	/** The map did not make it through the run, its metrics are whatever was measured before it gave up */
+	bool bFailed;
+
+	FCellPerfMapResult()
+		: AvgFrameMs(0.0f)
+		, P95FrameMs(0.0f)
+		, AvgGameThreadMs(0.0f)
+		, AvgNetOutKBps(0.0f)
+		, PeakMemoryMB(0.0f)
+		, HostTimeMs(0.0f)
+		, JoinTimeMs(0.0f)
+		, LeaveTimeMs(0.0f)
+		, bFailed(false)
+	{
+	}
+};
+
+/** Outcome of a run, Result.txt holds its name */
+enum class ECellPerfResult : uint8
+{
+	Pass,
+	Fail,
+	/** A map has no line in the baseline, nothing was compared */
+	NoBaseline
+};
+
+/**
+*	Headless frame budget regression suite.
+*
+*	For every map: host a session on it, start a second game process joining the session, spawn bot characters
+*	issuing moves, sample the frames, hang up and go back to the Phone level. Per frame CSV and a summary CSV are
+*	written to Saved/Profiling/CellPerf, the summary is then compared to the checked-in baseline. A map missing from
+*	the baseline is not a pass, the run reports NOBASELINE until it is recorded. A map that could not be hosted, joined
+*	or left still has its row in the summary, flagged FAIL, and fails the run.
+*
+*	Run with: CellDemo -nullrhi -unattended -CellPerfSuite [-CellPerfRecordBaseline]
+*	or as the CellDemo.Perf.Suite automation tests, one per map.
+*	The joining process runs with -CellPerfJoin=<SessionId>.
+*/
+UCLASS(config = Game)
+class UCellDemoPerfSuite : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoPerfSuite();
+
+	/** Maps to run, by package name */
+	UPROPERTY(config)
+	TArray<FString> Maps;
+
+	/** Number of bot characters spawned on each map */
+	UPROPERTY(config)
+	int32 NumCharacters;
+
+	/** Move requests per second of each bot */
+	UPROPERTY(config)
+	float ClicksPerSecond;
+
+	UPROPERTY(config)
+	float WarmupTime;
+
+	UPROPERTY(config)
+	float SampleTime;
+
+	/** Give up on a map if hosting, joining or leaving takes longer than this */
+	UPROPERTY(config)
+	float TravelTimeout;
+
+	/** Command line of the joining process, on top of -CellPerfJoin */
+	UPROPERTY(config)
+	FString JoinArguments;
+
+	/** The joining process searches the session again after this many seconds without joining it */
+	UPROPERTY(config)
+	float JoinRetryInterval;
+
+	/** Baseline summary, relative to the project directory */
+	UPROPERTY(config)
+	FString BaselineFile;
+
+	/** A metric regresses when it is above the baseline by more than this percentage... */
+	UPROPERTY(config)
+	float TolerancePercent;
+
+	/** ...and by more than this absolute amount, so tiny values don't fail on noise */
+	UPROPERTY(config)
+	float MinAbsoluteDelta;
+
+	/** Hosts every map of InMaps in turn, the process exits once done if bInExitWhenDone */
+	bool Start(class UCellNWGameInstance* InGameInstance, const TArray<FString>& InMaps, bool bInExitWhenDone);
+
+	/** Joins the session the suite hosts in another process, and reports the time it took to it */
+	void StartJoin(class UCellNWGameInstance* InGameInstance, const FString& InSessionId);
+
+	bool IsRunning() const { return Stage != EStage::Idle && Stage != EStage::Done; }
+
+	/** Result of the last run, only meaningful once it is not running anymore */
+	ECellPerfResult GetResult() const { return RunResult; }
+
+	static const TCHAR* GetResultName(ECellPerfResult InResult);
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+protected:
+	enum class EStage : uint8
+	{
+		Idle,
+		Hosting,
+		Joining,
+		Warmup,
+		Running,
+		Leaving,
+		Done,
+
+		/** Stages of the joining process */
+		Searching,
+		Joined
+	};
+
+	UPROPERTY(Transient)
+	class UCellNWGameInstance* GameInstance;
+
+	EStage Stage;
+	TArray<FString> RunMaps;
+	int32 MapIndex;
+	double StageStartTime;
+	bool bMapLoaded;
+	bool bFailed;
+	bool bExitWhenDone;
+	ECellPerfResult RunResult;
+
+	/** Session the joining process looks for, and when it last searched it */
+	FString SessionId;
+	double LastSearchTime;
+
+	FProcHandle JoinProcess;
+
+	FCellPerfMapResult CurrentResult;
+	TArray<FCellDemoFrameSample> Samples;
+	TArray<FCellPerfMapResult> Results;
+
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	void SetStage(EStage NewStage);
+	void BeginMap();
+
+	/** Flags the current map, and so the run, as failed */
+	void FailMap();
+
+	bool LaunchJoinProcess();
+	void StopJoinProcess();
+	void TickJoin(double StageTime);
+	void FinishJoin();
+	void FinishSampling();
+	void Finish();
+
+	/** Fail if one of the maps regressed, NoBaseline if one of them has no baseline */
+	ECellPerfResult CompareToBaseline();
+
+	static FString GetOutputDir();
+
+	/** File the joining process writes its join time to */
+	static FString GetJoinedPath(const FString& InSessionId);
+
+	static FString GetSummaryHeader();
+	static FString ToSummaryLine(const FCellPerfMapResult& Result);
+};
@@ -6,11 +6,26 @@
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "CellDemoCharacter.h"
 #include "Camera/CameraActor.h"
+#include "CellDemoStats.h"
+#include "CellDemoNavManager.h"
+#include "CellDemoLinkQualityComponent.h"
+#include "CellDemoInitialSyncComponent.h"
+#include "CellDemoMessagingComponent.h"
+#include "CellDemoBandwidthComponent.h"
+#include "CellDemoInputTrace.h"
+#include "CellDemoSessionMigration.h"
+#include "CellNWGameInstance.h"
+#include "Navigation/PathFollowingComponent.h"
 
 ACellDemoPlayerController::ACellDemoPlayerController()
 {
 	bShowMouseCursor = true;
 	DefaultMouseCursor = EMouseCursor::Crosshairs;
+
+	LinkQuality = CreateDefaultSubobject<UCellDemoLinkQualityComponent>(TEXT("LinkQuality"));
+	InitialSync = CreateDefaultSubobject<UCellDemoInitialSyncComponent>(TEXT("InitialSync"));
+	Messaging = CreateDefaultSubobject<UCellDemoMessagingComponent>(TEXT("Messaging"));
+	Bandwidth = CreateDefaultSubobject<UCellDemoBandwidthComponent>(TEXT("Bandwidth"));
 }
 
 void ACellDemoPlayerController::PlayerTick(float DeltaTime)
@@ -65,7 +80,7 @@ void ACellDemoPlayerController::MoveToMouseCursor()
 		if (Hit.bBlockingHit)
 		{
 			// We hit something, move there
-			SetNewMoveDestination(Hit.ImpactPoint);
+			IssueMoveDestination(Hit.ImpactPoint);
 		}
 	}
 }
@@ -80,12 +95,34 @@ void ACellDemoPlayerController::MoveToTouchLocation(const ETouchIndex::Type Fing
 	if (HitResult.bBlockingHit)
 	{
 		// We hit something, move there
-		SetNewMoveDestination(HitResult.ImpactPoint);
+		IssueMoveDestination(HitResult.ImpactPoint);
 	}
 }
 
+void ACellDemoPlayerController::IssueMoveDestination(const FVector& DestLocation)
+{
+	Bandwidth->NotifyMoveIssued();
+	SetNewMoveDestination(DestLocation);
+}
+
+void ACellDemoPlayerController::ClientMigrate_Implementation(int32 Port)
+{
+	UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetGameInstance());
+	if (GameInstance == nullptr || GameInstance->SessionMigration == nullptr)
+	{
+		return;
+	}
+
+	// Same host, new port
+	const FString Host = GetWorld()->URL.Host.IsEmpty() ? FString(TEXT("127.0.0.1")) : GetWorld()->URL.Host;
+	GameInstance->SessionMigration->FollowMigration(FString::Printf(TEXT("%s:%d"), *Host, Port));
+}
+
 void ACellDemoPlayerController::SetNewMoveDestination_Implementation(const FVector DestLocation)
 {
+	FCellDemoServerStats::MoveRequests++;
+	FCellDemoInputTrace::RecordMove(this, DestLocation);
+
 	APawn* const MyPawn = GetPawn();
 	if (MyPawn && MyPawn->IsA(ACellDemoCharacter::StaticClass()))
 	{
@@ -95,11 +132,76 @@ void ACellDemoPlayerController::SetNewMoveDestination_Implementation(const FVect
 		// We need to issue move command only if far enough in order for walk animation to play correctly
 		if (NavSys && (Distance > 120.0f))
 		{
-			NavSys->SimpleMoveToLocation(this, DestLocation);
+			const double QueryStartTime = FPlatformTime::Seconds();
+			ACellDemoNavManager* NavManager = ACellDemoNavManager::Get(GetWorld());
+			if (NavManager != nullptr)
+			{
+				MoveToLocationCached(*NavSys, NavManager->GetPathCache(), DestLocation);
+			}
+			else
+			{
+				NavSys->SimpleMoveToLocation(this, DestLocation);
+			}
+
+			const double QueryTime = FPlatformTime::Seconds() - QueryStartTime;
+			FCellDemoServerStats::NavQueries++;
+			FCellDemoServerStats::NavQueryTime += QueryTime;
+			if (QueryTime > FCellDemoServerStats::NavQueryStallTime)
+			{
+				FCellDemoServerStats::NavQueryStalls++;
+			}
 		}
 	}
 }
 
+void ACellDemoPlayerController::MoveToLocationCached(UNavigationSystem& NavSys, FCellDemoPathCache& PathCache, const FVector& DestLocation)
+{
+	// Same as UNavigationSystem::SimpleMoveToLocation, with the path coming from the cache
+	UPathFollowingComponent* PathFollowingComp = FindComponentByClass<UPathFollowingComponent>();
+	if (PathFollowingComp == nullptr)
+	{
+		PathFollowingComp = NewObject<UPathFollowingComponent>(this);
+		PathFollowingComp->RegisterComponentWithWorld(GetWorld());
+		PathFollowingComp->Initialize();
+	}
+
+	if (!PathFollowingComp->IsPathFollowingAllowed())
+	{
+		return;
+	}
+
+	const bool bAlreadyAtGoal = PathFollowingComp->HasReached(DestLocation, EPathFollowingReachMode::OverlapAgent);
+
+	// keep only one move request at a time
+	if (PathFollowingComp->GetStatus() != EPathFollowingStatus::Idle)
+	{
+		PathFollowingComp->AbortMove(NavSys, FPathFollowingResultFlags::ForcedScript | FPathFollowingResultFlags::NewRequest,
+			FAIRequestID::AnyRequest, bAlreadyAtGoal ? EPathFollowingVelocityMode::Reset : EPathFollowingVelocityMode::Keep);
+	}
+
+	if (bAlreadyAtGoal)
+	{
+		PathFollowingComp->RequestMoveWithImmediateFinish(EPathFollowingResult::Success);
+		return;
+	}
+
+	const ANavigationData* NavData = NavSys.GetNavDataForProps(GetNavAgentPropertiesRef());
+	if (NavData == nullptr)
+	{
+		return;
+	}
+
+	FNavPathSharedPtr Path = PathCache.FindPath(NavSys, *NavData, this, GetNavAgentLocation(), DestLocation);
+	if (Path.IsValid() && Path->IsValid())
+	{
+		PathFollowingComp->RequestMove(FAIMoveRequest(DestLocation), Path);
+	}
+	else if (PathFollowingComp->GetStatus() != EPathFollowingStatus::Idle)
+	{
+		PathFollowingComp->RequestMoveWithImmediateFinish(EPathFollowingResult::Invalid);
+	}
+}
+
 bool ACellDemoPlayerController::SetNewMoveDestination_Validate(const FVector DestLocation)
 {
 	return true;
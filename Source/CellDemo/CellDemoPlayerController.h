@@ -31,6 +31,29 @@ public:
 
 	UFUNCTION(BlueprintImplementableEvent, Category = "Network")
 	void OnDisconnected();
+
+	/** Signal level of the connection to the server, bind its OnLevelChanged to update the ConnectionLevel indicator */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Network")
+	class UCellDemoLinkQualityComponent* LinkQuality;
+
+	/** Streams the state of the cell to a joining player, bind its events to show the sync progress */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Network")
+	class UCellDemoInitialSyncComponent* InitialSync;
+
+	/** Phone messages of the session, the UI reads them from there */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Network")
+	class UCellDemoMessagingComponent* Messaging;
+
+	/** Paces what the server sends to this player on a weak link, and measures its click to motion latency */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Network")
+	class UCellDemoBandwidthComponent* Bandwidth;
+
+	/** Issues a move request through the server call of the click and touch input. Used by bots and benches too. */
+	void IssueMoveDestination(const FVector& DestLocation);
+
+	/** The cell moved to another server process of the same host, listening on Port */
+	UFUNCTION(Client, Reliable)
+	void ClientMigrate(int32 Port);
 	
 protected:
 	/** True if the controlled character should navigate to the mouse cursor. */
@@ -54,6 +77,9 @@ protected:
 	UFUNCTION(Server, Reliable, WithValidation)
 	void SetNewMoveDestination(const FVector DestLocation);
 
+	/** Server side, moves the pawn along a path of the path cache. */
+	void MoveToLocationCached(class UNavigationSystem& NavSys, class FCellDemoPathCache& PathCache, const FVector& DestLocation);
+
 	/** Input handlers for SetDestination action. */
 	void OnSetDestinationPressed();
 	void OnSetDestinationReleased();
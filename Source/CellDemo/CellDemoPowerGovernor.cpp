@@ -0,0 +1,399 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoPowerGovernor.h"
+#include "CellDemo.h"
+#include "CellDemoTickGovernor.h"
+#include "CellNWGameInstance.h"
+#include "Engine/NetDriver.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+static TAutoConsoleVariable<int32> CVarPowerSimulate(
+	TEXT("CellDemo.Power.Simulate"),
+	0,
+	TEXT("1 to read the power state from the CellDemo.Power.Sim* variables instead of the device"));
+
+static TAutoConsoleVariable<float> CVarPowerSimBattery(
+	TEXT("CellDemo.Power.SimBatteryPercent"),
+	100.0f,
+	TEXT("Simulated battery level, in percent"));
+
+static TAutoConsoleVariable<int32> CVarPowerSimCharging(
+	TEXT("CellDemo.Power.SimCharging"),
+	0,
+	TEXT("1 if the simulated device is charging"));
+
+static TAutoConsoleVariable<float> CVarPowerSimTemperature(
+	TEXT("CellDemo.Power.SimTemperatureC"),
+	30.0f,
+	TEXT("Simulated battery temperature, in Celsius"));
+
+// *******************************
+// Providers
+// *******************************
+
+bool FCellDevicePowerProvider::GetState(FCellPowerState& OutState)
+{
+#if PLATFORM_ANDROID
+	const FPlatformMisc::FBatteryState BatteryState = FPlatformMisc::GetBatteryState();
+	OutState.BatteryLevel = BatteryState.Level / 100.0f;
+	OutState.bCharging = BatteryState.State == FPlatformMisc::BATTERY_STATE_CHARGING || BatteryState.State == FPlatformMisc::BATTERY_STATE_FULL;
+	OutState.TemperatureC = BatteryState.Temperature;
+	return true;
+#else
+	const int32 BatteryLevel = FPlatformMisc::GetBatteryLevel();
+	if (BatteryLevel < 0)
+	{
+		return false;
+	}
+	OutState.BatteryLevel = BatteryLevel / 100.0f;
+	OutState.bCharging = !FPlatformMisc::IsRunningOnBattery();
+	OutState.TemperatureC = 0.0f;
+	return true;
+#endif
+}
+
+bool FCellSimulatedPowerProvider::GetState(FCellPowerState& OutState)
+{
+	OutState.BatteryLevel = FMath::Clamp(CVarPowerSimBattery.GetValueOnGameThread() / 100.0f, 0.0f, 1.0f);
+	OutState.bCharging = CVarPowerSimCharging.GetValueOnGameThread() != 0;
+	OutState.TemperatureC = CVarPowerSimTemperature.GetValueOnGameThread();
+	return true;
+}
+
+// *******************************
+// Governor
+// *******************************
+
+UCellDemoPowerGovernor::UCellDemoPowerGovernor()
+{
+	EvaluateInterval = 5.0f;
+	RecoverDelay = 30.0f;
+
+	GameInstance = nullptr;
+	Level = 0;
+	ForcedLevel = INDEX_NONE;
+	EvaluateTime = 0.0f;
+	RecoverLevel = 0;
+	RecoverTime = 0.0f;
+	OriginalMaxFPS = 0.0f;
+}
+
+void UCellDemoPowerGovernor::Initialize(UCellNWGameInstance* InGameInstance)
+{
+	GameInstance = InGameInstance;
+
+	// Without configured policies there is nothing to scale, keep a neutral one so GetPolicy is always valid
+	if (Policies.Num() == 0)
+	{
+		Policies.AddDefaulted();
+		Policies[0].Name = TEXT("Normal");
+	}
+	LevelCpuMs.SetNumZeroed(Policies.Num());
+	LevelTime.SetNumZeroed(Policies.Num());
+
+	if (IConsoleVariable* MaxFPS = IConsoleManager::Get().FindConsoleVariable(TEXT("t.MaxFPS")))
+	{
+		OriginalMaxFPS = MaxFPS->GetFloat();
+	}
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("CellPowerSim")))
+	{
+		CVarPowerSimulate->Set(1, ECVF_SetByCommandline);
+	}
+	SetProvider(MakeShareable(new FCellDevicePowerProvider()));
+
+	// Evaluate on the first tick
+	EvaluateTime = EvaluateInterval;
+}
+
+void UCellDemoPowerGovernor::SetProvider(TSharedPtr<ICellPowerProvider> InProvider)
+{
+	Provider = InProvider;
+}
+
+bool UCellDemoPowerGovernor::IsTickable() const
+{
+	return GameInstance != nullptr && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UCellDemoPowerGovernor::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellDemoPowerGovernor, STATGROUP_Tickables);
+}
+
+const FCellPowerPolicy& UCellDemoPowerGovernor::GetPolicy() const
+{
+	return Policies[Level];
+}
+
+void UCellDemoPowerGovernor::Tick(float DeltaTime)
+{
+	LevelCpuMs[Level] += FPlatformTime::ToMilliseconds(GGameThreadTime);
+	LevelTime[Level] += DeltaTime;
+
+	EvaluateTime += DeltaTime;
+	if (EvaluateTime < EvaluateInterval)
+	{
+		return;
+	}
+	EvaluateTime = 0.0f;
+
+	if (ForcedLevel != INDEX_NONE)
+	{
+		SetLevel(ForcedLevel);
+		return;
+	}
+
+	static FCellSimulatedPowerProvider SimulatedProvider;
+	ICellPowerProvider* CurrentProvider = CVarPowerSimulate.GetValueOnGameThread() != 0 ? &SimulatedProvider : Provider.Get();
+
+	FCellPowerState State;
+	if (CurrentProvider == nullptr || !CurrentProvider->GetState(State))
+	{
+		return;
+	}
+
+	const int32 NewLevel = ComputeLevel(State);
+	if (NewLevel >= Level)
+	{
+		RecoverLevel = NewLevel;
+		RecoverTime = 0.0f;
+		SetLevel(NewLevel);
+		return;
+	}
+
+	// Save less only once the state held for a while, a device cooling down heats up again right away at full speed
+	if (NewLevel != RecoverLevel)
+	{
+		RecoverLevel = NewLevel;
+		RecoverTime = 0.0f;
+	}
+	RecoverTime += EvaluateInterval;
+	if (RecoverTime >= RecoverDelay)
+	{
+		SetLevel(NewLevel);
+	}
+}
+
+int32 UCellDemoPowerGovernor::ComputeLevel(const FCellPowerState& State) const
+{
+	int32 BatteryLevel = 0;
+	if (!State.bCharging)
+	{
+		for (float Threshold : BatteryThresholds)
+		{
+			BatteryLevel += State.BatteryLevel < Threshold ? 1 : 0;
+		}
+	}
+
+	int32 ThermalLevel = 0;
+	for (float Threshold : TemperatureThresholdsC)
+	{
+		ThermalLevel += State.TemperatureC > Threshold ? 1 : 0;
+	}
+
+	return FMath::Min(FMath::Max(BatteryLevel, ThermalLevel), Policies.Num() - 1);
+}
+
+void UCellDemoPowerGovernor::ForceLevel(int32 InLevel)
+{
+	ForcedLevel = InLevel >= 0 ? FMath::Min(InLevel, Policies.Num() - 1) : INDEX_NONE;
+	if (ForcedLevel != INDEX_NONE)
+	{
+		SetLevel(ForcedLevel);
+	}
+	else
+	{
+		EvaluateTime = EvaluateInterval;
+	}
+}
+
+void UCellDemoPowerGovernor::SetLevel(int32 NewLevel)
+{
+	if (NewLevel == Level)
+	{
+		return;
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Power: level %s -> %s"), *Policies[Level].Name, *Policies[NewLevel].Name);
+	Level = NewLevel;
+	ApplyPolicy();
+}
+
+float UCellDemoPowerGovernor::GetMaxFPS() const
+{
+	const float PolicyMaxFPS = GetPolicy().MaxFPS;
+	if (PolicyMaxFPS <= 0.0f)
+	{
+		return OriginalMaxFPS;
+	}
+	return OriginalMaxFPS > 0.0f ? FMath::Min(OriginalMaxFPS, PolicyMaxFPS) : PolicyMaxFPS;
+}
+
+int32 UCellDemoPowerGovernor::GetNetServerMaxTickRate(const UNetDriver* NetDriver) const
+{
+	const int32 DefaultTickRate = NetDriver->GetClass()->GetDefaultObject<UNetDriver>()->NetServerMaxTickRate;
+	const int32 PolicyTickRate = GetPolicy().ListenServerMaxTickRate;
+	return PolicyTickRate > 0 && NetDriver->GetNetMode() == NM_ListenServer ? FMath::Min(DefaultTickRate, PolicyTickRate) : DefaultTickRate;
+}
+
+void UCellDemoPowerGovernor::ApplyPolicy()
+{
+	// An idle hosted cell is throttled further, the tick governor applies the policy when it becomes active again
+	if (ACellDemoTickGovernor::IsThrottling())
+	{
+		return;
+	}
+
+	if (IConsoleVariable* MaxFPS = IConsoleManager::Get().FindConsoleVariable(TEXT("t.MaxFPS")))
+	{
+		MaxFPS->Set(GetMaxFPS(), ECVF_SetByCode);
+	}
+
+	UWorld* World = GameInstance != nullptr ? GameInstance->GetWorld() : nullptr;
+	if (UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr)
+	{
+		NetDriver->NetServerMaxTickRate = GetNetServerMaxTickRate(NetDriver);
+	}
+}
+
+void UCellDemoPowerGovernor::LogReport() const
+{
+	UE_LOG(LogCellDemo, Log, TEXT("Power: level %s, provider %s"), *GetPolicy().Name,
+		CVarPowerSimulate.GetValueOnGameThread() != 0 ? TEXT("Simulated") : (Provider.IsValid() ? Provider->GetName() : TEXT("None")));
+
+	// CPU time per second of every level, compared to the first one
+	const double BaseCpuMsPerSecond = LevelTime[0] > 0.0 ? LevelCpuMs[0] / LevelTime[0] : 0.0;
+	for (int32 Index = 0; Index < Policies.Num(); Index++)
+	{
+		if (LevelTime[Index] <= 0.0)
+		{
+			continue;
+		}
+
+		const double CpuMsPerSecond = LevelCpuMs[Index] / LevelTime[Index];
+		const double SavedPercent = BaseCpuMsPerSecond > 0.0 ? 100.0 * (BaseCpuMsPerSecond - CpuMsPerSecond) / BaseCpuMsPerSecond : 0.0;
+		UE_LOG(LogCellDemo, Log, TEXT("Power:   %s %.0f s, game thread %.1f ms/s, %.0f%% saved"),
+			*Policies[Index].Name, LevelTime[Index], CpuMsPerSecond, SavedPercent);
+	}
+}
+
+// *******************************
+// Console
+// *******************************
+
+static UCellDemoPowerGovernor* GetPowerGovernor(UWorld* World)
+{
+	UCellNWGameInstance* GameInstance = World != nullptr ? Cast<UCellNWGameInstance>(World->GetGameInstance()) : nullptr;
+	return GameInstance != nullptr ? GameInstance->PowerGovernor : nullptr;
+}
+
+static void PowerReportCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (UCellDemoPowerGovernor* PowerGovernor = GetPowerGovernor(World))
+	{
+		PowerGovernor->LogReport();
+	}
+}
+
+static void PowerForceLevelCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (UCellDemoPowerGovernor* PowerGovernor = GetPowerGovernor(World))
+	{
+		PowerGovernor->ForceLevel(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : INDEX_NONE);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs PowerReportCmd(
+	TEXT("CellDemo.Power.Report"),
+	TEXT("Logs the power level and the CPU time saved by every level"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(PowerReportCommand));
+
+static FAutoConsoleCommandWithWorldAndArgs PowerForceLevelCmd(
+	TEXT("CellDemo.Power.ForceLevel"),
+	TEXT("Forces a power level, -1 to go back to automatic. Usage: CellDemo.Power.ForceLevel <Level>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(PowerForceLevelCommand));
+
+// *******************************
+// Automation
+// *******************************
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+*	Drives the simulated provider across the battery and temperature thresholds of a governor set up here, and checks
+*	the level it computes and the policy the characters and the frame rate cap get from it
+*/
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCellPowerSimulatedTest, "CellDemo.Power.Simulated", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCellPowerSimulatedTest::RunTest(const FString& Parameters)
+{
+	IConsoleVariable* MaxFPS = IConsoleManager::Get().FindConsoleVariable(TEXT("t.MaxFPS"));
+	const float SavedMaxFPS = MaxFPS != nullptr ? MaxFPS->GetFloat() : 0.0f;
+	const int32 SavedSimulate = CVarPowerSimulate.GetValueOnGameThread();
+	const float SavedBattery = CVarPowerSimBattery.GetValueOnGameThread();
+	const int32 SavedCharging = CVarPowerSimCharging.GetValueOnGameThread();
+	const float SavedTemperature = CVarPowerSimTemperature.GetValueOnGameThread();
+
+	// Not the configured table, the test must not depend on the tuning
+	UCellDemoPowerGovernor* Governor = NewObject<UCellDemoPowerGovernor>();
+	Governor->Policies.Reset();
+	const TCHAR* Names[] = { TEXT("Normal"), TEXT("Saver"), TEXT("Low"), TEXT("Critical") };
+	for (int32 Index = 0; Index < ARRAY_COUNT(Names); Index++)
+	{
+		FCellPowerPolicy& Policy = Governor->Policies[Governor->Policies.AddDefaulted()];
+		Policy.Name = Names[Index];
+		Policy.MaxFPS = Index > 0 ? 60.0f - Index * 10.0f : 0.0f;
+		Policy.CursorTraceInterval = Index * 0.05f;
+		Policy.NetUpdateFrequencyScale = 1.0f - Index * 0.2f;
+	}
+	Governor->BatteryThresholds = { 0.5f, 0.25f, 0.1f };
+	Governor->TemperatureThresholdsC = { 38.0f, 42.0f, 46.0f };
+	Governor->EvaluateInterval = 1.0f;
+	Governor->RecoverDelay = 3.0f;
+	Governor->Initialize(nullptr);
+
+	CVarPowerSimulate->Set(1, ECVF_SetByCode);
+
+	// Sets the simulated state and runs one evaluation, then checks the level and what it applies
+	auto Evaluate = [this, Governor, MaxFPS](const TCHAR* What, float BatteryPercent, bool bCharging, float TemperatureC, int32 ExpectedLevel)
+	{
+		CVarPowerSimBattery->Set(BatteryPercent, ECVF_SetByCode);
+		CVarPowerSimCharging->Set(bCharging ? 1 : 0, ECVF_SetByCode);
+		CVarPowerSimTemperature->Set(TemperatureC, ECVF_SetByCode);
+		Governor->Tick(Governor->EvaluateInterval);
+
+		const FCellPowerPolicy& Expected = Governor->Policies[ExpectedLevel];
+		TestEqual(*FString::Printf(TEXT("%s: level"), What), Governor->GetLevel(), ExpectedLevel);
+		TestEqual(*FString::Printf(TEXT("%s: cursor trace interval"), What), Governor->GetCursorTraceInterval(), Expected.CursorTraceInterval);
+		TestEqual(*FString::Printf(TEXT("%s: net update frequency scale"), What), Governor->GetNetUpdateFrequencyScale(), Expected.NetUpdateFrequencyScale);
+		if (MaxFPS != nullptr && !ACellDemoTickGovernor::IsThrottling())
+		{
+			TestEqual(*FString::Printf(TEXT("%s: t.MaxFPS"), What), MaxFPS->GetFloat(), Governor->GetMaxFPS());
+		}
+	};
+
+	Evaluate(TEXT("Full battery"), 100.0f, false, 30.0f, 0);
+	Evaluate(TEXT("Below the first battery threshold"), 40.0f, false, 30.0f, 1);
+	Evaluate(TEXT("Above the second temperature threshold"), 40.0f, false, 43.0f, 2);
+	Evaluate(TEXT("Below the last battery threshold"), 5.0f, false, 30.0f, 3);
+	Evaluate(TEXT("Every threshold crossed"), 5.0f, false, 50.0f, 3);
+
+	// Charging ignores the battery, and a less saving level waits for RecoverDelay
+	Evaluate(TEXT("Charging, first evaluation"), 5.0f, true, 30.0f, 3);
+	Evaluate(TEXT("Charging, second evaluation"), 5.0f, true, 30.0f, 3);
+	Evaluate(TEXT("Charging, after the recover delay"), 5.0f, true, 30.0f, 0);
+
+	CVarPowerSimulate->Set(SavedSimulate, ECVF_SetByCode);
+	CVarPowerSimBattery->Set(SavedBattery, ECVF_SetByCode);
+	CVarPowerSimCharging->Set(SavedCharging, ECVF_SetByCode);
+	CVarPowerSimTemperature->Set(SavedTemperature, ECVF_SetByCode);
+	if (MaxFPS != nullptr)
+	{
+		MaxFPS->Set(SavedMaxFPS, ECVF_SetByCode);
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
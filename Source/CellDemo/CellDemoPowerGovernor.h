@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Tickable.h"
+#include "CellDemoPowerGovernor.generated.h"
+
+/** Battery and thermal state of the device */
+struct FCellPowerState
+{
+	/** 0 to 1 */
+	float BatteryLevel;
+	bool bCharging;
+
+	/** Battery temperature in Celsius, 0 if unknown */
+	float TemperatureC;
+
+	FCellPowerState()
+		: BatteryLevel(1.0f)
+		, bCharging(true)
+		, TemperatureC(0.0f)
+	{
+	}
+};
+
+/** Where the power state comes from */
+class ICellPowerProvider
+{
+public:
+	virtual ~ICellPowerProvider() {}
+
+	/** Returns false when the state is unknown */
+	virtual bool GetState(FCellPowerState& OutState) = 0;
+	virtual const TCHAR* GetName() const = 0;
+};
+
+/** Battery of the device, as the platform reports it */
+class FCellDevicePowerProvider : public ICellPowerProvider
+{
+public:
+	virtual bool GetState(FCellPowerState& OutState) override;
+	virtual const TCHAR* GetName() const override { return TEXT("Device"); }
+};
+
+/** Driven by the CellDemo.Power.Sim* console variables, to test the policies on any platform */
+class FCellSimulatedPowerProvider : public ICellPowerProvider
+{
+public:
+	virtual bool GetState(FCellPowerState& OutState) override;
+	virtual const TCHAR* GetName() const override { return TEXT("Simulated"); }
+};
+
+/** What a power level scales down */
+USTRUCT()
+struct FCellPowerPolicy
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FString Name;
+
+	/** Frame rate cap, 0 for no cap */
+	UPROPERTY()
+	float MaxFPS;
+
+	/** Time between two cursor traces of the characters, 0 for every frame */
+	UPROPERTY()
+	float CursorTraceInterval;
+
+	/** Scale of the net update frequency of the characters hosted on this device */
+	UPROPERTY()
+	float NetUpdateFrequencyScale;
+
+	/** Net tick rate cap of a listen server, 0 for no cap */
+	UPROPERTY()
+	int32 ListenServerMaxTickRate;
+
+	FCellPowerPolicy()
+		: MaxFPS(0.0f)
+		, CursorTraceInterval(0.0f)
+		, NetUpdateFrequencyScale(1.0f)
+		, ListenServerMaxTickRate(0)
+	{
+	}
+};
+
+/**
+*	Scales the frame rate, the cursor traces, the net update frequency and the listen server tick down when the battery
+*	runs low or the device heats up.
+*
+*	The power level is the number of battery or temperature thresholds crossed, the worst of the two, and indexes the
+*	Policies table. Going back to a less saving level waits for RecoverDelay so the device cools down for real.
+*	The game thread time is accounted per level, the report gives the CPU time saved by every level over the first one.
+*
+*	The device provider is used unless -CellPowerSim is on the command line or CellDemo.Power.Simulate is set.
+*	Console: CellDemo.Power.Report, CellDemo.Power.ForceLevel <Level>|-1
+*/
+UCLASS(config = Game)
+class UCellDemoPowerGovernor : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoPowerGovernor();
+
+	/** From the least to the most saving */
+	UPROPERTY(config)
+	TArray<FCellPowerPolicy> Policies;
+
+	/** Battery levels below which one more level is saved, from the highest */
+	UPROPERTY(config)
+	TArray<float> BatteryThresholds;
+
+	/** Temperatures above which one more level is saved, from the lowest */
+	UPROPERTY(config)
+	TArray<float> TemperatureThresholdsC;
+
+	/** Time between two reads of the power state, in seconds */
+	UPROPERTY(config)
+	float EvaluateInterval;
+
+	/** Time a less saving level must hold before being applied, in seconds */
+	UPROPERTY(config)
+	float RecoverDelay;
+
+	void Initialize(class UCellNWGameInstance* InGameInstance);
+
+	void SetProvider(TSharedPtr<ICellPowerProvider> InProvider);
+
+	int32 GetLevel() const { return Level; }
+	const FCellPowerPolicy& GetPolicy() const;
+
+	/** Forces a level whatever the power state, -1 to go back to automatic */
+	void ForceLevel(int32 InLevel);
+
+	/** Time between two cursor traces of the characters (0 for every frame), and scale of their net update frequency */
+	float GetCursorTraceInterval() const { return GetPolicy().CursorTraceInterval; }
+	float GetNetUpdateFrequencyScale() const { return GetPolicy().NetUpdateFrequencyScale; }
+
+	/** Frame rate cap and listen server tick rate of the current policy, applied over the engine defaults */
+	float GetMaxFPS() const;
+	int32 GetNetServerMaxTickRate(const class UNetDriver* NetDriver) const;
+
+	/** Applies the current policy again, after a travel or when a throttle ends */
+	void ApplyPolicy();
+
+	void LogReport() const;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+protected:
+	UPROPERTY(Transient)
+	class UCellNWGameInstance* GameInstance;
+
+	TSharedPtr<ICellPowerProvider> Provider;
+
+	int32 Level;
+	int32 ForcedLevel;
+	float EvaluateTime;
+
+	/** Less saving level waiting for RecoverDelay */
+	int32 RecoverLevel;
+	float RecoverTime;
+
+	/** t.MaxFPS before the governor touched it */
+	float OriginalMaxFPS;
+
+	/** Game thread time and wall time spent at every level */
+	TArray<double> LevelCpuMs;
+	TArray<double> LevelTime;
+
+	int32 ComputeLevel(const FCellPowerState& State) const;
+	void SetLevel(int32 NewLevel);
+};
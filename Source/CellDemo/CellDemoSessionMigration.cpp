@@ -0,0 +1,573 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoSessionMigration.h"
+#include "CellDemo.h"
+#include "CellDemoPlayerController.h"
+#include "CellNWGameInstance.h"
+#include "Engine/NetDriver.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Online.h"
+
+// *******************************
+// Snapshot
+// *******************************
+
+bool FCellMigrationSnapshot::SaveToFile(const FString& FilePath)
+{
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FilePath));
+	if (!Writer.IsValid())
+	{
+		return false;
+	}
+
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	*Writer << FileMagic << FileVersion << MapName << SessionId << MaxPlayers << bIsLAN << bIsPresence << Players << Actors;
+	return Writer->Close();
+}
+
+bool FCellMigrationSnapshot::LoadFromFile(const FString& FilePath)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePath));
+	if (!Reader.IsValid())
+	{
+		return false;
+	}
+
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	*Reader << FileMagic << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	*Reader << MapName << SessionId << MaxPlayers << bIsLAN << bIsPresence << Players << Actors;
+	return !Reader->IsError();
+}
+
+FString FCellMigrationSnapshot::GetPlayerId(const APlayerState* PlayerState)
+{
+	if (PlayerState == nullptr)
+	{
+		return FString();
+	}
+	return PlayerState->UniqueId.IsValid() ? PlayerState->UniqueId->ToString() : PlayerState->PlayerName;
+}
+
+// *******************************
+// Migration
+// *******************************
+
+static IOnlineSessionPtr GetSessionInterface()
+{
+	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
+	return OnlineSub != nullptr ? OnlineSub->GetSessionInterface() : nullptr;
+}
+
+UCellDemoSessionMigration::UCellDemoSessionMigration()
+{
+	TargetPort = 7810;
+	TargetTimeout = 60.0f;
+	RedirectTimeout = 5.0f;
+
+	SnapshotMs = 0.0f;
+	TargetStartMs = 0.0f;
+	RedirectMs = 0.0f;
+	PauseMs = 0.0f;
+
+	GameInstance = nullptr;
+	Stage = EStage::Idle;
+	StageStartTime = 0.0;
+	Port = 0;
+	NumPlayersBack = 0;
+}
+
+void UCellDemoSessionMigration::Initialize(UCellNWGameInstance* InGameInstance)
+{
+	GameInstance = InGameInstance;
+}
+
+FString UCellDemoSessionMigration::GetMigrationDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Migration");
+}
+
+FString UCellDemoSessionMigration::GetReadyPath() const
+{
+	return GetMigrationDir() / Snapshot.SessionId + TEXT(".ready");
+}
+
+FString UCellDemoSessionMigration::GetFinalPath() const
+{
+	return GetMigrationDir() / Snapshot.SessionId + TEXT(".final.cellmig");
+}
+
+FString UCellDemoSessionMigration::GetAppliedPath() const
+{
+	return GetMigrationDir() / Snapshot.SessionId + TEXT(".applied");
+}
+
+void UCellDemoSessionMigration::SetStage(EStage NewStage)
+{
+	Stage = NewStage;
+	StageStartTime = FPlatformTime::Seconds();
+}
+
+bool UCellDemoSessionMigration::IsTickable() const
+{
+	return Stage != EStage::Idle && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+bool UCellDemoSessionMigration::IsTickableWhenPaused() const
+{
+	// The source pauses the cell while the target applies the final snapshot
+	return true;
+}
+
+TStatId UCellDemoSessionMigration::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellDemoSessionMigration, STATGROUP_Tickables);
+}
+
+bool UCellDemoSessionMigration::StartMigration(int32 InPort)
+{
+	UWorld* World = GameInstance != nullptr ? GameInstance->GetWorld() : nullptr;
+	if (Stage != EStage::Idle || World == nullptr || World->GetNetMode() != NM_ListenServer)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Migration: only a cell hosted by this process can be migrated"));
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	if (!CaptureSnapshot(World))
+	{
+		return false;
+	}
+
+	SnapshotPath = GetMigrationDir() / Snapshot.SessionId + TEXT(".cellmig");
+	IFileManager::Get().Delete(*GetReadyPath(), false, true, true);
+	IFileManager::Get().Delete(*GetFinalPath(), false, true, true);
+	IFileManager::Get().Delete(*GetAppliedPath(), false, true, true);
+	if (!Snapshot.SaveToFile(SnapshotPath))
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Migration: could not write %s"), *SnapshotPath);
+		return false;
+	}
+	SnapshotMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	Port = InPort > 0 ? InPort : TargetPort;
+	FString Arguments = FString::Printf(TEXT("-CellRestore=\"%s\" -port=%d %s"), *FPaths::ConvertRelativePathToFull(SnapshotPath), Port, *TargetArguments);
+
+	// An uncooked game runs from the editor executable, which needs the project
+	if (!FPlatformProperties::RequiresCookedData())
+	{
+		Arguments = FString::Printf(TEXT("\"%s\" -game %s"), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *Arguments);
+	}
+
+	const FString ExecutablePath = FPaths::ConvertRelativePathToFull(FString(FPlatformProcess::BaseDir()) / FPlatformProcess::ExecutableName(false));
+	TargetProcess = FPlatformProcess::CreateProc(*ExecutablePath, *Arguments, true, false, false, nullptr, 0, nullptr, nullptr);
+	if (!TargetProcess.IsValid())
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Migration: could not start %s"), *ExecutablePath);
+		return false;
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: %d players and %d actors of %s saved in %.1f ms, starting the target on port %d"),
+		Snapshot.Players.Num(), Snapshot.Actors.Num(), *Snapshot.SessionId, SnapshotMs, Port);
+
+	SetStage(EStage::WaitingForTarget);
+	return true;
+}
+
+bool UCellDemoSessionMigration::CaptureSnapshot(UWorld* World)
+{
+	IOnlineSessionPtr Sessions = GetSessionInterface();
+	FNamedOnlineSession* Session = Sessions.IsValid() ? Sessions->GetNamedSession(GameSessionName) : nullptr;
+	if (Session == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Migration: the cell has no session"));
+		return false;
+	}
+
+	Snapshot = FCellMigrationSnapshot();
+	Session->SessionSettings.Get(SETTING_MAPNAME, Snapshot.MapName);
+	Session->SessionSettings.Get(FName(TEXT("SessionId")), Snapshot.SessionId);
+	Snapshot.MaxPlayers = Session->SessionSettings.NumPublicConnections;
+	Snapshot.bIsLAN = Session->SessionSettings.bIsLANMatch;
+	Snapshot.bIsPresence = Session->SessionSettings.bUsesPresence;
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* Controller = It->Get();
+		const APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+		if (Pawn == nullptr || Controller->PlayerState == nullptr || Controller->PlayerState->bIsABot)
+		{
+			continue;
+		}
+
+		FCellMigrationSnapshot::FPlayer& Player = Snapshot.Players[Snapshot.Players.AddDefaulted()];
+		Player.Id = FCellMigrationSnapshot::GetPlayerId(Controller->PlayerState);
+		Player.Location = Pawn->GetActorLocation();
+		Player.Rotation = Pawn->GetActorRotation();
+	}
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		if (MigratedClassNames.Contains(It->GetClass()->GetName()))
+		{
+			FCellMigrationSnapshot::FActor& Actor = Snapshot.Actors[Snapshot.Actors.AddDefaulted()];
+			Actor.ClassPath = It->GetClass()->GetPathName();
+			Actor.Transform = It->GetActorTransform();
+		}
+	}
+
+	return true;
+}
+
+void UCellDemoSessionMigration::SetPaused(UWorld* World, bool bPaused)
+{
+	AGameModeBase* GameMode = World != nullptr ? World->GetAuthGameMode() : nullptr;
+	if (GameMode == nullptr)
+	{
+		return;
+	}
+
+	if (bPaused)
+	{
+		GameMode->SetPause(World->GetFirstPlayerController());
+	}
+	else
+	{
+		GameMode->ClearPause();
+	}
+}
+
+void UCellDemoSessionMigration::SendFinalSnapshot(UWorld* World)
+{
+	// The cell played on while the target booted, nothing may change between this snapshot and the redirect
+	SetPaused(World, true);
+
+	const double StartTime = FPlatformTime::Seconds();
+	if (!CaptureSnapshot(World) || !Snapshot.SaveToFile(GetFinalPath()))
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("Migration: could not write the final snapshot, keeping the cell here"));
+		SetPaused(World, false);
+		FPlatformProcess::TerminateProc(TargetProcess);
+		SetStage(EStage::Idle);
+		return;
+	}
+	SnapshotMs += (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	SetStage(EStage::WaitingForApply);
+}
+
+void UCellDemoSessionMigration::Redirect(UWorld* World)
+{
+	int32 NumRedirected = 0;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		ACellDemoPlayerController* Controller = Cast<ACellDemoPlayerController>(It->Get());
+		if (Controller != nullptr && !Controller->IsLocalController())
+		{
+			Controller->ClientMigrate(Port);
+			NumRedirected++;
+		}
+	}
+
+	// The target advertises the session now, drop ours without the callbacks of a hang up
+	GameInstance->ProbeResponder.Stop();
+	IOnlineSessionPtr Sessions = GetSessionInterface();
+	if (Sessions.IsValid())
+	{
+		Sessions->DestroySession(GameSessionName);
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: target ready after %.0f ms, %d clients redirected"), TargetStartMs, NumRedirected);
+	SetStage(EStage::Redirecting);
+}
+
+void UCellDemoSessionMigration::FollowMigration(const FString& Address)
+{
+	APlayerController* LocalController = GameInstance != nullptr ? GameInstance->GetFirstLocalPlayerController() : nullptr;
+	if (LocalController == nullptr)
+	{
+		return;
+	}
+
+	// The initial sync on the new host measures its join from here too
+	GameInstance->JoinTravelStartTime = FPlatformTime::Seconds();
+	SetStage(EStage::Following);
+
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: following the cell to %s"), *Address);
+	LocalController->ClientTravel(Address, ETravelType::TRAVEL_Absolute);
+}
+
+void UCellDemoSessionMigration::NotifyPlayable()
+{
+	if (Stage != EStage::Following)
+	{
+		return;
+	}
+
+	PauseMs = (FPlatformTime::Seconds() - StageStartTime) * 1000.0;
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: playable again after a %.0f ms pause"), PauseMs);
+	SetStage(EStage::Idle);
+}
+
+void UCellDemoSessionMigration::StartRestore(const FString& InSnapshotPath)
+{
+	SnapshotPath = InSnapshotPath;
+	if (!Snapshot.LoadFromFile(SnapshotPath))
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("Migration: could not load %s"), *SnapshotPath);
+		return;
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: restoring %s on %s, %d players and %d actors"),
+		*Snapshot.SessionId, *Snapshot.MapName, Snapshot.Players.Num(), Snapshot.Actors.Num());
+	SetStage(EStage::WaitingForPlayer);
+}
+
+void UCellDemoSessionMigration::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (Stage == EStage::WaitingForPlayer)
+	{
+		// Host the session the same way the phone does, it opens the map as a listen server
+		ULocalPlayer* const Player = GameInstance->GetFirstGamePlayer();
+		if (Player == nullptr || !GameInstance->HostSession(Player->GetPreferredUniqueNetId(), Snapshot.MapName, Snapshot.SessionId,
+			GameSessionName, Snapshot.bIsLAN, Snapshot.bIsPresence, Snapshot.MaxPlayers))
+		{
+			UE_LOG(LogCellDemo, Error, TEXT("Migration: could not host %s"), *Snapshot.SessionId);
+			SetStage(EStage::Idle);
+			return;
+		}
+		SetStage(EStage::Hosting);
+	}
+	else if (Stage == EStage::Hosting && LoadedWorld != nullptr && LoadedWorld->GetNetMode() == NM_ListenServer)
+	{
+		// The port the net driver bound, the one asked for on the command line may have been taken
+		const UNetDriver* NetDriver = LoadedWorld->GetNetDriver();
+		const int32 HostedPort = NetDriver != nullptr && NetDriver->LocalAddr.IsValid() ? NetDriver->LocalAddr->GetPort() : LoadedWorld->URL.Port;
+
+		// The source sends its final snapshot once this file exists
+		FFileHelper::SaveStringToFile(FString::FromInt(HostedPort), *GetReadyPath());
+		UE_LOG(LogCellDemo, Log, TEXT("Migration: %s hosted on port %d"), *Snapshot.SessionId, HostedPort);
+		SetStage(EStage::WaitingForFinal);
+	}
+}
+
+void UCellDemoSessionMigration::ApplyFinalSnapshot(UWorld* World)
+{
+	if (!Snapshot.LoadFromFile(GetFinalPath()))
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("Migration: could not load %s"), *GetFinalPath());
+		SetStage(EStage::Idle);
+		return;
+	}
+
+	RestoreActors(World);
+
+	// The source redirects its clients once this file exists
+	NumPlayersBack = 0;
+	FFileHelper::SaveStringToFile(TEXT("1"), *GetAppliedPath());
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: final snapshot of %s applied, %d players and %d actors"), *Snapshot.SessionId, Snapshot.Players.Num(), Snapshot.Actors.Num());
+	SetStage(EStage::PlacingPlayers);
+}
+
+void UCellDemoSessionMigration::RestoreActors(UWorld* World)
+{
+	// Actors placed in the map and still in the snapshot are kept, so the navmesh only changes where the cell did
+	TArray<FCellMigrationSnapshot::FActor> Missing = Snapshot.Actors;
+	int32 NumRemoved = 0;
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		if (!MigratedClassNames.Contains(It->GetClass()->GetName()))
+		{
+			continue;
+		}
+
+		const FString ClassPath = It->GetClass()->GetPathName();
+		const FVector Location = It->GetActorLocation();
+		const int32 Index = Missing.IndexOfByPredicate([&ClassPath, &Location](const FCellMigrationSnapshot::FActor& Actor)
+		{
+			return Actor.ClassPath == ClassPath && Actor.Transform.GetLocation().Equals(Location, 1.0f);
+		});
+
+		if (Index != INDEX_NONE)
+		{
+			Missing.RemoveAtSwap(Index);
+		}
+		else
+		{
+			It->Destroy();
+			NumRemoved++;
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	for (const FCellMigrationSnapshot::FActor& Actor : Missing)
+	{
+		if (UClass* Class = LoadObject<UClass>(nullptr, *Actor.ClassPath))
+		{
+			World->SpawnActor<AActor>(Class, Actor.Transform, SpawnParams);
+		}
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Migration: %d placed actors removed, %d spawned"), NumRemoved, Missing.Num());
+}
+
+void UCellDemoSessionMigration::PlacePlayers(UWorld* World)
+{
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* Controller = It->Get();
+		APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+		if (Pawn == nullptr)
+		{
+			continue;
+		}
+
+		if (Controller->IsLocalController())
+		{
+			Pawn->Destroy();
+			continue;
+		}
+
+		const FString Id = FCellMigrationSnapshot::GetPlayerId(Controller->PlayerState);
+		const int32 Index = Snapshot.Players.IndexOfByPredicate([&Id](const FCellMigrationSnapshot::FPlayer& Player) { return Player.Id == Id; });
+		if (Index != INDEX_NONE)
+		{
+			Pawn->SetActorLocationAndRotation(Snapshot.Players[Index].Location, Snapshot.Players[Index].Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+			Snapshot.Players.RemoveAtSwap(Index);
+			NumPlayersBack++;
+
+			UE_LOG(LogCellDemo, Log, TEXT("Migration: %s back %.0f ms after the target was ready"), *Id, (FPlatformTime::Seconds() - StageStartTime) * 1000.0);
+		}
+	}
+}
+
+void UCellDemoSessionMigration::Tick(float DeltaTime)
+{
+	const double StageTime = FPlatformTime::Seconds() - StageStartTime;
+	UWorld* World = GameInstance != nullptr ? GameInstance->GetWorld() : nullptr;
+
+	switch (Stage)
+	{
+	case EStage::WaitingForTarget:
+		if (FPaths::FileExists(GetReadyPath()))
+		{
+			// The target may not have got the port it was asked for, the ready file has the one it listens on
+			FString ReadyPort;
+			const int32 HostedPort = FFileHelper::LoadFileToString(ReadyPort, *GetReadyPath()) ? FCString::Atoi(*ReadyPort) : 0;
+			if (HostedPort > 0)
+			{
+				if (HostedPort != Port)
+				{
+					UE_LOG(LogCellDemo, Log, TEXT("Migration: target asked for port %d, listening on %d"), Port, HostedPort);
+					Port = HostedPort;
+				}
+				TargetStartMs = StageTime * 1000.0;
+				SendFinalSnapshot(World);
+			}
+		}
+		else if (StageTime > TargetTimeout || !FPlatformProcess::IsProcRunning(TargetProcess))
+		{
+			UE_LOG(LogCellDemo, Warning, TEXT("Migration: the target did not host the cell, keeping it here"));
+			FPlatformProcess::TerminateProc(TargetProcess);
+			SetStage(EStage::Idle);
+		}
+		break;
+
+	case EStage::WaitingForApply:
+		if (FPaths::FileExists(GetAppliedPath()))
+		{
+			Redirect(World);
+		}
+		else if (StageTime > TargetTimeout || !FPlatformProcess::IsProcRunning(TargetProcess))
+		{
+			UE_LOG(LogCellDemo, Warning, TEXT("Migration: the target did not apply the final snapshot, keeping the cell here"));
+			SetPaused(World, false);
+			FPlatformProcess::TerminateProc(TargetProcess);
+			SetStage(EStage::Idle);
+		}
+		break;
+
+	case EStage::Redirecting:
+	{
+		// The clients close their connection when they travel
+		const UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+		if (NetDriver == nullptr || NetDriver->ClientConnections.Num() == 0 || StageTime > RedirectTimeout)
+		{
+			RedirectMs = StageTime * 1000.0;
+			UE_LOG(LogCellDemo, Log, TEXT("Migration: snapshot %.1f ms | target start %.0f ms | clients gone after %.0f ms"), SnapshotMs, TargetStartMs, RedirectMs);
+
+			FPlatformProcess::CloseProc(TargetProcess);
+			FollowMigration(FString::Printf(TEXT("127.0.0.1:%d"), Port));
+		}
+		break;
+	}
+
+	case EStage::Following:
+		if (StageTime > TargetTimeout)
+		{
+			UE_LOG(LogCellDemo, Warning, TEXT("Migration: not playable on the new host after %.0f s"), StageTime);
+			SetStage(EStage::Idle);
+		}
+		break;
+
+	case EStage::WaitingForFinal:
+		if (FPaths::FileExists(GetFinalPath()) && World != nullptr)
+		{
+			ApplyFinalSnapshot(World);
+		}
+		else if (StageTime > TargetTimeout)
+		{
+			UE_LOG(LogCellDemo, Warning, TEXT("Migration: no final snapshot from the source after %.0f s"), StageTime);
+			SetStage(EStage::Idle);
+		}
+		break;
+
+	case EStage::PlacingPlayers:
+		if (World != nullptr)
+		{
+			PlacePlayers(World);
+		}
+		if (Snapshot.Players.Num() == 0 || StageTime > TargetTimeout)
+		{
+			UE_LOG(LogCellDemo, Log, TEXT("Migration: %d players back, %d missing, after %.0f ms"), NumPlayersBack, Snapshot.Players.Num(), StageTime * 1000.0);
+			IFileManager::Get().Delete(*GetReadyPath(), false, true, true);
+			IFileManager::Get().Delete(*GetFinalPath(), false, true, true);
+			IFileManager::Get().Delete(*GetAppliedPath(), false, true, true);
+			SetStage(EStage::Idle);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+// *******************************
+// Console
+// *******************************
+
+static void MigrateCommand(const TArray<FString>& Args, UWorld* World)
+{
+	UCellNWGameInstance* GameInstance = World != nullptr ? Cast<UCellNWGameInstance>(World->GetGameInstance()) : nullptr;
+	if (GameInstance != nullptr && GameInstance->SessionMigration != nullptr)
+	{
+		GameInstance->SessionMigration->StartMigration(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs MigrateCmd(
+	TEXT("CellDemo.Migrate"),
+	TEXT("Moves the hosted cell to a new server process, the players follow it. Usage: CellDemo.Migrate [Port]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(MigrateCommand));
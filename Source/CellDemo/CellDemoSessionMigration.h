@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "HAL/PlatformProcess.h"
+#include "Tickable.h"
+#include "CellDemoSessionMigration.generated.h"
+
+/** State of a hosted cell, enough to host it again in another process */
+struct FCellMigrationSnapshot
+{
+	static const uint32 Magic = 0x47494D43; // 'CMIG'
+	static const uint32 Version = 1;
+
+	struct FPlayer
+	{
+		/** Unique net id of the player, its name when it has none */
+		FString Id;
+		FVector Location;
+		FRotator Rotation;
+
+		friend FArchive& operator<<(FArchive& Ar, FPlayer& Player)
+		{
+			return Ar << Player.Id << Player.Location << Player.Rotation;
+		}
+	};
+
+	struct FActor
+	{
+		FString ClassPath;
+		FTransform Transform;
+
+		friend FArchive& operator<<(FArchive& Ar, FActor& Actor)
+		{
+			return Ar << Actor.ClassPath << Actor.Transform;
+		}
+	};
+
+	FString MapName;
+	FString SessionId;
+	int32 MaxPlayers;
+	bool bIsLAN;
+	bool bIsPresence;
+	TArray<FPlayer> Players;
+	TArray<FActor> Actors;
+
+	FCellMigrationSnapshot()
+		: MaxPlayers(0)
+		, bIsLAN(true)
+		, bIsPresence(true)
+	{
+	}
+
+	bool SaveToFile(const FString& FilePath);
+	bool LoadFromFile(const FString& FilePath);
+
+	/** Key of a player in Players */
+	static FString GetPlayerId(const class APlayerState* PlayerState);
+};
+
+/**
+*	Moves a hosted cell to another server process on the same machine, without the players hanging up.
+*
+*	Source, the process hosting the cell:
+*		the session settings, the characters of the players and the actors of MigratedClassNames (the blocks) are
+*		written to Saved/Migration/<SessionId>.cellmig, and a new process is started with -CellRestore=<File> -port=<Port>.
+*		The cell keeps playing while the target boots. Once the target is ready, the game is paused and a final snapshot
+*		is written to <SessionId>.final.cellmig. Once the target applied it, every client is told to travel to the new
+*		port (ClientMigrate), the session is dropped and the local player travels last.
+*	Target, the process started with -CellRestore:
+*		hosts the same SessionId on the same map through HostSession and writes the port it listens on to
+*		<SessionId>.ready. It then applies the final snapshot: the placed blocks removed from the cell are destroyed and
+*		the others spawned, and every character is put back where it was when its player reconnects.
+*		Its own local player gets no character, nobody holds that phone.
+*	Clients:
+*		travel straight to the new host, no session search, and measure the pause from the redirect to playable.
+*
+*	If the target does not get ready or apply the final snapshot within TargetTimeout, the source keeps hosting
+*	and nobody is redirected.
+*	Console: CellDemo.Migrate [Port]
+*/
+UCLASS(config = Game)
+class UCellDemoSessionMigration : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoSessionMigration();
+
+	/** Classes of the actors saved with the cell, by name */
+	UPROPERTY(config)
+	TArray<FString> MigratedClassNames;
+
+	/** Listen port of the target process when none is given, outside the ports of the host probe responder (7787 to 7802) */
+	UPROPERTY(config)
+	int32 TargetPort;
+
+	/** Extra command line of the target process */
+	UPROPERTY(config)
+	FString TargetArguments;
+
+	/** Time the target has to host the cell, and the players to come back, in seconds */
+	UPROPERTY(config)
+	float TargetTimeout;
+
+	/** Time the clients have to leave before the local player follows them, in seconds */
+	UPROPERTY(config)
+	float RedirectTimeout;
+
+	void Initialize(class UCellNWGameInstance* InGameInstance);
+
+	/** Source side, returns false if there is no hosted cell to migrate */
+	bool StartMigration(int32 InPort);
+
+	/** Target side, hosts the snapshot once the first map is loaded */
+	void StartRestore(const FString& InSnapshotPath);
+
+	/** Client side, travels to the new host of the cell */
+	void FollowMigration(const FString& Address);
+
+	/** Client side, the cell is playable again on the new host */
+	void NotifyPlayable();
+
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	bool IsMigrating() const { return Stage != EStage::Idle; }
+
+	/** Last measures, in milliseconds */
+	float SnapshotMs;
+	float TargetStartMs;
+	float RedirectMs;
+	float PauseMs;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual bool IsTickableWhenPaused() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+protected:
+	enum class EStage : uint8
+	{
+		Idle,
+		/** Source */
+		WaitingForTarget,
+		WaitingForApply,
+		Redirecting,
+		/** Client */
+		Following,
+		/** Target */
+		WaitingForPlayer,
+		Hosting,
+		WaitingForFinal,
+		PlacingPlayers
+	};
+
+	UPROPERTY(Transient)
+	class UCellNWGameInstance* GameInstance;
+
+	EStage Stage;
+	double StageStartTime;
+
+	FCellMigrationSnapshot Snapshot;
+	FString SnapshotPath;
+	int32 Port;
+	FProcHandle TargetProcess;
+
+	/** Target side, players of the snapshot back in the cell */
+	int32 NumPlayersBack;
+
+	static FString GetMigrationDir();
+	FString GetReadyPath() const;
+	FString GetFinalPath() const;
+	FString GetAppliedPath() const;
+
+	bool CaptureSnapshot(UWorld* World);
+	void SendFinalSnapshot(UWorld* World);
+	void ApplyFinalSnapshot(UWorld* World);
+	void SetPaused(UWorld* World, bool bPaused);
+	void RestoreActors(UWorld* World);
+	void Redirect(UWorld* World);
+	void PlacePlayers(UWorld* World);
+	void SetStage(EStage NewStage);
+};
@@ -0,0 +1,303 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoSoakTest.h"
+#include "CellDemo.h"
+#include "CellNWGameInstance.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/PackageName.h"
+#include "UObject/UObjectIterator.h"
+
+UCellDemoSoakTest::UCellDemoSoakTest()
+{
+	MapName = TEXT("/Game/Levels/World-01");
+	StayTime = 2.0f;
+	StageTimeout = 30.0f;
+	WarmupCycles = 20;
+	MaxObjectGrowthPerCycle = 1.0f;
+	MaxMemoryGrowthKBPerCycle = 64.0f;
+
+	GameInstance = nullptr;
+	Stage = EStage::Idle;
+	bJoinRole = false;
+	NumCycles = 0;
+	Cycle = 0;
+	NumStuckStages = 0;
+	StageStartTime = 0.0;
+	CycleStartTime = 0.0;
+	bMapLoaded = false;
+}
+
+void UCellDemoSoakTest::Start(UCellNWGameInstance* InGameInstance, int32 InNumCycles)
+{
+	GameInstance = InGameInstance;
+	NumCycles = InNumCycles;
+	Cycle = 0;
+	NumStuckStages = 0;
+	Samples.Reset();
+	WarmupObjectCounts.Reset();
+
+	FString Role;
+	FParse::Value(FCommandLine::Get(), TEXT("CellSoakRole="), Role);
+	bJoinRole = Role == TEXT("Join");
+
+	SessionId = TEXT("CellSoak");
+	FParse::Value(FCommandLine::Get(), TEXT("CellSoakSessionId="), SessionId);
+
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UCellDemoSoakTest::OnPostLoadMap);
+
+	UE_LOG(LogCellDemo, Log, TEXT("CellSoak: %d %s cycles on session %s"), NumCycles, bJoinRole ? TEXT("join") : TEXT("host"), *SessionId);
+	BeginCycle();
+}
+
+bool UCellDemoSoakTest::IsTickable() const
+{
+	return Stage != EStage::Idle && Stage != EStage::Done && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UCellDemoSoakTest::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellDemoSoakTest, STATGROUP_Tickables);
+}
+
+void UCellDemoSoakTest::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (LoadedWorld == nullptr)
+	{
+		return;
+	}
+
+	switch (Stage)
+	{
+	case EStage::Entering:
+		// Only the session map, a failed travel falls back to the default map
+		if (bJoinRole ? LoadedWorld->GetNetMode() == NM_Client
+			: LoadedWorld->GetNetMode() == NM_ListenServer && LoadedWorld->GetMapName() == FPackageName::GetShortName(MapName))
+		{
+			bMapLoaded = true;
+		}
+		break;
+
+	case EStage::Leaving:
+		// Back to the Phone level, out of the session
+		if (LoadedWorld->GetNetMode() == NM_Standalone && LoadedWorld->GetMapName() == TEXT("Phone"))
+		{
+			bMapLoaded = true;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UCellDemoSoakTest::SetStage(EStage NewStage)
+{
+	Stage = NewStage;
+	StageStartTime = FPlatformTime::Seconds();
+	bMapLoaded = false;
+}
+
+void UCellDemoSoakTest::BeginCycle()
+{
+	CycleStartTime = FPlatformTime::Seconds();
+	SetStage(EStage::Entering);
+
+	if (bJoinRole)
+	{
+		GameInstance->FindAndJoinOnlineGame(SessionId);
+	}
+	else
+	{
+		GameInstance->StartOnlineGame(MapName, 4, SessionId);
+	}
+}
+
+void UCellDemoSoakTest::Tick(float DeltaTime)
+{
+	const double StageTime = FPlatformTime::Seconds() - StageStartTime;
+
+	switch (Stage)
+	{
+	case EStage::Entering:
+		if (bMapLoaded)
+		{
+			SetStage(EStage::Staying);
+		}
+		else if (StageTime > StageTimeout)
+		{
+			AbandonStage();
+		}
+		break;
+
+	case EStage::Staying:
+		if (StageTime > StayTime)
+		{
+			SetStage(EStage::Leaving);
+			GameInstance->DestroySessionAndLeaveGame();
+		}
+		break;
+
+	case EStage::Leaving:
+		if (bMapLoaded)
+		{
+			EndCycle();
+		}
+		else if (StageTime > StageTimeout)
+		{
+			AbandonStage();
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UCellDemoSoakTest::AbandonStage()
+{
+	NumStuckStages++;
+	UE_LOG(LogCellDemo, Warning, TEXT("CellSoak: cycle %d stuck, %d session delegates still registered"), Cycle, GameInstance->GetNumRegisteredSessionDelegates());
+
+	// The request will never complete, unbind it ourselves so the next cycles are measured on a clean state
+	GameInstance->ClearSessionDelegates();
+
+	SetStage(EStage::Leaving);
+	UGameplayStatics::OpenLevel(GameInstance->GetWorld(), "Phone", true);
+}
+
+void UCellDemoSoakTest::EndCycle()
+{
+	FCellSoakCycleSample Sample;
+	Sample.Cycle = Cycle;
+	Sample.CycleMs = (FPlatformTime::Seconds() - CycleStartTime) * 1000.0;
+	Sample.RegisteredDelegates = GameInstance->GetNumRegisteredSessionDelegates();
+	Sample.NumObjects = CountObjects(Cycle == WarmupCycles ? &WarmupObjectCounts : nullptr);
+	Sample.UsedMemoryMB = FPlatformMemory::GetStats().UsedPhysical / (1024.0f * 1024.0f);
+	Sample.NumSearchResults = GameInstance->SessionSearch.IsValid() ? GameInstance->SessionSearch->SearchResults.Num() : 0;
+	Samples.Add(Sample);
+
+	UE_LOG(LogCellDemo, Log, TEXT("CellSoak: cycle %d in %.0f ms, %d delegates, %d objects, %.1f MB"),
+		Cycle, Sample.CycleMs, Sample.RegisteredDelegates, Sample.NumObjects, Sample.UsedMemoryMB);
+
+	Cycle++;
+	if (Cycle >= NumCycles)
+	{
+		Finish();
+	}
+	else
+	{
+		BeginCycle();
+	}
+}
+
+int32 UCellDemoSoakTest::CountObjects(TMap<FName, int32>* OutCountsPerClass)
+{
+	int32 NumObjects = 0;
+	for (TObjectIterator<UObject> It; It; ++It)
+	{
+		NumObjects++;
+		if (OutCountsPerClass != nullptr)
+		{
+			OutCountsPerClass->FindOrAdd(It->GetClass()->GetFName())++;
+		}
+	}
+	return NumObjects;
+}
+
+float UCellDemoSoakTest::GetGrowthPerCycle(TFunctionRef<float(const FCellSoakCycleSample&)> Value) const
+{
+	double SumX = 0.0, SumY = 0.0, SumXY = 0.0, SumXX = 0.0;
+	int32 Count = 0;
+	for (const FCellSoakCycleSample& Sample : Samples)
+	{
+		if (Sample.Cycle < WarmupCycles)
+		{
+			continue;
+		}
+
+		const double X = Sample.Cycle;
+		const double Y = Value(Sample);
+		SumX += X;
+		SumY += Y;
+		SumXY += X * Y;
+		SumXX += X * X;
+		Count++;
+	}
+
+	const double Denominator = Count * SumXX - SumX * SumX;
+	return Count > 1 && Denominator > 0.0 ? (Count * SumXY - SumX * SumY) / Denominator : 0.0f;
+}
+
+void UCellDemoSoakTest::Finish()
+{
+	Stage = EStage::Done;
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	FString Csv = TEXT("Cycle,CycleMs,RegisteredDelegates,NumObjects,UsedMemoryMB,NumSearchResults\n");
+	int32 NumLeakedDelegates = 0;
+	for (const FCellSoakCycleSample& Sample : Samples)
+	{
+		Csv += FString::Printf(TEXT("%d,%.1f,%d,%d,%.1f,%d\n"), Sample.Cycle, Sample.CycleMs, Sample.RegisteredDelegates, Sample.NumObjects, Sample.UsedMemoryMB, Sample.NumSearchResults);
+		NumLeakedDelegates = FMath::Max(NumLeakedDelegates, Sample.RegisteredDelegates);
+	}
+
+	const FString OutputDir = FPaths::ProjectSavedDir() / TEXT("Profiling/CellSoak");
+	FFileHelper::SaveStringToFile(Csv, *(OutputDir / TEXT("Soak.csv")));
+
+	const float ObjectGrowth = GetGrowthPerCycle([](const FCellSoakCycleSample& Sample) { return (float)Sample.NumObjects; });
+	const float MemoryGrowthKB = GetGrowthPerCycle([](const FCellSoakCycleSample& Sample) { return Sample.UsedMemoryMB * 1024.0f; });
+
+	bool bFailed = false;
+	if (NumLeakedDelegates > 0)
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellSoak: up to %d session delegates still registered at the end of a cycle"), NumLeakedDelegates);
+		bFailed = true;
+	}
+	if (NumStuckStages > 0)
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellSoak: %d cycle stages never completed"), NumStuckStages);
+		bFailed = true;
+	}
+	if (MemoryGrowthKB > MaxMemoryGrowthKBPerCycle)
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellSoak: memory grows by %.1f KB per cycle"), MemoryGrowthKB);
+		bFailed = true;
+	}
+	if (ObjectGrowth > MaxObjectGrowthPerCycle)
+	{
+		UE_LOG(LogCellDemo, Error, TEXT("CellSoak: live objects grow by %.2f per cycle"), ObjectGrowth);
+		bFailed = true;
+
+		// Tell which classes leak the most
+		TMap<FName, int32> Growths;
+		CountObjects(&Growths);
+		for (TPair<FName, int32>& Growth : Growths)
+		{
+			Growth.Value -= WarmupObjectCounts.FindRef(Growth.Key);
+		}
+		Growths.ValueSort([](int32 A, int32 B) { return A > B; });
+
+		int32 NumReported = 0;
+		for (const TPair<FName, int32>& Growth : Growths)
+		{
+			if (Growth.Value <= 0 || NumReported++ >= 10)
+			{
+				break;
+			}
+			UE_LOG(LogCellDemo, Error, TEXT("CellSoak:   %s +%d"), *Growth.Key.ToString(), Growth.Value);
+		}
+	}
+
+	FFileHelper::SaveStringToFile(bFailed ? TEXT("FAIL") : TEXT("PASS"), *(OutputDir / TEXT("Result.txt")));
+	UE_LOG(LogCellDemo, Log, TEXT("CellSoak: %s after %d cycles (objects %+.2f/cycle, memory %+.1f KB/cycle)"),
+		bFailed ? TEXT("FAILED") : TEXT("PASSED"), Samples.Num(), ObjectGrowth, MemoryGrowthKB);
+
+	// Only quit when the soak test was started from the command line
+	int32 CommandLineCycles = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("CellSoak="), CommandLineCycles))
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Tickable.h"
+#include "CellDemoSoakTest.generated.h"
+
+/** What is measured at the end of every cycle, back on the Phone level */
+struct FCellSoakCycleSample
+{
+	int32 Cycle;
+	float CycleMs;
+	int32 RegisteredDelegates;
+	int32 NumObjects;
+	float UsedMemoryMB;
+	int32 NumSearchResults;
+};
+
+/**
+*	Call cycle soak test, finds the leaks of the session code over long uptimes.
+*
+*	Host role: host a session, stay in it, hang up, repeat.
+*	Join role: find and join the session of another process, stay in it, hang up, repeat.
+*	Every cycle ends back on the Phone level, after the travel garbage collection, where the registered session
+*	delegates, the live UObjects per class and the used memory are sampled to Saved/Profiling/CellSoak/Soak.csv.
+*	The run fails if a delegate is still registered at the end of a cycle or if the objects or the memory keep growing.
+*
+*	Run with: CellDemo -nullrhi -unattended -CellSoak=<Cycles> [-CellSoakRole=Host|Join] [-CellSoakSessionId=<Id>]
+*/
+UCLASS(config = Game)
+class UCellDemoSoakTest : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UCellDemoSoakTest();
+
+	/** Map hosted by the Host role */
+	UPROPERTY(config)
+	FString MapName;
+
+	/** Time spent in the session every cycle */
+	UPROPERTY(config)
+	float StayTime;
+
+	/** A cycle stage taking longer than this is abandoned and counted as a failure */
+	UPROPERTY(config)
+	float StageTimeout;
+
+	/** Cycles ignored by the growth check, caches fill up during the first ones */
+	UPROPERTY(config)
+	int32 WarmupCycles;
+
+	/** Growth limits, as least squares slope over the cycles after the warmup */
+	UPROPERTY(config)
+	float MaxObjectGrowthPerCycle;
+
+	UPROPERTY(config)
+	float MaxMemoryGrowthKBPerCycle;
+
+	void Start(class UCellNWGameInstance* InGameInstance, int32 InNumCycles);
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+protected:
+	enum class EStage : uint8
+	{
+		Idle,
+		Entering,
+		Staying,
+		Leaving,
+		Done
+	};
+
+	UPROPERTY(Transient)
+	class UCellNWGameInstance* GameInstance;
+
+	EStage Stage;
+	bool bJoinRole;
+	FString SessionId;
+	int32 NumCycles;
+	int32 Cycle;
+	int32 NumStuckStages;
+	double StageStartTime;
+	double CycleStartTime;
+	bool bMapLoaded;
+
+	TArray<FCellSoakCycleSample> Samples;
+
+	/** Live objects per class at the end of the warmup, to report which classes grew */
+	TMap<FName, int32> WarmupObjectCounts;
+
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	void SetStage(EStage NewStage);
+	void BeginCycle();
+	void EndCycle();
+	void AbandonStage();
+	void Finish();
+
+	static int32 CountObjects(TMap<FName, int32>* OutCountsPerClass);
+
+	/** Least squares slope of the samples after the warmup */
+	float GetGrowthPerCycle(TFunctionRef<float(const FCellSoakCycleSample&)> Value) const;
+};
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoStats.h"
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/App.h"
+
+int32 FCellDemoServerStats::MoveRequests = 0;
+int32 FCellDemoServerStats::NavQueries = 0;
+double FCellDemoServerStats::NavQueryTime = 0.0;
+int32 FCellDemoServerStats::NavQueryStalls = 0;
+const double FCellDemoServerStats::NavQueryStallTime = 0.002;
+int32 FCellDemoServerStats::NavObstacleChanges = 0;
+int32 FCellDemoServerStats::PathCacheHits = 0;
+int32 FCellDemoServerStats::PathCacheMisses = 0;
+double FCellDemoServerStats::PathCacheSavedTime = 0.0;
+
+FCellDemoFrameSample FCellDemoFrameSample::Capture(UWorld* World)
+{
+	FCellDemoFrameSample Sample;
+	Sample.FrameMs = FApp::GetDeltaTime() * 1000.0f;
+	Sample.GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	Sample.RenderThreadMs = FPlatformTime::ToMilliseconds(GRenderThreadTime);
+	Sample.GPUMs = FPlatformTime::ToMilliseconds(GGPUFrameTime);
+
+	if (UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr)
+	{
+		Sample.NetInBytesPerSecond = NetDriver->InBytesPerSecond;
+		Sample.NetOutBytesPerSecond = NetDriver->OutBytesPerSecond;
+
+		// Clients only have the server connection, servers average over all their clients
+		TArray<UNetConnection*> Connections;
+		if (NetDriver->ServerConnection != nullptr)
+		{
+			Connections.Add(NetDriver->ServerConnection);
+		}
+		else
+		{
+			Connections = NetDriver->ClientConnections;
+		}
+
+		int32 InPackets = 0;
+		int32 InPacketsLost = 0;
+		for (UNetConnection* Connection : Connections)
+		{
+			Sample.PingMs += Connection->AvgLag * 1000.0f;
+			InPackets += Connection->InPackets;
+			InPacketsLost += Connection->InPacketsLost;
+		}
+
+		if (Connections.Num() > 0)
+		{
+			Sample.PingMs /= Connections.Num();
+		}
+		if (InPackets + InPacketsLost > 0)
+		{
+			Sample.PacketLossPercent = 100.0f * InPacketsLost / (InPackets + InPacketsLost);
+		}
+	}
+
+	Sample.UsedMemoryMB = FPlatformMemory::GetStats().UsedPhysical / (1024.0f * 1024.0f);
+	return Sample;
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+/**
+*	Process wide counters bumped by the server side gameplay code.
+*	They are never reset, tools sample them and work with the difference between two samples.
+*/
+struct CELLDEMO_API FCellDemoServerStats
+{
+	/** Number of SetNewMoveDestination requests processed by the server */
+	static int32 MoveRequests;
+
+	/** Number of navigation path queries issued for click to move */
+	static int32 NavQueries;
+
+	/** Total time spent in navigation path queries, in seconds */
+	static double NavQueryTime;
+
+	/** Path queries slower than NavQueryStallTime */
+	static int32 NavQueryStalls;
+	static const double NavQueryStallTime;
+
+	/** Number of navigation obstacles added or removed, block churn */
+	static int32 NavObstacleChanges;
+
+	/** Path requests answered by the path cache, and the path finding time it saved, in seconds */
+	static int32 PathCacheHits;
+	static int32 PathCacheMisses;
+	static double PathCacheSavedTime;
+};
+
+/**
+*	Snapshot of the counters above, used to compute per second rates
+*/
+struct CELLDEMO_API FCellDemoServerStatsSample
+{
+	int32 MoveRequests;
+	int32 NavQueries;
+	double NavQueryTime;
+	int32 NavQueryStalls;
+	int32 NavObstacleChanges;
+	int32 PathCacheHits;
+	int32 PathCacheMisses;
+	double PathCacheSavedTime;
+
+	FCellDemoServerStatsSample()
+		: MoveRequests(0)
+		, NavQueries(0)
+		, NavQueryTime(0.0)
+		, NavQueryStalls(0)
+		, NavObstacleChanges(0)
+		, PathCacheHits(0)
+		, PathCacheMisses(0)
+		, PathCacheSavedTime(0.0)
+	{
+	}
+
+	/** Reads the current value of all the counters */
+	static FCellDemoServerStatsSample Capture()
+	{
+		FCellDemoServerStatsSample Sample;
+		Sample.MoveRequests = FCellDemoServerStats::MoveRequests;
+		Sample.NavQueries = FCellDemoServerStats::NavQueries;
+		Sample.NavQueryTime = FCellDemoServerStats::NavQueryTime;
+		Sample.NavQueryStalls = FCellDemoServerStats::NavQueryStalls;
+		Sample.NavObstacleChanges = FCellDemoServerStats::NavObstacleChanges;
+		Sample.PathCacheHits = FCellDemoServerStats::PathCacheHits;
+		Sample.PathCacheMisses = FCellDemoServerStats::PathCacheMisses;
+		Sample.PathCacheSavedTime = FCellDemoServerStats::PathCacheSavedTime;
+		return Sample;
+	}
+};
+
+/**
+*	Cost of one frame, read from the engine globals and the net driver of a world
+*/
+struct CELLDEMO_API FCellDemoFrameSample
+{
+	/** Wall time of the frame, in milliseconds */
+	float FrameMs;
+
+	/** Game, render thread and GPU time without the idle wait, in milliseconds */
+	float GameThreadMs;
+	float RenderThreadMs;
+	float GPUMs;
+
+	/** Net driver traffic over the last second, in bytes */
+	uint32 NetInBytesPerSecond;
+	uint32 NetOutBytesPerSecond;
+
+	/** Round trip time to the server on clients, average over the clients on a server, in milliseconds */
+	float PingMs;
+
+	/** Incoming packets lost over the last second, in percent */
+	float PacketLossPercent;
+
+	/** Used physical memory, in megabytes */
+	float UsedMemoryMB;
+
+	FCellDemoFrameSample()
+		: FrameMs(0.0f)
+		, GameThreadMs(0.0f)
+		, RenderThreadMs(0.0f)
+		, GPUMs(0.0f)
+		, NetInBytesPerSecond(0)
+		, NetOutBytesPerSecond(0)
+		, PingMs(0.0f)
+		, PacketLossPercent(0.0f)
+		, UsedMemoryMB(0.0f)
+	{
+	}
+
+	static FCellDemoFrameSample Capture(UWorld* World);
+
+	friend FArchive& operator<<(FArchive& Ar, FCellDemoFrameSample& Sample)
+	{
+		Ar << Sample.FrameMs << Sample.GameThreadMs << Sample.RenderThreadMs << Sample.GPUMs;
+		Ar << Sample.NetInBytesPerSecond << Sample.NetOutBytesPerSecond;
+		Ar << Sample.PingMs << Sample.PacketLossPercent << Sample.UsedMemoryMB;
+		return Ar;
+	}
+};
@@ -0,0 +1,221 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CellDemoTickGovernor.h"
+#include "CellDemo.h"
+#include "CellDemoGameMode.h"
+#include "CellDemoNavManager.h"
+#include "CellDemoPowerGovernor.h"
+#include "CellNWGameInstance.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Navigation/PathFollowingComponent.h"
+
+bool ACellDemoTickGovernor::bThrottling = false;
+
+ACellDemoTickGovernor::ACellDemoTickGovernor()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	// Account the frame once everything else ran
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	bEnabled = true;
+	IdleDelay = 2.0f;
+	IdleMaxFPS = 10.0f;
+	IdleNetServerMaxTickRate = 10;
+	ReportInterval = 30.0f;
+
+	bIdle = false;
+	LastActivityTime = 0.0;
+	LastMousePosition = FVector2D::ZeroVector;
+	SavedMaxFPS = 0.0f;
+	SavedNetServerMaxTickRate = 0;
+	IdleCpuMs = 0.0;
+	ActiveCpuMs = 0.0;
+	IdleTime = 0.0;
+	ActiveTime = 0.0;
+	ReportIdleCpuMs = 0.0;
+	ReportActiveCpuMs = 0.0;
+	ReportIdleTime = 0.0;
+	ReportActiveTime = 0.0;
+}
+
+void ACellDemoTickGovernor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	LastActivityTime = FPlatformTime::Seconds();
+	LastStats = FCellDemoServerStatsSample::Capture();
+}
+
+void ACellDemoTickGovernor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Don't leave the next map throttled
+	SetIdle(false);
+	PublishReport();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACellDemoTickGovernor::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const double FrameCpuMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	if (bIdle)
+	{
+		IdleCpuMs += FrameCpuMs;
+		IdleTime += DeltaSeconds;
+	}
+	else
+	{
+		ActiveCpuMs += FrameCpuMs;
+		ActiveTime += DeltaSeconds;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (HasActivity())
+	{
+		LastActivityTime = Now;
+		SetIdle(false);
+	}
+	else if (bEnabled && Now - LastActivityTime > IdleDelay)
+	{
+		SetIdle(true);
+	}
+
+	if (ReportInterval > 0.0f && IdleTime + ActiveTime - ReportIdleTime - ReportActiveTime >= ReportInterval)
+	{
+		PublishReport();
+	}
+}
+
+bool ACellDemoTickGovernor::HasActivity()
+{
+	const FCellDemoServerStatsSample Stats = FCellDemoServerStatsSample::Capture();
+	const bool bNewRequests = Stats.MoveRequests != LastStats.MoveRequests || Stats.NavObstacleChanges != LastStats.NavObstacleChanges;
+	LastStats = Stats;
+
+	// Check the local input even when something else is going on, so the mouse position stays current
+	bool bActivity = HasLocalInput();
+	bActivity |= bNewRequests;
+
+	if (!bActivity)
+	{
+		ACellDemoNavManager* NavManager = ACellDemoNavManager::Get(GetWorld());
+		ACellDemoGameMode* GameMode = GetWorld()->GetAuthGameMode<ACellDemoGameMode>();
+		bActivity = (NavManager != nullptr && NavManager->GetNumPendingObstacles() > 0) || (GameMode != nullptr && GameMode->GetNumQueuedPlayers() > 0);
+	}
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It && !bActivity; ++It)
+	{
+		APlayerController* Controller = It->Get();
+		if (Controller == nullptr)
+		{
+			continue;
+		}
+
+		const UPathFollowingComponent* PathFollowing = Controller->FindComponentByClass<UPathFollowingComponent>();
+		const APawn* Pawn = Controller->GetPawn();
+		bActivity = (PathFollowing != nullptr && PathFollowing->GetStatus() != EPathFollowingStatus::Idle)
+			|| (Pawn != nullptr && !Pawn->GetVelocity().IsNearlyZero(1.0f));
+	}
+
+	return bActivity;
+}
+
+bool ACellDemoTickGovernor::HasLocalInput()
+{
+	// The local player of a listen server still sees the game, any touch or mouse move wakes it up
+	APlayerController* LocalController = GetWorld()->GetFirstPlayerController();
+	if (LocalController == nullptr || !LocalController->IsLocalPlayerController())
+	{
+		return false;
+	}
+
+	float TouchX, TouchY;
+	bool bTouching = false;
+	LocalController->GetInputTouchState(ETouchIndex::Touch1, TouchX, TouchY, bTouching);
+
+	FVector2D MousePosition = LastMousePosition;
+	LocalController->GetMousePosition(MousePosition.X, MousePosition.Y);
+	const bool bMouseMoved = MousePosition != LastMousePosition;
+	LastMousePosition = MousePosition;
+
+	return bTouching || bMouseMoved || LocalController->IsInputKeyDown(EKeys::LeftMouseButton);
+}
+
+void ACellDemoTickGovernor::SetIdle(bool bNewIdle)
+{
+	if (bNewIdle == bIdle)
+	{
+		return;
+	}
+	bIdle = bNewIdle;
+	bThrottling = bNewIdle;
+
+	IConsoleVariable* MaxFPS = IConsoleManager::Get().FindConsoleVariable(TEXT("t.MaxFPS"));
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+
+	if (bIdle)
+	{
+		if (MaxFPS != nullptr)
+		{
+			SavedMaxFPS = MaxFPS->GetFloat();
+			MaxFPS->Set(SavedMaxFPS > 0.0f ? FMath::Min(SavedMaxFPS, IdleMaxFPS) : IdleMaxFPS, ECVF_SetByCode);
+		}
+		if (NetDriver != nullptr)
+		{
+			SavedNetServerMaxTickRate = NetDriver->NetServerMaxTickRate;
+			NetDriver->NetServerMaxTickRate = FMath::Min(SavedNetServerMaxTickRate, IdleNetServerMaxTickRate);
+		}
+	}
+	else
+	{
+		// The power policy may have changed while throttled
+		UCellNWGameInstance* GameInstance = Cast<UCellNWGameInstance>(GetGameInstance());
+		if (GameInstance != nullptr && GameInstance->PowerGovernor != nullptr)
+		{
+			GameInstance->PowerGovernor->ApplyPolicy();
+		}
+		else
+		{
+			if (MaxFPS != nullptr)
+			{
+				MaxFPS->Set(SavedMaxFPS, ECVF_SetByCode);
+			}
+			if (NetDriver != nullptr && SavedNetServerMaxTickRate > 0)
+			{
+				NetDriver->NetServerMaxTickRate = SavedNetServerMaxTickRate;
+			}
+		}
+	}
+
+	UE_LOG(LogCellDemo, Verbose, TEXT("Tick governor: session %s"), bIdle ? TEXT("idle") : TEXT("active"));
+}
+
+void ACellDemoTickGovernor::PublishReport()
+{
+	const double WindowIdleTime = IdleTime - ReportIdleTime;
+	const double WindowActiveTime = ActiveTime - ReportActiveTime;
+	const double WindowTime = WindowIdleTime + WindowActiveTime;
+	if (WindowTime <= 0.0)
+	{
+		return;
+	}
+
+	const double IdleCpuMsPerSecond = WindowIdleTime > 0.0 ? (IdleCpuMs - ReportIdleCpuMs) / WindowIdleTime : 0.0;
+	const double ActiveCpuMsPerSecond = WindowActiveTime > 0.0 ? (ActiveCpuMs - ReportActiveCpuMs) / WindowActiveTime : 0.0;
+
+	UE_LOG(LogCellDemo, Log, TEXT("Tick governor: idle %.0f%% of %.0f s | game thread %.1f ms/s idle, %.1f ms/s active | session total %.0f ms | %.0f idle cells per core"),
+		100.0 * WindowIdleTime / WindowTime, WindowTime, IdleCpuMsPerSecond, ActiveCpuMsPerSecond, GetSessionCpuMs(),
+		IdleCpuMsPerSecond > 0.0 ? 1000.0 / IdleCpuMsPerSecond : 0.0);
+
+	ReportIdleCpuMs = IdleCpuMs;
+	ReportActiveCpuMs = ActiveCpuMs;
+	ReportIdleTime = IdleTime;
+	ReportActiveTime = ActiveTime;
+}
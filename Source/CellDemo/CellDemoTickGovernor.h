@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CellDemoStats.h"
+#include "CellDemoTickGovernor.generated.h"
+
+/**
+*	Lowers the tick rate of a hosted cell while nothing happens in it.
+*
+*	The session is idle when no move was requested, no obstacle changed, no character follows a path or moves,
+*	no player waits for admission and the local player of a listen server doesn't touch the screen, for IdleDelay.
+*	The frame rate (t.MaxFPS) and the server net tick rate are then lowered, and restored on the first frame with activity.
+*
+*	The game thread time of every frame (GGameThreadTime) is accounted to the idle or active state of the session, and
+*	logged every ReportInterval with how many idle cells would fit on one core.
+*/
+UCLASS(config = Game)
+class ACellDemoTickGovernor : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACellDemoTickGovernor();
+
+	UPROPERTY(config)
+	bool bEnabled;
+
+	/** Time without activity before the session is idle, in seconds */
+	UPROPERTY(config)
+	float IdleDelay;
+
+	/** Frame rate and net tick rate of an idle session */
+	UPROPERTY(config)
+	float IdleMaxFPS;
+
+	UPROPERTY(config)
+	int32 IdleNetServerMaxTickRate;
+
+	/** Time between two CPU reports, in seconds, 0 to disable them */
+	UPROPERTY(config)
+	float ReportInterval;
+
+	bool IsIdle() const { return bIdle; }
+
+	/** True while a hosted cell of this process is throttled, the power governor leaves the rates alone then */
+	static bool IsThrottling() { return bThrottling; }
+
+	/** Game thread time spent by the session since it started, in milliseconds */
+	double GetSessionCpuMs() const { return IdleCpuMs + ActiveCpuMs; }
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	static bool bThrottling;
+
+	bool bIdle;
+	double LastActivityTime;
+	FCellDemoServerStatsSample LastStats;
+	FVector2D LastMousePosition;
+
+	/** Rates to restore when the session becomes active again */
+	float SavedMaxFPS;
+	int32 SavedNetServerMaxTickRate;
+
+	/** Accounting since the session started */
+	double IdleCpuMs;
+	double ActiveCpuMs;
+	double IdleTime;
+	double ActiveTime;
+
+	/** Accounting at the last report */
+	double ReportIdleCpuMs;
+	double ReportActiveCpuMs;
+	double ReportIdleTime;
+	double ReportActiveTime;
+
+	bool HasActivity();
+	bool HasLocalInput();
+	void SetIdle(bool bNewIdle);
+	void PublishReport();
+};
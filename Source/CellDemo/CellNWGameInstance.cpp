@@ -4,6 +4,22 @@
 
 #include "Engine.h"
 #include "Online.h"
+#include "CellDemoPerfSuite.h"
+#include "CellDemoPerfMonitor.h"
+#include "CellDemoSoakTest.h"
+#include "CellDemoPowerGovernor.h"
+#include "CellDemoBootProfiler.h"
+#include "CellDemoSessionMigration.h"
+#include "CellDemoLinkQualityComponent.h"
+#include "CellDemo.h"
+#include "IPAddress.h"
+#include "SocketSubsystem.h"
+
+/** The default online subsystem if something created it already, IOnlineSubsystem::Get creates it */
+static IOnlineSubsystem* GetExistingOnlineSubsystem()
+{
+	return IOnlineSubsystem::DoesInstanceExist() ? IOnlineSubsystem::Get() : nullptr;
+}
 
 UCellNWGameInstance::UCellNWGameInstance(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
@@ -22,6 +38,95 @@ UCellNWGameInstance::UCellNWGameInstance(const FObjectInitializer& ObjectInitial
 	OnDestroySessionCompleteDelegate = FOnDestroySessionCompleteDelegate::CreateUObject(this, &UCellNWGameInstance::OnDestroySessionComplete);
 
 	bShowDebugMsg = false;
+	PerfSuite = nullptr;
+	PerfMonitor = nullptr;
+	PowerGovernor = nullptr;
+	BootProfiler = nullptr;
+	SessionMigration = nullptr;
+	SoakTest = nullptr;
+	bCommandLineTestsStarted = false;
+	bMeasureInSessionPing = false;
+	SessionStageStartTime = 0.0;
+	JoinTravelStartTime = 0.0;
+}
+
+void UCellNWGameInstance::Init()
+{
+	Super::Init();
+
+	BootProfiler = NewObject<UCellDemoBootProfiler>(this);
+	BootProfiler->Initialize(this);
+
+	PerfMonitor = NewObject<UCellDemoPerfMonitor>(this);
+	PerfMonitor->Initialize(this);
+
+	PowerGovernor = NewObject<UCellDemoPowerGovernor>(this);
+	PowerGovernor->Initialize(this);
+
+	SessionMigration = NewObject<UCellDemoSessionMigration>(this);
+	SessionMigration->Initialize(this);
+
+	FString RestorePath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("CellRestore="), RestorePath))
+	{
+		SessionMigration->StartRestore(RestorePath);
+	}
+
+	// The game state is replaced on every travel
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UCellNWGameInstance::OnPostLoadMap);
+
+	BootProfiler->OnGameInstanceInitialized();
+}
+
+void UCellNWGameInstance::Shutdown()
+{
+	ClearSessionDelegates();
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	Super::Shutdown();
+}
+
+void UCellNWGameInstance::StartSoakTest(int32 Cycles)
+{
+	if (GetFirstGamePlayer() == nullptr)
+	{
+		UE_LOG(LogCellDemo, Warning, TEXT("CellSoak: needs a local player, start it once a map is loaded"));
+		return;
+	}
+
+	if (SoakTest == nullptr)
+	{
+		SoakTest = NewObject<UCellDemoSoakTest>(this);
+	}
+	SoakTest->Start(this, Cycles);
+}
+
+void UCellNWGameInstance::StartCommandLineTests()
+{
+	// The session functions need the local player, which only exists from the first map load on
+	if (bCommandLineTestsStarted || GetFirstGamePlayer() == nullptr)
+	{
+		return;
+	}
+	bCommandLineTestsStarted = true;
+
+	FString PerfJoinSessionId;
+	if (FParse::Param(FCommandLine::Get(), TEXT("CellPerfSuite")))
+	{
+		PerfSuite = NewObject<UCellDemoPerfSuite>(this);
+		PerfSuite->Start(this, PerfSuite->Maps, true);
+	}
+	else if (FParse::Value(FCommandLine::Get(), TEXT("CellPerfJoin="), PerfJoinSessionId))
+	{
+		PerfSuite = NewObject<UCellDemoPerfSuite>(this);
+		PerfSuite->StartJoin(this, PerfJoinSessionId);
+	}
+
+	int32 SoakCycles = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("CellSoak="), SoakCycles) && SoakCycles > 0)
+	{
+		StartSoakTest(SoakCycles);
+	}
 }
 
 // *******************************
@@ -61,7 +166,11 @@ bool UCellNWGameInstance::HostSession(TSharedPtr<const FUniqueNetId> UserId, FSt
 			SessionSettings->Set(SETTING_MAPNAME, MapName, EOnlineDataAdvertisementType::ViaOnlineService);
 			SessionSettings->Set(FName(TEXT("SessionId")), SessionId, EOnlineDataAdvertisementType::ViaOnlineService);
 
-			// Set the delegate to the Handle of the SessionInterface
+			// Answer the RTT probes of the clients choosing between several hosts
+			SessionSettings->Set(FName(TEXT("ProbePort")), ProbeResponder.Start(), EOnlineDataAdvertisementType::ViaOnlineService);
+
+			// Set the delegate to the Handle of the SessionInterface, dropping the one of a previous request that never completed
+			Sessions->ClearOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegateHandle);
 			OnCreateSessionCompleteDelegateHandle = Sessions->AddOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegate);
 
 			if (bShowDebugMsg)
@@ -69,8 +178,17 @@ bool UCellNWGameInstance::HostSession(TSharedPtr<const FUniqueNetId> UserId, FSt
 				GEngine->AddOnScreenDebugMessage(-1, 100.f, FColor::Red, FString::Printf(TEXT("Creating Session with SessionId: %s "), *SessionId));
 			}
 
+			BeginSessionStage();
+
 			// Our delegate should get called when this is complete (doesn't need to be successful!)
-			return Sessions->CreateSession(*UserId, SessionName, *SessionSettings);
+			if (Sessions->CreateSession(*UserId, SessionName, *SessionSettings))
+			{
+				return true;
+			}
+
+			// The request failed right away, our delegate will never be called
+			Sessions->ClearOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegateHandle);
+			ProbeResponder.Stop();
 		}
 	}
 	else
@@ -91,6 +209,8 @@ void UCellNWGameInstance::OnCreateSessionComplete(FName SessionName, bool bWasSu
 		GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("OnCreateSessionComplete %s, %d"), *SessionName.ToString(), bWasSuccessful));
 	}
 
+	SessionStageTimings.CreateMs = EndSessionStage();
+
 	// Get the OnlineSubsystem so we can get the Session Interface
 	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
 	if (OnlineSub)
@@ -108,11 +228,20 @@ void UCellNWGameInstance::OnCreateSessionComplete(FName SessionName, bool bWasSu
 				OnStartSessionCompleteDelegateHandle = Sessions->AddOnStartSessionCompleteDelegate_Handle(OnStartSessionCompleteDelegate);
 
 				// Our StartSessionComplete delegate should get called after this
-				Sessions->StartSession(SessionName);
+				if (!Sessions->StartSession(SessionName))
+				{
+					Sessions->ClearOnStartSessionCompleteDelegate_Handle(OnStartSessionCompleteDelegateHandle);
+				}
+			}
+			else
+			{
+				ProbeResponder.Stop();
 			}
 		}
 
 	}
+
+	RefreshOnlineStatus();
 }
 
 void UCellNWGameInstance::OnStartOnlineGameComplete(FName SessionName, bool bWasSuccessful)
@@ -122,6 +251,8 @@ void UCellNWGameInstance::OnStartOnlineGameComplete(FName SessionName, bool bWas
 		GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("OnStartSessionComplete %s, %d"), *SessionName.ToString(), bWasSuccessful));
 	}
 
+	SessionStageTimings.StartMs = EndSessionStage();
+
 	// Get the Online Subsystem so we can get the Session Interface
 	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
 	if (OnlineSub)
@@ -160,6 +291,8 @@ void UCellNWGameInstance::OnStartOnlineGameComplete(FName SessionName, bool bWas
 			}
 		}
 	}
+
+	RefreshOnlineStatus();
 }
 
 // *******************************
@@ -204,6 +337,7 @@ void UCellNWGameInstance::FindSessions(ULocalPlayer* const Player, bool bIsLAN,
 			// Set the Delegate to the Delegate Handle of the FindSession function
 			if (bAutoJoin)
 			{
+				Sessions->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
 				OnFindSessionsCompleteDelegateHandle = Sessions->AddOnFindSessionsCompleteDelegate_Handle(OnFindAndJoinFindSessionsCompleteDelegate);
 				
 				ACellDemoPlayerController* controller = Cast<ACellDemoPlayerController>(Player->GetPlayerController(GetWorld()));
@@ -216,7 +350,11 @@ void UCellNWGameInstance::FindSessions(ULocalPlayer* const Player, bool bIsLAN,
 			}
 
 			// Finally call the SessionInterface function. The Delegate gets called once this is finished
-			Sessions->FindSessions(*UserId, SearchSettingsRef);
+			BeginSessionStage();
+			if (!Sessions->FindSessions(*UserId, SearchSettingsRef))
+			{
+				Sessions->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
+			}
 
 			
 		}
@@ -235,6 +373,8 @@ void UCellNWGameInstance::OnFindAndJoinFindSessionsComplete(bool bWasSuccessful)
 		GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("OFindSessionsComplete bSuccess: %d"), bWasSuccessful));
 	}
 
+	SessionStageTimings.FindMs = EndSessionStage();
+
 	ULocalPlayer* const Player = GetFirstGamePlayer();
 	ACellDemoPlayerController* controller = Cast<ACellDemoPlayerController>(Player->GetPlayerController(GetWorld()));
 	if (controller != nullptr)
@@ -262,6 +402,8 @@ void UCellNWGameInstance::OnFindAndJoinFindSessionsComplete(bool bWasSuccessful)
 			// If we have found at least 1 session, we just going to debug them. You could add them to a list of UMG Widgets, like it is done in the BP version!
 			if (SessionSearch->SearchResults.Num() > 0)
 			{
+				// Several hosts can advertise the same SessionId, keep all of them and join the closest one
+				TArray<int32> Candidates;
 
 				// "SessionSearch->SearchResults" is an Array that contains all the information. You can access the Session in this and get a lot of information.
 				// This can be customized later on with your own classes to add more information that can be set and displayed
@@ -288,23 +430,21 @@ void UCellNWGameInstance::OnFindAndJoinFindSessionsComplete(bool bWasSuccessful)
 
 							if (sessionId == controller->OnlineSessionId)
 							{
-								// Once we found sounce a Session that is not ours, just join it. Instead of using a for loop, you could
-								// use a widget where you click on and have a reference for the GameSession it represents which you can use
-								// here
-								JoinOnlineSession(Player->GetPreferredUniqueNetId(), GameSessionName, SessionSearch->SearchResults[SearchIdx]);
-
-								ULocalPlayer* const Player = GetFirstGamePlayer();
-								ACellDemoPlayerController* controller = Cast<ACellDemoPlayerController>(Player->GetPlayerController(GetWorld()));
-								if (controller != nullptr)
-								{
-									controller->Connecting = true;
-								}
+								Candidates.Add(SearchIdx);
 							}
-
-							break;
 						}
 					}
 				}
+
+				if (Candidates.Num() > 0)
+				{
+					ProbeAndJoinSession(Candidates);
+
+					if (controller != nullptr)
+					{
+						controller->Connecting = true;
+					}
+				}
 			}
 		}
 	}
@@ -337,11 +477,17 @@ bool UCellNWGameInstance::JoinOnlineSession(TSharedPtr<const FUniqueNetId> UserI
 		if (Sessions.IsValid() && UserId.IsValid())
 		{
 			// Set the Handle again
+			Sessions->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
 			OnJoinSessionCompleteDelegateHandle = Sessions->AddOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegate);
 
 			// Call the "JoinOnlineSession" Function with the passed "SearchResult". The "SessionSearch->SearchResults" can be used to get such a
 			// "FOnlineSessionSearchResult" and pass it. Pretty straight forward!
+			BeginSessionStage();
 			bSuccessful = Sessions->JoinSession(*UserId, SessionName, SearchResult);
+			if (!bSuccessful)
+			{
+				Sessions->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
+			}
 
 			ULocalPlayer* const Player = GetFirstGamePlayer();
 			ACellDemoPlayerController* controller = Cast<ACellDemoPlayerController>(Player->GetPlayerController(GetWorld()));
@@ -362,6 +508,8 @@ void UCellNWGameInstance::OnJoinSessionComplete(FName SessionName, EOnJoinSessio
 		GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("OnJoinSessionComplete %s, %d"), *SessionName.ToString(), static_cast<int32>(Result)));
 	}
 
+	SessionStageTimings.JoinMs = EndSessionStage();
+
 	ULocalPlayer* const Player = GetFirstGamePlayer();
 	ACellDemoPlayerController* controller = Cast<ACellDemoPlayerController>(Player->GetPlayerController(GetWorld()));
 	if (controller != nullptr)
@@ -394,6 +542,7 @@ void UCellNWGameInstance::OnJoinSessionComplete(FName SessionName, EOnJoinSessio
 			{
 				// Finally call the ClienTravel. If you want, you could print the TravelURL to see
 				// how it really looks like
+				JoinTravelStartTime = FPlatformTime::Seconds();
 				PlayerController->ClientTravel(TravelURL, ETravelType::TRAVEL_Absolute);
 			}
 
@@ -412,6 +561,135 @@ void UCellNWGameInstance::OnJoinSessionComplete(FName SessionName, EOnJoinSessio
 			}
 		}
 	}
+
+	RefreshOnlineStatus();
+}
+
+void UCellNWGameInstance::ProbeAndJoinSession(const TArray<int32>& Candidates)
+{
+	ULocalPlayer* const Player = GetFirstGamePlayer();
+
+	if (Candidates.Num() == 0)
+	{
+		return;
+	}
+
+	LastHostSelection.NumCandidates = Candidates.Num();
+	LastHostSelection.bProbed = false;
+	LastHostSelection.ChosenRttMs = 0.0f;
+	LastHostSelection.FirstCandidateRttMs = 0.0f;
+	LastHostSelection.InSessionPingMs = 0.0f;
+	bMeasureInSessionPing = Candidates.Num() > 1;
+
+	// Nothing to choose from, or probing turned off to measure the ping we get without it
+	if (Candidates.Num() == 1 || !FCellDemoHostProber::IsEnabled())
+	{
+		JoinOnlineSession(Player->GetPreferredUniqueNetId(), GameSessionName, SessionSearch->SearchResults[Candidates[0]]);
+		return;
+	}
+
+	IOnlineSessionPtr Sessions;
+	if (IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get())
+	{
+		Sessions = OnlineSub->GetSessionInterface();
+	}
+
+	TArray<FCellHostProbeResult> ProbeCandidates;
+	for (int32 SearchIdx : Candidates)
+	{
+		const FOnlineSessionSearchResult& SearchResult = SessionSearch->SearchResults[SearchIdx];
+
+		FCellHostProbeResult Candidate;
+		Candidate.SearchResultIndex = SearchIdx;
+		Candidate.SearchPingMs = SearchResult.PingInMs;
+		Candidate.OpenSlots = SearchResult.Session.NumOpenPublicConnections;
+
+		// The probe goes to the host address on the port it advertised
+		FString ConnectInfo;
+		int32 ProbePort = 0;
+		if (Sessions.IsValid() && Sessions->GetResolvedConnectString(SearchResult, NAME_GamePort, ConnectInfo)
+			&& SearchResult.Session.SessionSettings.Get(FName(TEXT("ProbePort")), ProbePort) && ProbePort > 0)
+		{
+			FString Host = ConnectInfo;
+			ConnectInfo.Split(TEXT(":"), &Host, nullptr, ESearchCase::IgnoreCase, ESearchDir::FromEnd);
+
+			bool bIsValid = false;
+			TSharedRef<FInternetAddr> Address = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+			Address->SetIp(*Host, bIsValid);
+			Address->SetPort(ProbePort);
+			if (bIsValid)
+			{
+				Candidate.Address = Address;
+			}
+		}
+
+		ProbeCandidates.Add(Candidate);
+	}
+
+	if (bShowDebugMsg)
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("Probing %d hosts"), ProbeCandidates.Num()));
+	}
+
+	HostProber.Start(ProbeCandidates, FOnCellHostProbeComplete::CreateUObject(this, &UCellNWGameInstance::OnHostProbeComplete, Candidates[0]));
+}
+
+void UCellNWGameInstance::OnHostProbeComplete(const TArray<FCellHostProbeResult>& Results, int32 FirstCandidate)
+{
+	if (Results.Num() == 0)
+	{
+		return;
+	}
+
+	// What we gain compared to joining the first result like we used to
+	const FCellHostProbeResult& Best = Results[0];
+	const FCellHostProbeResult* First = Results.FindByPredicate([FirstCandidate](const FCellHostProbeResult& Result) { return Result.SearchResultIndex == FirstCandidate; });
+
+	LastHostSelection.bProbed = true;
+	LastHostSelection.ChosenRttMs = Best.AvgRttMs;
+	LastHostSelection.FirstCandidateRttMs = First != nullptr ? First->AvgRttMs : Best.AvgRttMs;
+
+	UE_LOG(LogCellDemo, Log, TEXT("Probe: joining result %d at %.1f ms, the first result was at %.1f ms"),
+		Best.SearchResultIndex, LastHostSelection.ChosenRttMs, LastHostSelection.FirstCandidateRttMs);
+
+	ULocalPlayer* const Player = GetFirstGamePlayer();
+	if (Player != nullptr && SessionSearch.IsValid() && SessionSearch->SearchResults.IsValidIndex(Best.SearchResultIndex))
+	{
+		JoinOnlineSession(Player->GetPreferredUniqueNetId(), GameSessionName, SessionSearch->SearchResults[Best.SearchResultIndex]);
+	}
+}
+
+void UCellNWGameInstance::MeasureInSessionPing()
+{
+	ACellDemoPlayerController* Controller = Cast<ACellDemoPlayerController>(GetFirstLocalPlayerController());
+	if (Controller == nullptr || Controller->LinkQuality == nullptr || GetWorld()->GetNetMode() != NM_Client)
+	{
+		return;
+	}
+
+	// The ping the player actually gets, as measured by the server on the game connection
+	FCellHostSelection& Selection = LastHostSelection;
+	Selection.InSessionPingMs = Controller->LinkQuality->Quality.RttMs;
+
+	if (Selection.bProbed)
+	{
+		Selection.AvgProbedPingMs = (Selection.AvgProbedPingMs * Selection.NumProbedJoins + Selection.InSessionPingMs) / (Selection.NumProbedJoins + 1);
+		Selection.NumProbedJoins++;
+	}
+	else
+	{
+		Selection.AvgFirstResultPingMs = (Selection.AvgFirstResultPingMs * Selection.NumFirstResultJoins + Selection.InSessionPingMs) / (Selection.NumFirstResultJoins + 1);
+		Selection.NumFirstResultJoins++;
+	}
+
+	if (Selection.NumProbedJoins > 0 && Selection.NumFirstResultJoins > 0)
+	{
+		Selection.PingGainMs = Selection.AvgFirstResultPingMs - Selection.AvgProbedPingMs;
+	}
+
+	UE_LOG(LogCellDemo, Log, TEXT("Probe: in-session ping %.0f ms (%s), average %.1f ms over %d probed joins, %.1f ms over %d first result joins, gain %.1f ms"),
+		Selection.InSessionPingMs, Selection.bProbed ? TEXT("probed") : TEXT("first result"), Selection.AvgProbedPingMs, Selection.NumProbedJoins,
+		Selection.AvgFirstResultPingMs, Selection.NumFirstResultJoins, Selection.PingGainMs);
 }
 
 // *******************************
@@ -426,6 +704,8 @@ void UCellNWGameInstance::OnDestroySessionComplete(FName SessionName, bool bWasS
 		GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("OnDestroySessionComplete %s, %d"), *SessionName.ToString(), bWasSuccessful));
 	}
 
+	SessionStageTimings.DestroyMs = EndSessionStage();
+
 	// Get the OnlineSubsystem we want to work with
 	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
 	if (OnlineSub)
@@ -438,6 +718,8 @@ void UCellNWGameInstance::OnDestroySessionComplete(FName SessionName, bool bWasS
 			// Clear the Delegate
 			Sessions->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
 
+			ProbeResponder.Stop();
+
 			APlayerController * const PlayerController = GetFirstLocalPlayerController();
 			ACellDemoPlayerController* cellDemoPlayerController = Cast<ACellDemoPlayerController>(PlayerController);
 			if (cellDemoPlayerController != nullptr)
@@ -455,6 +737,8 @@ void UCellNWGameInstance::OnDestroySessionComplete(FName SessionName, bool bWasS
 			}
 		}
 	}
+
+	RefreshOnlineStatus();
 }
 
 // *******************************
@@ -489,8 +773,8 @@ void UCellNWGameInstance::JoinOnlineGame()
 {
 	ULocalPlayer* const Player = GetFirstGamePlayer();
 
-	// Just a SearchResult where we can save the one we want to use, for the case we find more than one!
-	FOnlineSessionSearchResult SearchResult;
+	// Every session that is not ours is a candidate, the closest one gets joined
+	TArray<int32> Candidates;
 
 	// If the Array is not empty, we can go through it
 	if (SessionSearch->SearchResults.Num() > 0)
@@ -500,16 +784,12 @@ void UCellNWGameInstance::JoinOnlineGame()
 			// To avoid something crazy, we filter sessions from ourself
 			if (SessionSearch->SearchResults[i].Session.OwningUserId != Player->GetPreferredUniqueNetId())
 			{
-				SearchResult = SessionSearch->SearchResults[i];
-
-				// Once we found sounce a Session that is not ours, just join it. Instead of using a for loop, you could
-				// use a widget where you click on and have a reference for the GameSession it represents which you can use
-				// here
-				JoinOnlineSession(Player->GetPreferredUniqueNetId(), GameSessionName, SearchResult);
-				break;
+				Candidates.Add(i);
 			}
 		}
 	}
+
+	ProbeAndJoinSession(Candidates);
 }
 
 void UCellNWGameInstance::DestroySessionAndLeaveGame()
@@ -521,9 +801,54 @@ void UCellNWGameInstance::DestroySessionAndLeaveGame()
 
 		if (Sessions.IsValid())
 		{
-			Sessions->AddOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegate);
+			Sessions->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
+			OnDestroySessionCompleteDelegateHandle = Sessions->AddOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegate);
+
+			BeginSessionStage();
+			if (!Sessions->DestroySession(GameSessionName))
+			{
+				Sessions->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
+			}
+		}
+	}
+}
+
+int32 UCellNWGameInstance::GetNumRegisteredSessionDelegates() const
+{
+	IOnlineSubsystem* OnlineSub = GetExistingOnlineSubsystem();
+	IOnlineSessionPtr Sessions = OnlineSub != nullptr ? OnlineSub->GetSessionInterface() : nullptr;
+	if (!Sessions.IsValid())
+	{
+		return 0;
+	}
+
+	// Ask the session interface itself rather than trusting our handles, a delegate added twice or whose handle was overwritten still shows
+	return Sessions->OnCreateSessionCompleteDelegates.IsBoundToObject(this) + Sessions->OnStartSessionCompleteDelegates.IsBoundToObject(this)
+		+ Sessions->OnFindSessionsCompleteDelegates.IsBoundToObject(this) + Sessions->OnJoinSessionCompleteDelegates.IsBoundToObject(this)
+		+ Sessions->OnDestroySessionCompleteDelegates.IsBoundToObject(this);
+}
+
+void UCellNWGameInstance::ClearSessionDelegates()
+{
+	IOnlineSubsystem* OnlineSub = GetExistingOnlineSubsystem();
+	if (OnlineSub)
+	{
+		IOnlineSessionPtr Sessions = OnlineSub->GetSessionInterface();
+
+		if (Sessions.IsValid())
+		{
+			Sessions->ClearOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegateHandle);
+			Sessions->ClearOnStartSessionCompleteDelegate_Handle(OnStartSessionCompleteDelegateHandle);
+			Sessions->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
+			Sessions->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
+			Sessions->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
 
-			Sessions->DestroySession(GameSessionName);
+			// And whatever is still bound without a handle, see GetNumRegisteredSessionDelegates
+			Sessions->OnCreateSessionCompleteDelegates.RemoveAll(this);
+			Sessions->OnStartSessionCompleteDelegates.RemoveAll(this);
+			Sessions->OnFindSessionsCompleteDelegates.RemoveAll(this);
+			Sessions->OnJoinSessionCompleteDelegates.RemoveAll(this);
+			Sessions->OnDestroySessionCompleteDelegates.RemoveAll(this);
 		}
 	}
 }
@@ -534,25 +859,143 @@ void UCellNWGameInstance::GetOnlineGameStatus(ACellDemoPlayerController* control
 	{
 		return;
 	}
-	bIsInOnlineGame = false;
-	bIsServer = false;
-	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
+	bIsInOnlineGame = OnlineStatus.bIsInOnlineGame;
+	bIsServer = OnlineStatus.bIsServer;
+	SessionName = OnlineStatus.SessionName;
+}
+
+void UCellNWGameInstance::RefreshOnlineStatus()
+{
+	FCellOnlineStatus NewStatus;
+	NewStatus.SessionId = CurrentSessionId;
+
+	// No subsystem, no session
+	IOnlineSubsystem* OnlineSub = GetExistingOnlineSubsystem();
 	if (OnlineSub)
 	{
 		IOnlineSessionPtr Sessions = OnlineSub->GetSessionInterface();
 
 		if (Sessions.IsValid())
 		{
+			if (Sessions->GetNamedSession(GameSessionName) != nullptr)
+			{
+				NewStatus.SessionName = GameSessionName.ToString();
+			}
+
 			AGameStateBase* gameState = UGameplayStatics::GetGameState(this);
-			
+
 			if (gameState != nullptr)
 			{
-				if (gameState->PlayerArray.Num() > 1)
+				NewStatus.NumPlayers = gameState->PlayerArray.Num();
+				if (NewStatus.NumPlayers > 1)
 				{
-					bIsInOnlineGame = true;
-					bIsServer = gameState->HasAuthority();
+					NewStatus.bIsInOnlineGame = true;
+					NewStatus.bIsServer = gameState->HasAuthority();
 				}
 			}
 		}
 	}
-}
\ No newline at end of file
+
+	if (!(NewStatus == OnlineStatus))
+	{
+		OnlineStatus = NewStatus;
+		OnOnlineStatusChanged.Broadcast(OnlineStatus);
+	}
+}
+
+void UCellNWGameInstance::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	RefreshOnlineStatus();
+	StartCommandLineTests();
+
+	// The link quality is smoothed over a few samples, let it settle on the new connection
+	if (bMeasureInSessionPing && LoadedWorld != nullptr && LoadedWorld->GetNetMode() == NM_Client)
+	{
+		bMeasureInSessionPing = false;
+		LoadedWorld->GetTimerManager().SetTimer(InSessionPingTimerHandle, this, &UCellNWGameInstance::MeasureInSessionPing, 5.0f, false);
+	}
+
+	// The new map comes with a new net driver
+	if (PowerGovernor != nullptr)
+	{
+		PowerGovernor->ApplyPolicy();
+	}
+
+	if (SessionMigration != nullptr)
+	{
+		SessionMigration->OnPostLoadMap(LoadedWorld);
+	}
+}
+
+// *******************************
+// Performance
+// *******************************
+
+void UCellNWGameInstance::SetPerfOverlayVisible(bool bVisible)
+{
+	if (PerfMonitor != nullptr)
+	{
+		PerfMonitor->SetOverlayVisible(bVisible);
+	}
+}
+
+bool UCellNWGameInstance::IsPerfOverlayVisible() const
+{
+	return PerfMonitor != nullptr && PerfMonitor->IsOverlayVisible();
+}
+
+FString UCellNWGameInstance::StartPerfCapture(float Duration)
+{
+	return PerfMonitor != nullptr ? PerfMonitor->StartCapture(Duration) : FString();
+}
+
+void UCellNWGameInstance::StopPerfCapture()
+{
+	if (PerfMonitor != nullptr)
+	{
+		PerfMonitor->StopCapture();
+	}
+}
+
+bool UCellNWGameInstance::MigrateSession(int32 Port)
+{
+	return SessionMigration != nullptr && SessionMigration->StartMigration(Port);
+}
+
+void UCellNWGameInstance::BeginSessionStage()
+{
+	SessionStageStartTime = FPlatformTime::Seconds();
+}
+
+float UCellNWGameInstance::EndSessionStage()
+{
+	const double Now = FPlatformTime::Seconds();
+	const float StageMs = (Now - SessionStageStartTime) * 1000.0;
+	SessionStageStartTime = Now;
+	return StageMs;
+}
+
+// *******************************
+// Boot
+// *******************************
+
+bool UCellNWGameInstance::AreBootAssetsLoaded() const
+{
+	return BootProfiler == nullptr || BootProfiler->AreAssetsLoaded();
+}
+
+void UCellNWGameInstance::BeginBootPhase(const FString& Name)
+{
+	if (BootProfiler != nullptr && !BootProfiler->IsInteractive())
+	{
+		BootProfiler->BeginPhase(Name);
+	}
+}
+
+void UCellNWGameInstance::EndBootPhase(const FString& Name)
+{
+	if (BootProfiler != nullptr && !BootProfiler->IsInteractive())
+	{
+		BootProfiler->EndPhase(Name);
+	}
+}
@@ -6,8 +6,140 @@
 #include "Engine/GameInstance.h"
 #include "Interfaces/OnlineSessionInterface.h"
 #include "CellDemoPlayerController.h"
+#include "CellDemoHostProbe.h"
 #include "CellNWGameInstance.generated.h"
 
+/** What the UI needs to know about the online game we are in */
+USTRUCT(BlueprintType)
+struct FCellOnlineStatus
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	bool bIsInOnlineGame;
+
+	UPROPERTY(BlueprintReadOnly)
+	bool bIsServer;
+
+	UPROPERTY(BlueprintReadOnly)
+	FString SessionName;
+
+	UPROPERTY(BlueprintReadOnly)
+	FString SessionId;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumPlayers;
+
+	FCellOnlineStatus()
+		: bIsInOnlineGame(false)
+		, bIsServer(false)
+		, NumPlayers(0)
+	{
+	}
+
+	bool operator==(const FCellOnlineStatus& Other) const
+	{
+		return bIsInOnlineGame == Other.bIsInOnlineGame && bIsServer == Other.bIsServer && SessionName == Other.SessionName
+			&& SessionId == Other.SessionId && NumPlayers == Other.NumPlayers;
+	}
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCellOnlineStatusChanged, const FCellOnlineStatus&, Status);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnCellBootAssetsLoaded);
+
+/** How the last host was chosen among several candidates, and the in-session ping it got us */
+USTRUCT(BlueprintType)
+struct FCellHostSelection
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumCandidates;
+
+	/** The host was chosen by probing, otherwise it is the first search result, see CellDemo.Probe.Enabled */
+	UPROPERTY(BlueprintReadOnly)
+	bool bProbed;
+
+	/** Probed round trip time of the joined host, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float ChosenRttMs;
+
+	/** Probed round trip time of the first search result, the one we joined before probing, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float FirstCandidateRttMs;
+
+	/** Round trip time measured in the joined session once it settled, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float InSessionPingMs;
+
+	/** Average in-session ping of the joins choosing by probing, and of the ones joining the first result, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AvgProbedPingMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumProbedJoins;
+
+	UPROPERTY(BlueprintReadOnly)
+	float AvgFirstResultPingMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumFirstResultJoins;
+
+	/** In-session ping saved by probing, 0 until joins were measured both ways */
+	UPROPERTY(BlueprintReadOnly)
+	float PingGainMs;
+
+	FCellHostSelection()
+		: NumCandidates(0)
+		, bProbed(false)
+		, ChosenRttMs(0.0f)
+		, FirstCandidateRttMs(0.0f)
+		, InSessionPingMs(0.0f)
+		, AvgProbedPingMs(0.0f)
+		, NumProbedJoins(0)
+		, AvgFirstResultPingMs(0.0f)
+		, NumFirstResultJoins(0)
+		, PingGainMs(0.0f)
+	{
+	}
+};
+
+/** Duration of the last run of every session stage, in milliseconds */
+USTRUCT(BlueprintType)
+struct FCellSessionStageTimings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	float CreateMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	float StartMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	float FindMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	float JoinMs;
+
+	UPROPERTY(BlueprintReadOnly)
+	float DestroyMs;
+
+	FCellSessionStageTimings()
+		: CreateMs(0.0f)
+		, StartMs(0.0f)
+		, FindMs(0.0f)
+		, JoinMs(0.0f)
+		, DestroyMs(0.0f)
+	{
+	}
+
+	bool operator==(const FCellSessionStageTimings& Other) const
+	{
+		return CreateMs == Other.CreateMs && StartMs == Other.StartMs && FindMs == Other.FindMs && JoinMs == Other.JoinMs && DestroyMs == Other.DestroyMs;
+	}
+};
+
 /**
  * 
  */
@@ -23,6 +155,12 @@ public:
 	UPROPERTY(BlueprintReadOnly)
 	FString CurrentSessionId;
 
+	UPROPERTY(BlueprintReadOnly)
+	FCellSessionStageTimings SessionStageTimings;
+
+	/** Time of the travel to the host of the joined session, 0 once the initial sync is complete */
+	double JoinTravelStartTime;
+
 	// *******************************
 	// Hosting
 	// *******************************
@@ -51,6 +189,9 @@ public:
 
 	UCellNWGameInstance(const FObjectInitializer& ObjectInitializer);
 
+	virtual void Init() override;
+	virtual void Shutdown() override;
+
 	/**
 	*	Function fired when a session create request has completed
 	*
@@ -122,6 +263,31 @@ public:
 	*/
 	void OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result);
 
+	/**
+	*	Probes the round trip time to every candidate host at the same time and joins the best one
+	*
+	*	@param Candidates indices in SessionSearch->SearchResults
+	*/
+	void ProbeAndJoinSession(const TArray<int32>& Candidates);
+
+	/** Results of the last host choice, to see how much the probing improves the in-session ping */
+	UPROPERTY(BlueprintReadOnly)
+	FCellHostSelection LastHostSelection;
+
+	/** Answers the RTT probes while we are hosting */
+	FCellDemoProbeResponder ProbeResponder;
+
+	/** Measures the RTT to the candidate hosts when joining */
+	FCellDemoHostProber HostProber;
+
+	void OnHostProbeComplete(const TArray<FCellHostProbeResult>& Results, int32 FirstCandidate);
+
+	/** Set when joining a host chosen among several, the in-session ping is measured once the joined map settled */
+	bool bMeasureInSessionPing;
+	FTimerHandle InSessionPingTimerHandle;
+
+	void MeasureInSessionPing();
+
 	// *******************************
 	// Destroying
 	// *******************************
@@ -159,6 +325,104 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Network|Test")
 	void DestroySessionAndLeaveGame();
 
+	/** Number of session interface completion delegates still bound to us, 0 when no request is pending */
+	int32 GetNumRegisteredSessionDelegates() const;
+
+	/** Unbinds every session delegate, for requests that will never complete */
+	void ClearSessionDelegates();
+
+	/** Returns the cached online status, see OnlineStatus */
 	UFUNCTION(BlueprintCallable, Category = "Network|Test")
 	void GetOnlineGameStatus(ACellDemoPlayerController* controller, bool& bIsInOnlineGame, bool& bIsServer, FString& SessionName);
+
+	/** Online status, only updated by the session callbacks and when players join or leave */
+	UPROPERTY(BlueprintReadOnly, Category = "Network")
+	FCellOnlineStatus OnlineStatus;
+
+	/** Broadcast when OnlineStatus changes, the UI should redraw from here instead of polling */
+	UPROPERTY(BlueprintAssignable, Category = "Network")
+	FOnCellOnlineStatusChanged OnOnlineStatusChanged;
+
+	/** Recomputes OnlineStatus and broadcasts it if it changed, never creates the online subsystem */
+	void RefreshOnlineStatus();
+
+	// *******************************
+	// Boot
+	// *******************************
+
+	/** Boot phase timings and UI asset streaming */
+	UPROPERTY(Transient)
+	class UCellDemoBootProfiler* BootProfiler;
+
+	/** Broadcast once the UI assets streamed at boot are loaded, the UI can be created without a hitch from here */
+	UPROPERTY(BlueprintAssignable, Category = "Boot")
+	FOnCellBootAssetsLoaded OnBootAssetsLoaded;
+
+	UFUNCTION(BlueprintPure, Category = "Boot")
+	bool AreBootAssetsLoaded() const;
+
+	/** Adds a named phase to the boot timings, ignored once the boot is interactive */
+	UFUNCTION(BlueprintCallable, Category = "Boot")
+	void BeginBootPhase(const FString& Name);
+
+	UFUNCTION(BlueprintCallable, Category = "Boot")
+	void EndBootPhase(const FString& Name);
+
+	// *******************************
+	// Performance
+	// *******************************
+
+	/** Frame budget regression suite, created by -CellPerfSuite, -CellPerfJoin=<SessionId> or the CellDemo.Perf.Suite tests */
+	UPROPERTY(Transient)
+	class UCellDemoPerfSuite* PerfSuite;
+
+	/** Performance overlay and capture */
+	UPROPERTY(Transient)
+	class UCellDemoPerfMonitor* PerfMonitor;
+
+	UFUNCTION(BlueprintCallable, Category = "Performance")
+	void SetPerfOverlayVisible(bool bVisible);
+
+	UFUNCTION(BlueprintPure, Category = "Performance")
+	bool IsPerfOverlayVisible() const;
+
+	/** Records the frame stats to a binary trace for Duration seconds, returns the file path */
+	UFUNCTION(BlueprintCallable, Category = "Performance")
+	FString StartPerfCapture(float Duration);
+
+	UFUNCTION(BlueprintCallable, Category = "Performance")
+	void StopPerfCapture();
+
+	/** Battery and thermal governor */
+	UPROPERTY(Transient)
+	class UCellDemoPowerGovernor* PowerGovernor;
+
+	/** Moves the hosted cell to another server process, see CellDemo.Migrate and -CellRestore=<File> */
+	UPROPERTY(Transient)
+	class UCellDemoSessionMigration* SessionMigration;
+
+	UFUNCTION(BlueprintCallable, Category = "Network|Test")
+	bool MigrateSession(int32 Port);
+
+	/** Call cycle soak test, created by StartSoakTest or -CellSoak=<Cycles> */
+	UPROPERTY(Transient)
+	class UCellDemoSoakTest* SoakTest;
+
+	UFUNCTION(BlueprintCallable, Category = "Network|Test")
+	void StartSoakTest(int32 Cycles);
+
+private:
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	/** Starts the tests asked for on the command line, once there is a local player to run the session functions with */
+	void StartCommandLineTests();
+	bool bCommandLineTestsStarted;
+
+	/** Time the current session stage started at */
+	double SessionStageStartTime;
+
+	void BeginSessionStage();
+
+	/** Returns the time since the stage started in milliseconds and starts the next one */
+	float EndSessionStage();
 };